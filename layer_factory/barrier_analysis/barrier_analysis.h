@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vlf_concurrency.h"
+#include "vlf_hash.h"
+#include "vlf_settings.h"
+
+// Finds synchronization that is broader than it needs to be and leaves the GPU idle waiting on work it does not depend
+// on. Checked are vkCmdPipelineBarrier, vkCmdWaitEvents and the subpass dependencies of render passes, for:
+//   - ALL_COMMANDS in the source or destination stage mask, which waits for or blocks every stage
+//   - MEMORY_READ or MEMORY_WRITE access masks, which flush or invalidate every cache
+//   - barriers covering a whole image that the same command buffer otherwise synchronizes per mip level or layer
+//   - vkCmdPipelineBarrier calls directly following another with the same dependency flags, which could be one call
+//   - layout transitions of a subresource range already transitioned by the barriers directly before, with no command
+//     using the intermediate layout
+// Barriers are identified by their parameters, so the same barrier recorded from the same place in the application is
+// one site. Each flagged site is reported once as a performance warning. Counts are taken at every submission, and
+// the flagged barriers per frame and the most executed flagged sites are summarized periodically.
+//
+// Settings:
+//   lunarg_barrier_analysis.report_frames  Print a summary every N presents, 0 to disable (default 600)
+//   lunarg_barrier_analysis.top_count      Number of barrier sites listed in the summary (default 10)
+class BarrierAnalysis : public layer_factory {
+   public:
+    BarrierAnalysis() : layer_factory(this, kLayerIdentifier), report_frames_(600), top_count_(10), frame_(0){};
+
+    VkResult PostCallCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                    VkInstance *pInstance, VkResult result) {
+        report_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "report_frames", report_frames_);
+        top_count_ = vlf::GetLayerSettingUint(kLayerIdentifier, "top_count", top_count_);
+        return VK_SUCCESS;
+    }
+
+    // Frames presented since the last periodic summary are reported at shutdown
+    void PreCallDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+        if (barrier_statistics_.Count() != 0) Report(frame_.load(std::memory_order_relaxed));
+    }
+
+    void PreCallDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+        images_.EraseIf([device](VkImage, const ImageInfo &image) { return image.device == device; });
+        render_passes_.EraseIf([device](VkRenderPass, const std::shared_ptr<const RenderPassInfo> &render_pass) {
+            return render_pass->device == device;
+        });
+    }
+
+    VkResult PostCallCreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                 VkImage *pImage, VkResult result) {
+        if (result == VK_SUCCESS) images_.Insert(*pImage, ImageInfo{device, pCreateInfo->mipLevels, pCreateInfo->arrayLayers});
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks *pAllocator) { images_.Erase(image); }
+
+    VkResult PostCallCreateRenderPass(VkDevice device, const VkRenderPassCreateInfo *pCreateInfo,
+                                      const VkAllocationCallbacks *pAllocator, VkRenderPass *pRenderPass, VkResult result) {
+        if (result == VK_SUCCESS) render_passes_.Insert(*pRenderPass, AnalyzeDependencies(device, *pCreateInfo));
+        return VK_SUCCESS;
+    }
+    VkResult PostCallCreateRenderPass2(VkDevice device, const VkRenderPassCreateInfo2 *pCreateInfo,
+                                       const VkAllocationCallbacks *pAllocator, VkRenderPass *pRenderPass, VkResult result) {
+        if (result == VK_SUCCESS) render_passes_.Insert(*pRenderPass, AnalyzeDependencies(device, *pCreateInfo));
+        return VK_SUCCESS;
+    }
+    VkResult PostCallCreateRenderPass2KHR(VkDevice device, const VkRenderPassCreateInfo2 *pCreateInfo,
+                                          const VkAllocationCallbacks *pAllocator, VkRenderPass *pRenderPass, VkResult result) {
+        return PostCallCreateRenderPass2(device, pCreateInfo, pAllocator, pRenderPass, result);
+    }
+    void PreCallDestroyRenderPass(VkDevice device, VkRenderPass renderPass, const VkAllocationCallbacks *pAllocator) {
+        render_passes_.Erase(renderPass);
+    }
+
+    void PreCallCmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                   VkSubpassContents contents) {
+        BeginRenderPass(commandBuffer, pRenderPassBegin->renderPass);
+    }
+    void PreCallCmdBeginRenderPass2(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                    const VkSubpassBeginInfo *pSubpassBeginInfo) {
+        BeginRenderPass(commandBuffer, pRenderPassBegin->renderPass);
+    }
+    void PreCallCmdBeginRenderPass2KHR(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                       const VkSubpassBeginInfo *pSubpassBeginInfo) {
+        BeginRenderPass(commandBuffer, pRenderPassBegin->renderPass);
+    }
+
+    void PreCallCmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+                                   VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+                                   uint32_t memoryBarrierCount, const VkMemoryBarrier *pMemoryBarriers,
+                                   uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+                                   uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers) {
+        AnalyzeBarrier(commandBuffer, "vkCmdPipelineBarrier", srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount,
+                       pMemoryBarriers, bufferMemoryBarrierCount, pBufferMemoryBarriers, imageMemoryBarrierCount,
+                       pImageMemoryBarriers);
+    }
+
+    void PreCallCmdWaitEvents(VkCommandBuffer commandBuffer, uint32_t eventCount, const VkEvent *pEvents,
+                              VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, uint32_t memoryBarrierCount,
+                              const VkMemoryBarrier *pMemoryBarriers, uint32_t bufferMemoryBarrierCount,
+                              const VkBufferMemoryBarrier *pBufferMemoryBarriers, uint32_t imageMemoryBarrierCount,
+                              const VkImageMemoryBarrier *pImageMemoryBarriers) {
+        AnalyzeBarrier(commandBuffer, "vkCmdWaitEvents", srcStageMask, dstStageMask, 0, memoryBarrierCount, pMemoryBarriers,
+                       bufferMemoryBarrierCount, pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
+    }
+
+    // Counts are taken per execution of the command buffer, so command buffers recorded once and submitted every frame
+    // are accounted for
+    void SubmittedCommandBuffer(VkQueue queue, VkCommandBuffer command_buffer, vlf::CommandBufferContext &context) {
+        CommandBufferState &state = context.State<CommandBufferState>(this);
+        barriers_.Add(state.barriers);
+        for (int issue = 0; issue < kIssueCount; ++issue) issue_counts_[issue].Add(state.issue_counts[issue]);
+        for (uint64_t signature : state.flagged_sites) {
+            sites_.UpdateExisting(signature, [](Site &site) { ++site.executions; });
+        }
+    }
+
+    VkResult PostCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkResult result) {
+        uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed) + 1;
+        barrier_statistics_.Record(static_cast<uint64_t>(barriers_.Exchange()));
+        for (int issue = 0; issue < kIssueCount; ++issue) {
+            issue_statistics_[issue].Record(static_cast<uint64_t>(issue_counts_[issue].Exchange()));
+        }
+        uint64_t report_frames = report_frames_.load(std::memory_order_relaxed);
+        if (report_frames != 0 && frame % report_frames == 0) Report(frame);
+        return VK_SUCCESS;
+    }
+
+   private:
+    static constexpr const char *kLayerIdentifier = "lunarg_barrier_analysis";
+
+    enum Issue { kAllCommands, kMemoryAccess, kWholeImage, kUnbatched, kRedundantTransition, kIssueCount };
+
+    static const VkAccessFlags kMemoryAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    struct ImageInfo {
+        VkDevice device;
+        uint32_t mip_levels;
+        uint32_t array_layers;
+    };
+
+    // A barrier, or a subpass dependency, identified by its parameters
+    struct Site {
+        std::string description;
+        uint32_t issues = 0;
+        uint64_t executions = 0;
+    };
+
+    struct FlaggedDependency {
+        uint64_t signature;
+        uint32_t issues;
+    };
+
+    struct RenderPassInfo {
+        VkDevice device;
+        std::vector<FlaggedDependency> dependencies;
+    };
+
+    // The last layout transition of a subresource range of an image in the current recording
+    struct ImageTransition {
+        VkImageSubresourceRange range;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+        uint32_t command_index;
+        bool partial_barriers;
+    };
+
+    // Per-recording state, kept in the command buffer's context
+    struct CommandBufferState {
+        uint32_t barriers = 0;
+        uint32_t issue_counts[kIssueCount] = {};
+        std::vector<uint64_t> flagged_sites;
+        // Barrier commands recorded back to back form a run; commands in a run have nothing between them
+        uint32_t last_barrier_index = UINT32_MAX;
+        uint32_t run_start = 0;
+        bool last_was_pipeline_barrier = false;
+        VkDependencyFlags last_dependency_flags = 0;
+        std::unordered_map<VkImage, ImageTransition> images;
+    };
+
+
+    static std::string StageMaskString(VkPipelineStageFlags mask) {
+        static const struct {
+            VkPipelineStageFlags bit;
+            const char *name;
+        } stages[] = {
+            {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, "TOP_OF_PIPE"},
+            {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, "DRAW_INDIRECT"},
+            {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, "VERTEX_INPUT"},
+            {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, "VERTEX_SHADER"},
+            {VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT, "TESSELLATION_CONTROL_SHADER"},
+            {VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT, "TESSELLATION_EVALUATION_SHADER"},
+            {VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT, "GEOMETRY_SHADER"},
+            {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "FRAGMENT_SHADER"},
+            {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, "EARLY_FRAGMENT_TESTS"},
+            {VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, "LATE_FRAGMENT_TESTS"},
+            {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, "COLOR_ATTACHMENT_OUTPUT"},
+            {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, "COMPUTE_SHADER"},
+            {VK_PIPELINE_STAGE_TRANSFER_BIT, "TRANSFER"},
+            {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, "BOTTOM_OF_PIPE"},
+            {VK_PIPELINE_STAGE_HOST_BIT, "HOST"},
+            {VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, "ALL_GRAPHICS"},
+            {VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, "ALL_COMMANDS"},
+        };
+        std::string text;
+        for (const auto &stage : stages) {
+            if (!(mask & stage.bit)) continue;
+            if (!text.empty()) text += "|";
+            text += stage.name;
+            mask &= ~stage.bit;
+        }
+        if (mask) {
+            char other[32];
+            snprintf(other, sizeof(other), "%s0x%x", text.empty() ? "" : "|", mask);
+            text += other;
+        }
+        return text.empty() ? "NONE" : text;
+    }
+
+    static std::string IssueString(uint32_t issues) {
+        static const char *const issue_names[] = {"ALL_COMMANDS stage", "MEMORY_READ/WRITE access", "whole-image barrier",
+                                                  "could be batched", "redundant transition"};
+        std::string text;
+        for (int issue = 0; issue < kIssueCount; ++issue) {
+            if (!(issues & (1u << issue))) continue;
+            if (!text.empty()) text += ", ";
+            text += issue_names[issue];
+        }
+        return text;
+    }
+
+    static uint32_t StageIssues(VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages) {
+        return ((src_stages | dst_stages) & VK_PIPELINE_STAGE_ALL_COMMANDS_BIT) ? 1u << kAllCommands : 0;
+    }
+
+    // Returns true the first time a site is seen with issues, after which it is warned about
+    bool RegisterSite(uint64_t signature, uint32_t issues, const std::function<std::string()> &describe) {
+        if (sites_.UpdateExisting(signature, [issues](Site &site) { site.issues |= issues; })) return false;
+        std::string description = describe();
+        bool first = false;
+        sites_.Update(signature, [&](Site &site) {
+            first = site.description.empty();
+            if (first) site.description = description;
+            site.issues |= issues;
+        });
+        return first;
+    }
+
+    template <typename CreateInfo>
+    std::shared_ptr<const RenderPassInfo> AnalyzeDependencies(VkDevice device, const CreateInfo &create_info) {
+        std::shared_ptr<RenderPassInfo> render_pass = std::make_shared<RenderPassInfo>();
+        render_pass->device = device;
+        for (uint32_t i = 0; i < create_info.dependencyCount; ++i) {
+            const auto &dependency = create_info.pDependencies[i];
+            uint32_t issues = StageIssues(dependency.srcStageMask, dependency.dstStageMask);
+            if ((dependency.srcAccessMask | dependency.dstAccessMask) & kMemoryAccessMask) issues |= 1u << kMemoryAccess;
+            if (!issues) continue;
+            uint64_t signature = vlf::kHashSeed;
+            signature = vlf::Hash(signature, 0x5355425041535344ull);  // Keeps dependencies apart from barriers
+            signature = vlf::Hash(signature, (uint64_t(dependency.srcSubpass) << 32) | dependency.dstSubpass);
+            signature = vlf::Hash(signature, (uint64_t(dependency.srcStageMask) << 32) | dependency.dstStageMask);
+            signature = vlf::Hash(signature, (uint64_t(dependency.srcAccessMask) << 32) | dependency.dstAccessMask);
+            signature = vlf::Hash(signature, dependency.dependencyFlags);
+            bool first = RegisterSite(signature, issues, [&dependency]() {
+                char text[64];
+                std::string description = "subpass dependency ";
+                if (dependency.srcSubpass == VK_SUBPASS_EXTERNAL) {
+                    description += "EXTERNAL";
+                } else {
+                    description += std::to_string(dependency.srcSubpass);
+                }
+                description += " -> ";
+                if (dependency.dstSubpass == VK_SUBPASS_EXTERNAL) {
+                    description += "EXTERNAL";
+                } else {
+                    description += std::to_string(dependency.dstSubpass);
+                }
+                snprintf(text, sizeof(text), ", access 0x%x -> 0x%x", dependency.srcAccessMask, dependency.dstAccessMask);
+                return description + ", " + StageMaskString(dependency.srcStageMask) + " -> " +
+                       StageMaskString(dependency.dstStageMask) + text;
+            });
+            if (first) WarnSite(signature);
+            render_pass->dependencies.push_back({signature, issues});
+        }
+        return render_pass;
+    }
+
+    void BeginRenderPass(VkCommandBuffer command_buffer, VkRenderPass render_pass_handle) {
+        vlf::CommandBufferContext *context = GetCommandBufferContext(command_buffer);
+        std::shared_ptr<const RenderPassInfo> render_pass;
+        if (!context || !render_passes_.Find(render_pass_handle, &render_pass)) return;
+        CommandBufferState &state = context->State<CommandBufferState>(this);
+        for (const auto &dependency : render_pass->dependencies) CountIssues(state, dependency.signature, dependency.issues);
+    }
+
+    static void CountIssues(CommandBufferState &state, uint64_t signature, uint32_t issues) {
+        for (int issue = 0; issue < kIssueCount; ++issue) {
+            if (issues & (1u << issue)) ++state.issue_counts[issue];
+        }
+        state.flagged_sites.push_back(signature);
+    }
+
+    void AnalyzeBarrier(VkCommandBuffer command_buffer, const char *name, VkPipelineStageFlags src_stages,
+                        VkPipelineStageFlags dst_stages, VkDependencyFlags dependency_flags, uint32_t memory_barrier_count,
+                        const VkMemoryBarrier *memory_barriers, uint32_t buffer_barrier_count,
+                        const VkBufferMemoryBarrier *buffer_barriers, uint32_t image_barrier_count,
+                        const VkImageMemoryBarrier *image_barriers) {
+        vlf::CommandBufferContext *context = GetCommandBufferContext(command_buffer);
+        if (!context) return;
+        CommandBufferState &state = context->State<CommandBufferState>(this);
+        uint32_t index = context->CommandIndex();
+        bool pipeline_barrier = strcmp(name, "vkCmdPipelineBarrier") == 0;
+        bool in_run = state.last_barrier_index != UINT32_MAX && state.last_barrier_index + 1 == index;
+        if (!in_run) state.run_start = index;
+
+        uint32_t issues = StageIssues(src_stages, dst_stages);
+        if (pipeline_barrier && in_run && state.last_was_pipeline_barrier && state.last_dependency_flags == dependency_flags) {
+            issues |= 1u << kUnbatched;
+        }
+        VkAccessFlags access = 0;
+        for (uint32_t i = 0; i < memory_barrier_count; ++i) {
+            access |= memory_barriers[i].srcAccessMask | memory_barriers[i].dstAccessMask;
+        }
+        for (uint32_t i = 0; i < buffer_barrier_count; ++i) {
+            access |= buffer_barriers[i].srcAccessMask | buffer_barriers[i].dstAccessMask;
+        }
+        for (uint32_t i = 0; i < image_barrier_count; ++i) {
+            access |= image_barriers[i].srcAccessMask | image_barriers[i].dstAccessMask;
+        }
+        if (access & kMemoryAccessMask) issues |= 1u << kMemoryAccess;
+        for (uint32_t i = 0; i < image_barrier_count; ++i) issues |= AnalyzeImageBarrier(state, image_barriers[i], index);
+
+        state.last_barrier_index = index;
+        state.last_was_pipeline_barrier = pipeline_barrier;
+        state.last_dependency_flags = dependency_flags;
+        ++state.barriers;
+        if (!issues) return;
+
+        uint64_t signature = vlf::kHashSeed;
+        for (const char *c = name; *c; ++c) signature = vlf::Hash(signature, static_cast<uint8_t>(*c));
+        signature = vlf::Hash(signature, (uint64_t(src_stages) << 32) | dst_stages);
+        signature = vlf::Hash(signature, dependency_flags);
+        signature = vlf::Hash(signature, (uint64_t(memory_barrier_count) << 32) | buffer_barrier_count);
+        signature = vlf::Hash(signature, image_barrier_count);
+        for (uint32_t i = 0; i < image_barrier_count; ++i) {
+            signature = vlf::Hash(signature, (uint64_t(image_barriers[i].oldLayout) << 32) | image_barriers[i].newLayout);
+        }
+        if (RegisterSite(signature, issues, [&]() {
+                return std::string(name) + ", " + StageMaskString(src_stages) + " -> " + StageMaskString(dst_stages) + ", " +
+                       std::to_string(memory_barrier_count) + " memory, " + std::to_string(buffer_barrier_count) + " buffer, " +
+                       std::to_string(image_barrier_count) + " image barriers";
+            })) {
+            WarnSite(signature);
+        }
+        CountIssues(state, signature, issues);
+    }
+
+    uint32_t AnalyzeImageBarrier(CommandBufferState &state, const VkImageMemoryBarrier &barrier, uint32_t index) {
+        ImageInfo image;
+        if (!images_.Find(barrier.image, &image)) return 0;
+        const VkImageSubresourceRange &range = barrier.subresourceRange;
+        uint32_t level_count =
+            range.levelCount == VK_REMAINING_MIP_LEVELS ? image.mip_levels - range.baseMipLevel : range.levelCount;
+        uint32_t layer_count =
+            range.layerCount == VK_REMAINING_ARRAY_LAYERS ? image.array_layers - range.baseArrayLayer : range.layerCount;
+        bool whole = range.baseMipLevel == 0 && range.baseArrayLayer == 0 && level_count >= image.mip_levels &&
+                     layer_count >= image.array_layers;
+
+        uint32_t issues = 0;
+        auto found = state.images.find(barrier.image);
+        if (found == state.images.end()) {
+            state.images[barrier.image] = {range, barrier.oldLayout, barrier.newLayout, index, !whole};
+            return 0;
+        }
+        ImageTransition &previous = found->second;
+        if (whole && previous.partial_barriers) issues |= 1u << kWholeImage;
+        bool same_range = previous.range.aspectMask == range.aspectMask && previous.range.baseMipLevel == range.baseMipLevel &&
+                          previous.range.levelCount == range.levelCount && previous.range.baseArrayLayer == range.baseArrayLayer &&
+                          previous.range.layerCount == range.layerCount;
+        if (same_range && previous.command_index >= state.run_start && barrier.oldLayout != barrier.newLayout &&
+            previous.old_layout != previous.new_layout) {
+            issues |= 1u << kRedundantTransition;
+        }
+        bool partial_barriers = previous.partial_barriers || !whole;
+        previous = {range, barrier.oldLayout, barrier.newLayout, index, partial_barriers};
+        return issues;
+    }
+
+    void WarnSite(uint64_t signature) {
+        Site site;
+        if (!sites_.Find(signature, &site)) return;
+        PerformanceWarning("Over-synchronization (" + IssueString(site.issues) + "): " + site.description);
+    }
+
+    void Report(uint64_t frame) {
+        static const char *const issue_names[] = {"ALL_COMMANDS stage mask", "MEMORY_READ/WRITE access mask",
+                                                  "Whole-image barriers", "Back-to-back barriers", "Redundant transitions"};
+        std::string text;
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "Barrier analysis after %" PRIu64 " frames: %.1f barrier commands/frame mean, %" PRIu64 " max\n", frame,
+                 barrier_statistics_.Mean(), barrier_statistics_.Max());
+        text += line;
+        for (int issue = 0; issue < kIssueCount; ++issue) {
+            snprintf(line, sizeof(line), "  %-32s %10.1f/frame mean %10" PRIu64 " max\n", issue_names[issue],
+                     issue_statistics_[issue].Mean(), issue_statistics_[issue].Max());
+            text += line;
+        }
+
+        std::vector<std::pair<uint64_t, Site>> sites;
+        sites_.ForEach([&sites](uint64_t signature, const Site &site) {
+            if (site.executions) sites.emplace_back(signature, site);
+        });
+        size_t count = std::min<size_t>(sites.size(), top_count_.load(std::memory_order_relaxed));
+        std::partial_sort(sites.begin(), sites.begin() + count, sites.end(),
+                          [](const std::pair<uint64_t, Site> &a, const std::pair<uint64_t, Site> &b) {
+                              return a.second.executions > b.second.executions;
+                          });
+        if (count) text += "  Most executed flagged barriers:\n";
+        for (size_t i = 0; i < count; ++i) {
+            const Site &site = sites[i].second;
+            snprintf(line, sizeof(line), "  %10" PRIu64 "x  %s [%s]\n", site.executions, site.description.c_str(),
+                     IssueString(site.issues).c_str());
+            text += line;
+        }
+        Print(text);
+        barrier_statistics_.Reset();
+        for (auto &statistics : issue_statistics_) statistics.Reset();
+    }
+
+    // Settings
+    std::atomic<uint64_t> report_frames_;
+    std::atomic<uint64_t> top_count_;
+
+    vlf::ConcurrentHandleMap<VkImage, ImageInfo> images_;
+    vlf::ConcurrentHandleMap<VkRenderPass, std::shared_ptr<const RenderPassInfo>> render_passes_;
+    vlf::ConcurrentHandleMap<uint64_t, Site> sites_;
+
+    std::atomic<uint64_t> frame_;
+    vlf::PerThreadCounter<> barriers_;
+    vlf::PerThreadCounter<> issue_counts_[kIssueCount];
+    vlf::StatisticsAccumulator barrier_statistics_;
+    vlf::StatisticsAccumulator issue_statistics_[kIssueCount];
+};
+
+BarrierAnalysis barrier_analysis;
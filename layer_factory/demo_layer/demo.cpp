@@ -23,34 +23,32 @@
 static uint32_t display_rate = 60;
 
 // This function will be called for every API call
-void MemDemo::PreCallApiFunction(const char *api_name) { printf("Calling %s\n", api_name); }
+void MemDemo::PreCallApiFunction(const char *api_name) { Print(std::string("Calling ") + api_name + "\n"); }
 
 // Intercept the memory allocation calls and increment the counter
 VkResult MemDemo::PostCallAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
                                          const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory, VkResult result) {
-    number_mem_objects_++;
-    total_memory_ += pAllocateInfo->allocationSize;
-    mem_size_map_[*pMemory] = pAllocateInfo->allocationSize;
+    if (result != VK_SUCCESS) return VK_SUCCESS;
+    number_mem_objects_.Increment();
+    total_memory_.Add(pAllocateInfo->allocationSize);
+    mem_size_map_.Insert(*pMemory, pAllocateInfo->allocationSize);
     return VK_SUCCESS;
 }
 
 // Intercept the free memory calls and update totals
 void MemDemo::PreCallFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *pAllocator) {
-    if (memory != VK_NULL_HANDLE) {
-        number_mem_objects_--;
-        VkDeviceSize this_alloc = mem_size_map_[memory];
-        total_memory_ -= this_alloc;
+    VkDeviceSize this_alloc = 0;
+    if (memory != VK_NULL_HANDLE && mem_size_map_.Erase(memory, &this_alloc)) {
+        number_mem_objects_.Decrement();
+        total_memory_.Add(-static_cast<int64_t>(this_alloc));
     }
 }
 
 VkResult MemDemo::PreCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
-    present_count_++;
-    if (present_count_ >= display_rate) {
-        present_count_ = 0;
-
+    if (++present_count_ % display_rate == 0) {
         std::stringstream message;
-        message << "Memory Allocation Count: " << number_mem_objects_ << "\n";
-        message << "Total Memory Allocation Size: " << total_memory_ << "\n\n";
+        message << "Memory Allocation Count: " << number_mem_objects_.Sum() << "\n";
+        message << "Total Memory Allocation Size: " << total_memory_.Sum() << "\n\n";
 
         // Various text output options:
         // Call through simplified interface
@@ -63,8 +61,8 @@ VkResult MemDemo::PreCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *
         OutputDebugStringA(cstr);
 #endif
 
-        // Option 3, use printf to stdout
-        printf("Demo layer: %s\n", message.str().c_str());
+        // Option 3, print to stdout, queued for the writer thread when asynchronous output is enabled
+        Print("Demo layer: " + message.str() + "\n");
     }
 
     return VK_SUCCESS;
@@ -19,15 +19,16 @@
 
 #pragma once
 
-#include <unordered_map>
+#include <atomic>
 #include "vulkan/vulkan.h"
 #include "vk_layer_logging.h"
 #include "layer_factory.h"
+#include "vlf_concurrency.h"
 
 class MemDemo : public layer_factory {
    public:
     // Constructor for state_tracker
-    MemDemo() : number_mem_objects_(0), total_memory_(0), present_count_(0){};
+    MemDemo() : layer_factory(this), present_count_(0){};
 
     void PreCallApiFunction(const char *api_name);
 
@@ -39,8 +40,9 @@ class MemDemo : public layer_factory {
     VkResult PreCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo);
 
    private:
-    uint32_t number_mem_objects_;
-    VkDeviceSize total_memory_;
-    uint32_t present_count_;
-    std::unordered_map<VkDeviceMemory, VkDeviceSize> mem_size_map_;
+    // Hooks run on application threads, so all state is safe for concurrent use
+    vlf::PerThreadCounter<> number_mem_objects_;
+    vlf::PerThreadCounter<> total_memory_;
+    std::atomic<uint32_t> present_count_;
+    vlf::ConcurrentHandleMap<VkDeviceMemory, VkDeviceSize> mem_size_map_;
 };
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "vlf_histogram.h"
+#include "vlf_settings.h"
+
+// Measures how long each Vulkan call spends below this layer. The clock is read at the end of the PreCall hooks and
+// again at the start of the PostCall hooks, so the time covers the downcall into later layers and the driver.
+//
+// Settings:
+//   lunarg_latency_profiler.report_frames  Print a summary every N presents, 0 to report only at exit (default 1000)
+//   lunarg_latency_profiler.top_count      Number of entrypoints listed in each summary (default 20)
+//   lunarg_latency_profiler.export_file    If set, every summary also rewrites this file with all entrypoints as CSV
+class LatencyProfiler : public layer_factory {
+   public:
+    LatencyProfiler() : layer_factory(this, kLayerIdentifier), report_frames_(1000), top_count_(20), frame_count_(0){};
+
+    VkResult PostCallCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                    VkInstance *pInstance, VkResult result) {
+        PostCallApiFunction("vkCreateInstance", result);
+        std::lock_guard<std::mutex> lock(report_lock_);
+        report_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "report_frames", report_frames_);
+        top_count_ = vlf::GetLayerSettingUint(kLayerIdentifier, "top_count", top_count_);
+        export_file_ = vlf::GetLayerSetting(kLayerIdentifier, "export_file", export_file_);
+        return VK_SUCCESS;
+    }
+
+    void PostCallDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+        PostCallApiFunction("vkDestroyInstance");
+        Report("at vkDestroyInstance");
+    }
+
+    VkResult PostCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkResult result) {
+        PostCallApiFunction("vkQueuePresentKHR", result);
+        uint64_t frame = ++frame_count_;
+        uint64_t report_frames = report_frames_.load(std::memory_order_relaxed);
+        if (report_frames != 0 && frame % report_frames == 0) {
+            Report("after " + std::to_string(frame) + " frames");
+        }
+        return VK_SUCCESS;
+    }
+
+    void PreCallApiFunction(const char *api_name) { GetThreadProfile().start_time = vlf::NowNanoseconds(); }
+    void PostCallApiFunction(const char *api_name) { RecordCall(api_name); }
+    void PostCallApiFunction(const char *api_name, VkResult result) { RecordCall(api_name); }
+
+   private:
+    static constexpr const char *kLayerIdentifier = "lunarg_latency_profiler";
+
+    // Timings recorded by one application thread. Only the owning thread records into the histograms, so the hot path
+    // takes no lock; the lock is held while the owner adds an entrypoint or the reporter walks the map.
+    struct ThreadProfile {
+        uint64_t start_time = 0;
+        std::mutex lock;
+        std::unordered_map<const char *, std::unique_ptr<vlf::LogLinearHistogram>> histograms;
+    };
+
+    ThreadProfile &GetThreadProfile() {
+        static thread_local ThreadProfile *thread_profile = nullptr;
+        if (thread_profile == nullptr) {
+            std::lock_guard<std::mutex> lock(threads_lock_);
+            threads_.emplace_back(new ThreadProfile);
+            thread_profile = threads_.back().get();
+        }
+        return *thread_profile;
+    }
+
+    void RecordCall(const char *api_name) {
+        uint64_t end_time = vlf::NowNanoseconds();
+        ThreadProfile &profile = GetThreadProfile();
+        // vkCreateInstance may be the first call seen on this thread; skip calls whose start was not recorded
+        if (profile.start_time == 0) return;
+        uint64_t duration = end_time - profile.start_time;
+        profile.start_time = 0;
+
+        auto it = profile.histograms.find(api_name);
+        if (it == profile.histograms.end()) {
+            std::lock_guard<std::mutex> lock(profile.lock);
+            it = profile.histograms.emplace(api_name, std::unique_ptr<vlf::LogLinearHistogram>(new vlf::LogLinearHistogram))
+                     .first;
+        }
+        it->second->Record(duration);
+    }
+
+    // Combines the histograms of all threads and prints the entrypoints ranked by total time spent below the layer
+    void Report(const std::string &when) {
+        std::lock_guard<std::mutex> report_lock(report_lock_);
+
+        // Name strings from different translation units may not share an address, so merge by value
+        std::map<std::string, std::unique_ptr<vlf::LogLinearHistogram>> merged;
+        {
+            std::lock_guard<std::mutex> lock(threads_lock_);
+            for (auto &thread_profile : threads_) {
+                std::lock_guard<std::mutex> thread_lock(thread_profile->lock);
+                for (auto &entry : thread_profile->histograms) {
+                    auto &histogram = merged[entry.first];
+                    if (!histogram) histogram.reset(new vlf::LogLinearHistogram);
+                    histogram->Merge(*entry.second);
+                }
+            }
+        }
+
+        std::vector<std::pair<std::string, const vlf::LogLinearHistogram *>> ranked;
+        uint64_t total_time = 0;
+        for (auto &entry : merged) {
+            ranked.emplace_back(entry.first, entry.second.get());
+            total_time += entry.second->Sum();
+        }
+        std::sort(ranked.begin(), ranked.end(),
+                  [](const std::pair<std::string, const vlf::LogLinearHistogram *> &a,
+                     const std::pair<std::string, const vlf::LogLinearHistogram *> &b) {
+                      return a.second->Sum() > b.second->Sum();
+                  });
+
+        std::string text;
+        char line[256];
+        snprintf(line, sizeof(line), "Latency profile %s (%zu entrypoints, %.3f ms total):\n", when.c_str(), ranked.size(),
+                 total_time / 1e6);
+        text += line;
+        snprintf(line, sizeof(line), "  %-40s %10s %12s %6s %10s %10s %10s %10s %10s\n", "entrypoint", "calls", "total ms", "%",
+                 "mean us", "p50 us", "p90 us", "p99 us", "max us");
+        text += line;
+        size_t shown = std::min<size_t>(ranked.size(), top_count_);
+        for (size_t i = 0; i < shown; ++i) {
+            const vlf::LogLinearHistogram &h = *ranked[i].second;
+            snprintf(line, sizeof(line), "  %-40s %10llu %12.3f %6.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                     ranked[i].first.c_str(), static_cast<unsigned long long>(h.Count()), h.Sum() / 1e6,
+                     total_time ? 100.0 * h.Sum() / total_time : 0.0, h.Mean() / 1e3, h.Percentile(0.5) / 1e3,
+                     h.Percentile(0.9) / 1e3, h.Percentile(0.99) / 1e3, h.Max() / 1e3);
+            text += line;
+        }
+        Print(text);
+
+        if (!export_file_.empty()) ExportCsv(ranked);
+    }
+
+    void ExportCsv(const std::vector<std::pair<std::string, const vlf::LogLinearHistogram *>> &ranked) {
+        FILE *file = fopen(export_file_.c_str(), "w");
+        if (file == nullptr) {
+            Warning("Latency profiler could not open export file " + export_file_);
+            return;
+        }
+        fprintf(file, "entrypoint,calls,total_ns,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+        for (auto &entry : ranked) {
+            const vlf::LogLinearHistogram &h = *entry.second;
+            fprintf(file, "%s,%llu,%llu,%.1f,%llu,%llu,%llu,%llu\n", entry.first.c_str(),
+                    static_cast<unsigned long long>(h.Count()), static_cast<unsigned long long>(h.Sum()), h.Mean(),
+                    static_cast<unsigned long long>(h.Percentile(0.5)), static_cast<unsigned long long>(h.Percentile(0.9)),
+                    static_cast<unsigned long long>(h.Percentile(0.99)), static_cast<unsigned long long>(h.Max()));
+        }
+        fclose(file);
+    }
+
+    // Settings
+    std::atomic<uint64_t> report_frames_;
+    uint64_t top_count_;
+    std::string export_file_;
+
+    std::atomic<uint64_t> frame_count_;
+    std::mutex report_lock_;
+    std::mutex threads_lock_;
+    std::vector<std::unique_ptr<ThreadProfile>> threads_;
+};
+
+LatencyProfiler latency_profiler;
@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "vlf_concurrency.h"
+#include "vlf_hash.h"
+#include "vlf_settings.h"
+
+// Device memory accounting, grown from the starter layer's MemAllocLevel. Every VkDeviceMemory is tracked with its
+// memory type, heap, size and the frame it was allocated in, along with the bytes of buffers and images bound to it.
+// A report of per-heap usage, high-water marks, bound/allocated efficiency and per-frame allocation churn is printed
+// periodically, and allocations still live when their device is destroyed are reported as leaks.
+//
+// Heaps are only known for physical devices whose memory properties the application queried; allocations on other
+// devices are counted under an unknown heap.
+//
+// Settings:
+//   lunarg_memory_accounting.report_frames  Print a report every N presents, 0 to disable (default 600)
+//   lunarg_memory_accounting.leak_count     Number of leaked allocations listed at vkDestroyDevice (default 20)
+class MemoryAccounting : public layer_factory {
+   public:
+    MemoryAccounting()
+        : layer_factory(this, kLayerIdentifier), report_frames_(600), leak_count_(20), frame_(0), interval_start_frame_(0){};
+
+    VkResult PostCallCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                    VkInstance *pInstance, VkResult result) {
+        report_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "report_frames", report_frames_);
+        leak_count_ = vlf::GetLayerSettingUint(kLayerIdentifier, "leak_count", leak_count_);
+        return VK_SUCCESS;
+    }
+
+    void PostCallGetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice,
+                                                   VkPhysicalDeviceMemoryProperties *pMemoryProperties) {
+        RecordMemoryProperties(physicalDevice, *pMemoryProperties);
+    }
+    void PostCallGetPhysicalDeviceMemoryProperties2(VkPhysicalDevice physicalDevice,
+                                                    VkPhysicalDeviceMemoryProperties2 *pMemoryProperties) {
+        RecordMemoryProperties(physicalDevice, pMemoryProperties->memoryProperties);
+    }
+    void PostCallGetPhysicalDeviceMemoryProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                       VkPhysicalDeviceMemoryProperties2KHR *pMemoryProperties) {
+        RecordMemoryProperties(physicalDevice, pMemoryProperties->memoryProperties);
+    }
+
+    VkResult PostCallCreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo,
+                                  const VkAllocationCallbacks *pAllocator, VkDevice *pDevice, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        devices_.Insert(*pDevice, std::make_shared<DeviceAccounting>(physicalDevice));
+        return VK_SUCCESS;
+    }
+
+    void PreCallDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+        std::shared_ptr<DeviceAccounting> accounting;
+        if (!devices_.Erase(device, &accounting)) return;
+        ReportLeaks(device);
+        allocations_.EraseIf([device](VkDeviceMemory, const Allocation &allocation) { return allocation.device == device; });
+        buffers_.EraseIf([device](VkBuffer, const Resource &resource) { return resource.device == device; });
+        images_.EraseIf([device](VkImage, const Resource &resource) { return resource.device == device; });
+    }
+
+    VkResult PostCallAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+                                    const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        std::shared_ptr<DeviceAccounting> accounting;
+        if (!devices_.Find(device, &accounting)) return VK_SUCCESS;
+
+        Allocation allocation = {};
+        allocation.device = device;
+        allocation.memory_type = pAllocateInfo->memoryTypeIndex;
+        allocation.heap = HeapIndex(accounting->physical_device, pAllocateInfo->memoryTypeIndex);
+        allocation.size = pAllocateInfo->allocationSize;
+        allocation.frame = frame_.load(std::memory_order_relaxed);
+        allocations_.Insert(*pMemory, allocation);
+
+        accounting->heaps[allocation.heap].Add(static_cast<int64_t>(allocation.size));
+        frame_allocations_.Increment();
+        frame_allocated_bytes_.Add(static_cast<int64_t>(allocation.size));
+        return VK_SUCCESS;
+    }
+
+    void PreCallFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *pAllocator) {
+        Allocation allocation;
+        if (memory == VK_NULL_HANDLE || !allocations_.Erase(memory, &allocation)) return;
+        std::shared_ptr<DeviceAccounting> accounting;
+        if (devices_.Find(device, &accounting)) {
+            accounting->heaps[allocation.heap].Add(-static_cast<int64_t>(allocation.size));
+        }
+        frame_frees_.Increment();
+        frame_freed_bytes_.Add(static_cast<int64_t>(allocation.size));
+    }
+
+    VkResult PostCallCreateBuffer(VkDevice device, const VkBufferCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                  VkBuffer *pBuffer, VkResult result) {
+        // The create size stands in for the memory requirements until the application queries them
+        if (result == VK_SUCCESS) buffers_.Insert(*pBuffer, Resource{device, pCreateInfo->size, VK_NULL_HANDLE});
+        return VK_SUCCESS;
+    }
+
+    VkResult PostCallCreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                 VkImage *pImage, VkResult result) {
+        if (result == VK_SUCCESS) images_.Insert(*pImage, Resource{device, 0, VK_NULL_HANDLE});
+        return VK_SUCCESS;
+    }
+
+    void PreCallDestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks *pAllocator) {
+        Resource resource;
+        if (buffer != VK_NULL_HANDLE && buffers_.Erase(buffer, &resource)) Unbind(resource);
+    }
+
+    void PreCallDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks *pAllocator) {
+        Resource resource;
+        if (image != VK_NULL_HANDLE && images_.Erase(image, &resource)) Unbind(resource);
+    }
+
+    void PostCallGetBufferMemoryRequirements(VkDevice device, VkBuffer buffer, VkMemoryRequirements *pMemoryRequirements) {
+        RecordRequirements(buffers_, device, buffer, pMemoryRequirements->size);
+    }
+    void PostCallGetBufferMemoryRequirements2(VkDevice device, const VkBufferMemoryRequirementsInfo2 *pInfo,
+                                              VkMemoryRequirements2 *pMemoryRequirements) {
+        RecordRequirements(buffers_, device, pInfo->buffer, pMemoryRequirements->memoryRequirements.size);
+    }
+    void PostCallGetBufferMemoryRequirements2KHR(VkDevice device, const VkBufferMemoryRequirementsInfo2KHR *pInfo,
+                                                 VkMemoryRequirements2KHR *pMemoryRequirements) {
+        RecordRequirements(buffers_, device, pInfo->buffer, pMemoryRequirements->memoryRequirements.size);
+    }
+    void PostCallGetImageMemoryRequirements(VkDevice device, VkImage image, VkMemoryRequirements *pMemoryRequirements) {
+        RecordRequirements(images_, device, image, pMemoryRequirements->size);
+    }
+    void PostCallGetImageMemoryRequirements2(VkDevice device, const VkImageMemoryRequirementsInfo2 *pInfo,
+                                             VkMemoryRequirements2 *pMemoryRequirements) {
+        RecordRequirements(images_, device, pInfo->image, pMemoryRequirements->memoryRequirements.size);
+    }
+    void PostCallGetImageMemoryRequirements2KHR(VkDevice device, const VkImageMemoryRequirementsInfo2KHR *pInfo,
+                                                VkMemoryRequirements2KHR *pMemoryRequirements) {
+        RecordRequirements(images_, device, pInfo->image, pMemoryRequirements->memoryRequirements.size);
+    }
+
+    VkResult PostCallBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset,
+                                      VkResult result) {
+        if (result == VK_SUCCESS) Bind(buffers_, device, buffer, memory);
+        return VK_SUCCESS;
+    }
+    VkResult PostCallBindBufferMemory2(VkDevice device, uint32_t bindInfoCount, const VkBindBufferMemoryInfo *pBindInfos,
+                                       VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        for (uint32_t i = 0; i < bindInfoCount; ++i) Bind(buffers_, device, pBindInfos[i].buffer, pBindInfos[i].memory);
+        return VK_SUCCESS;
+    }
+    VkResult PostCallBindBufferMemory2KHR(VkDevice device, uint32_t bindInfoCount, const VkBindBufferMemoryInfoKHR *pBindInfos,
+                                          VkResult result) {
+        return PostCallBindBufferMemory2(device, bindInfoCount, pBindInfos, result);
+    }
+    VkResult PostCallBindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory, VkDeviceSize memoryOffset,
+                                     VkResult result) {
+        if (result == VK_SUCCESS) Bind(images_, device, image, memory);
+        return VK_SUCCESS;
+    }
+    VkResult PostCallBindImageMemory2(VkDevice device, uint32_t bindInfoCount, const VkBindImageMemoryInfo *pBindInfos,
+                                      VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        for (uint32_t i = 0; i < bindInfoCount; ++i) Bind(images_, device, pBindInfos[i].image, pBindInfos[i].memory);
+        return VK_SUCCESS;
+    }
+    VkResult PostCallBindImageMemory2KHR(VkDevice device, uint32_t bindInfoCount, const VkBindImageMemoryInfoKHR *pBindInfos,
+                                         VkResult result) {
+        return PostCallBindImageMemory2(device, bindInfoCount, pBindInfos, result);
+    }
+
+    VkResult PostCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkResult result) {
+        uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed) + 1;
+        allocation_churn_.Record(static_cast<uint64_t>(frame_allocations_.Exchange()));
+        allocated_bytes_churn_.Record(static_cast<uint64_t>(frame_allocated_bytes_.Exchange()));
+        free_churn_.Record(static_cast<uint64_t>(frame_frees_.Exchange()));
+        freed_bytes_churn_.Record(static_cast<uint64_t>(frame_freed_bytes_.Exchange()));
+        uint64_t report_frames = report_frames_.load(std::memory_order_relaxed);
+        if (report_frames != 0 && frame % report_frames == 0) Report(frame);
+        return VK_SUCCESS;
+    }
+
+   private:
+    static constexpr const char *kLayerIdentifier = "lunarg_memory_accounting";
+    // Heap slot for allocations made before the memory properties of their physical device were seen
+    static const uint32_t kUnknownHeap = VK_MAX_MEMORY_HEAPS;
+
+    struct DeviceAccounting {
+        explicit DeviceAccounting(VkPhysicalDevice gpu) : physical_device(gpu) {}
+        VkPhysicalDevice physical_device;
+        vlf::HighWaterMark heaps[VK_MAX_MEMORY_HEAPS + 1];
+    };
+
+    struct Allocation {
+        VkDevice device;
+        uint32_t memory_type;
+        uint32_t heap;
+        VkDeviceSize size;
+        uint64_t frame;
+        VkDeviceSize bound_bytes;
+        uint32_t bound_resources;
+    };
+
+    // A buffer or image, its memory requirements size and the memory it is bound to
+    struct Resource {
+        VkDevice device;
+        VkDeviceSize size;
+        VkDeviceMemory memory;
+    };
+
+    struct HeapSummary {
+        uint32_t allocations = 0;
+        VkDeviceSize allocated_bytes = 0;
+        VkDeviceSize bound_bytes = 0;
+    };
+
+
+    static double Megabytes(uint64_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+    void RecordMemoryProperties(VkPhysicalDevice physical_device, const VkPhysicalDeviceMemoryProperties &properties) {
+        memory_properties_.Insert(physical_device, std::make_shared<VkPhysicalDeviceMemoryProperties>(properties));
+    }
+
+    uint32_t HeapIndex(VkPhysicalDevice physical_device, uint32_t memory_type) const {
+        std::shared_ptr<const VkPhysicalDeviceMemoryProperties> properties;
+        if (!memory_properties_.Find(physical_device, &properties) || memory_type >= properties->memoryTypeCount) {
+            return kUnknownHeap;
+        }
+        uint32_t heap = properties->memoryTypes[memory_type].heapIndex;
+        return heap < VK_MAX_MEMORY_HEAPS ? heap : kUnknownHeap;
+    }
+
+    template <typename Handle>
+    static void RecordRequirements(vlf::ConcurrentHandleMap<Handle, Resource> &resources, VkDevice device, Handle handle,
+                                   VkDeviceSize size) {
+        resources.Update(handle, [device, size](Resource &resource) {
+            resource.device = device;
+            resource.size = size;
+        });
+    }
+
+    template <typename Handle>
+    void Bind(vlf::ConcurrentHandleMap<Handle, Resource> &resources, VkDevice device, Handle handle, VkDeviceMemory memory) {
+        VkDeviceSize size = 0;
+        resources.Update(handle, [device, memory, &size](Resource &resource) {
+            resource.device = device;
+            resource.memory = memory;
+            size = resource.size;
+        });
+        allocations_.UpdateExisting(memory, [size](Allocation &allocation) {
+            allocation.bound_bytes += size;
+            allocation.bound_resources++;
+        });
+    }
+
+    void Unbind(const Resource &resource) {
+        if (resource.memory == VK_NULL_HANDLE) return;
+        VkDeviceSize size = resource.size;
+        allocations_.UpdateExisting(resource.memory, [size](Allocation &allocation) {
+            allocation.bound_bytes -= std::min(size, allocation.bound_bytes);
+            if (allocation.bound_resources) allocation.bound_resources--;
+        });
+    }
+
+    static std::string HeapName(uint32_t heap) {
+        return heap == kUnknownHeap ? std::string("unknown heap") : "heap " + std::to_string(heap);
+    }
+
+    void Report(uint64_t frame) {
+        std::lock_guard<std::mutex> lock(report_lock_);
+        std::map<VkDevice, std::map<uint32_t, HeapSummary>> summaries;
+        allocations_.ForEach([&summaries](VkDeviceMemory, const Allocation &allocation) {
+            HeapSummary &summary = summaries[allocation.device][allocation.heap];
+            summary.allocations++;
+            summary.allocated_bytes += allocation.size;
+            summary.bound_bytes += allocation.bound_bytes;
+        });
+
+        std::string text;
+        char line[256];
+        snprintf(line, sizeof(line), "Memory accounting at frame %" PRIu64 ":\n", frame);
+        text += line;
+        devices_.ForEach([&](VkDevice device, const std::shared_ptr<DeviceAccounting> &accounting) {
+            const std::map<uint32_t, HeapSummary> &heaps = summaries[device];
+            HeapSummary total;
+            for (const auto &heap : heaps) {
+                total.allocations += heap.second.allocations;
+                total.allocated_bytes += heap.second.allocated_bytes;
+                total.bound_bytes += heap.second.bound_bytes;
+            }
+            snprintf(line, sizeof(line), "  Device 0x%" PRIx64 ": %u allocations, %.2f MB allocated, %.2f MB bound (%.1f%%)\n",
+                     vlf::HandleValue(device), total.allocations, Megabytes(total.allocated_bytes), Megabytes(total.bound_bytes),
+                     total.allocated_bytes ? 100.0 * total.bound_bytes / total.allocated_bytes : 100.0);
+            text += line;
+            for (uint32_t heap = 0; heap <= kUnknownHeap; ++heap) {
+                const vlf::HighWaterMark &usage = accounting->heaps[heap];
+                if (usage.Peak() == 0) continue;
+                auto summary = heaps.find(heap);
+                HeapSummary current = summary != heaps.end() ? summary->second : HeapSummary();
+                snprintf(line, sizeof(line), "    %-12s %6u allocations, %10.2f MB (peak %.2f MB), %.1f%% bound\n",
+                         HeapName(heap).c_str(), current.allocations, Megabytes(current.allocated_bytes),
+                         Megabytes(usage.Peak()),
+                         current.allocated_bytes ? 100.0 * current.bound_bytes / current.allocated_bytes : 100.0);
+                text += line;
+            }
+        });
+
+        uint64_t frames = frame - interval_start_frame_;
+        interval_start_frame_ = frame;
+        snprintf(line, sizeof(line),
+                 "  Churn per frame over %" PRIu64 " frames: %.2f allocations (max %" PRIu64 "), %.2f MB allocated (max %.2f MB), "
+                 "%.2f frees (max %" PRIu64 "), %.2f MB freed (max %.2f MB)\n",
+                 frames, allocation_churn_.Mean(), allocation_churn_.Max(), Megabytes(allocated_bytes_churn_.Mean()),
+                 Megabytes(allocated_bytes_churn_.Max()), free_churn_.Mean(), free_churn_.Max(),
+                 Megabytes(freed_bytes_churn_.Mean()), Megabytes(freed_bytes_churn_.Max()));
+        text += line;
+        allocation_churn_.Reset();
+        allocated_bytes_churn_.Reset();
+        free_churn_.Reset();
+        freed_bytes_churn_.Reset();
+        Print(text);
+    }
+
+    // Lists the largest allocations the application did not free before destroying their device
+    void ReportLeaks(VkDevice device) {
+        std::vector<std::pair<VkDeviceMemory, Allocation>> leaks;
+        VkDeviceSize leaked_bytes = 0;
+        allocations_.ForEach([device, &leaks, &leaked_bytes](VkDeviceMemory memory, const Allocation &allocation) {
+            if (allocation.device != device) return;
+            leaks.emplace_back(memory, allocation);
+            leaked_bytes += allocation.size;
+        });
+        if (leaks.empty()) return;
+        std::sort(leaks.begin(), leaks.end(),
+                  [](const std::pair<VkDeviceMemory, Allocation> &a, const std::pair<VkDeviceMemory, Allocation> &b) {
+                      return a.second.size > b.second.size;
+                  });
+
+        std::string text;
+        char line[256];
+        snprintf(line, sizeof(line), "Memory accounting: device 0x%" PRIx64 " destroyed with %zu allocations (%.2f MB) not freed\n",
+                 vlf::HandleValue(device), leaks.size(), Megabytes(leaked_bytes));
+        text += line;
+        size_t shown = std::min<size_t>(leaks.size(), leak_count_);
+        for (size_t i = 0; i < shown; ++i) {
+            const Allocation &allocation = leaks[i].second;
+            snprintf(line, sizeof(line),
+                     "  VkDeviceMemory 0x%" PRIx64 ": %.2f MB, memory type %u, %s, allocated at frame %" PRIu64
+                     ", %u resources bound\n",
+                     vlf::HandleValue(leaks[i].first), Megabytes(allocation.size), allocation.memory_type,
+                     HeapName(allocation.heap).c_str(), allocation.frame, allocation.bound_resources);
+            text += line;
+        }
+        if (shown < leaks.size()) {
+            snprintf(line, sizeof(line), "  ... and %zu more\n", leaks.size() - shown);
+            text += line;
+        }
+        Print(text);
+    }
+
+    // Settings
+    std::atomic<uint64_t> report_frames_;
+    uint64_t leak_count_;
+
+    std::atomic<uint64_t> frame_;
+    std::mutex report_lock_;
+    uint64_t interval_start_frame_;
+
+    vlf::ConcurrentHandleMap<VkPhysicalDevice, std::shared_ptr<const VkPhysicalDeviceMemoryProperties>> memory_properties_;
+    vlf::ConcurrentHandleMap<VkDevice, std::shared_ptr<DeviceAccounting>> devices_;
+    vlf::ConcurrentHandleMap<VkDeviceMemory, Allocation> allocations_;
+    vlf::ConcurrentHandleMap<VkBuffer, Resource> buffers_;
+    vlf::ConcurrentHandleMap<VkImage, Resource> images_;
+
+    // Allocations and frees in the frame being recorded, moved into the per-frame statistics at each present
+    vlf::PerThreadCounter<> frame_allocations_;
+    vlf::PerThreadCounter<> frame_allocated_bytes_;
+    vlf::PerThreadCounter<> frame_frees_;
+    vlf::PerThreadCounter<> frame_freed_bytes_;
+    vlf::StatisticsAccumulator allocation_churn_;
+    vlf::StatisticsAccumulator allocated_bytes_churn_;
+    vlf::StatisticsAccumulator free_churn_;
+    vlf::StatisticsAccumulator freed_bytes_churn_;
+};
+
+MemoryAccounting memory_accounting;
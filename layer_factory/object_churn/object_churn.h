@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "vlf_concurrency.h"
+#include "vlf_hash.h"
+#include "vlf_settings.h"
+
+// Counts the objects an application creates and destroys every frame, and finds the ones that live only a few frames:
+// descriptor sets, descriptor pools, command pools, buffers, images, image views, framebuffers, samplers and fences.
+// Every object is attributed to a site, which is a hash of its type and creation parameters, so objects created with
+// the same parameters over and over are counted together; sites with many short-lived objects are candidates for
+// pooling or caching. An object is short-lived if it is destroyed fewer than lifetime_frames presents after it was
+// created, and objects created before the layer was loaded are not counted. Every report_frames presents it prints the
+// creations, destructions and short-lived objects per frame for each type, and the sites with the most short-lived
+// objects.
+//
+// Settings:
+//   lunarg_object_churn.report_frames    Print a summary every N presents, 0 to disable (default 600)
+//   lunarg_object_churn.top_count        Number of sites listed in the summary (default 10)
+//   lunarg_object_churn.lifetime_frames  Objects destroyed within this many presents are short-lived (default 3)
+class ObjectChurn : public layer_factory {
+   public:
+    ObjectChurn() : layer_factory(this, kLayerIdentifier), report_frames_(600), top_count_(10), lifetime_frames_(3), frame_(0){};
+
+    VkResult PostCallCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                    VkInstance *pInstance, VkResult result) {
+        report_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "report_frames", report_frames_);
+        top_count_ = vlf::GetLayerSettingUint(kLayerIdentifier, "top_count", top_count_);
+        lifetime_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "lifetime_frames", lifetime_frames_);
+        return VK_SUCCESS;
+    }
+
+    // Frames presented since the last periodic summary are reported at shutdown
+    void PreCallDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+        if (create_statistics_[0].Count() != 0) Report(frame_.load(std::memory_order_relaxed));
+    }
+
+    // Objects still alive when their device is destroyed are forgotten without being counted as destroyed
+    void PreCallDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+        for (auto &objects : objects_) {
+            objects.EraseIf([device](uint64_t, const ObjectInfo &object) { return object.device == device; });
+        }
+    }
+
+    VkResult PostCallCreateBuffer(VkDevice device, const VkBufferCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                  VkBuffer *pBuffer, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        const VkBufferCreateInfo &info = *pCreateInfo;
+        uint64_t signature = vlf::Hash(vlf::kHashSeed, info.flags, info.size, info.usage, info.sharingMode);
+        Created(kBuffer, device, vlf::HandleValue(*pBuffer), signature, [&info]() {
+            char text[128];
+            snprintf(text, sizeof(text), "size %" PRIu64 ", usage 0x%x, flags 0x%x", static_cast<uint64_t>(info.size),
+                     info.usage, info.flags);
+            return std::string(text);
+        });
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks *pAllocator) {
+        Destroyed(kBuffer, vlf::HandleValue(buffer));
+    }
+
+    VkResult PostCallCreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                 VkImage *pImage, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        const VkImageCreateInfo &info = *pCreateInfo;
+        uint64_t signature = vlf::Hash(vlf::kHashSeed, info.flags, info.imageType, info.format, info.extent.width);
+        signature = vlf::Hash(signature, info.extent.height, info.extent.depth, info.mipLevels, info.arrayLayers);
+        signature = vlf::Hash(signature, info.samples, info.tiling, info.usage);
+        Created(kImage, device, vlf::HandleValue(*pImage), signature, [&info]() {
+            char text[160];
+            snprintf(text, sizeof(text), "%ux%ux%u, format %d, %u levels, %u layers, %u samples, usage 0x%x", info.extent.width,
+                     info.extent.height, info.extent.depth, info.format, info.mipLevels, info.arrayLayers, info.samples,
+                     info.usage);
+            return std::string(text);
+        });
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks *pAllocator) {
+        Destroyed(kImage, vlf::HandleValue(image));
+    }
+
+    // The image is left out of the signature, so views recreated for every new image still share a site
+    VkResult PostCallCreateImageView(VkDevice device, const VkImageViewCreateInfo *pCreateInfo,
+                                     const VkAllocationCallbacks *pAllocator, VkImageView *pView, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        const VkImageViewCreateInfo &info = *pCreateInfo;
+        const VkImageSubresourceRange &range = info.subresourceRange;
+        uint64_t signature = vlf::Hash(vlf::kHashSeed, info.flags, info.viewType, info.format);
+        signature = vlf::Hash(signature, info.components.r, info.components.g, info.components.b, info.components.a);
+        signature = vlf::Hash(signature, range.aspectMask, range.baseMipLevel, range.levelCount);
+        signature = vlf::Hash(signature, range.baseArrayLayer, range.layerCount);
+        Created(kImageView, device, vlf::HandleValue(*pView), signature, [&info, &range]() {
+            char text[128];
+            snprintf(text, sizeof(text), "view type %d, format %d, aspect 0x%x, %u levels, %u layers", info.viewType, info.format,
+                     range.aspectMask, range.levelCount, range.layerCount);
+            return std::string(text);
+        });
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyImageView(VkDevice device, VkImageView imageView, const VkAllocationCallbacks *pAllocator) {
+        Destroyed(kImageView, vlf::HandleValue(imageView));
+    }
+
+    // Attachments are left out of the signature for the same reason as images are for views
+    VkResult PostCallCreateFramebuffer(VkDevice device, const VkFramebufferCreateInfo *pCreateInfo,
+                                       const VkAllocationCallbacks *pAllocator, VkFramebuffer *pFramebuffer, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        const VkFramebufferCreateInfo &info = *pCreateInfo;
+        uint64_t signature = vlf::Hash(vlf::kHashSeed, info.flags, vlf::HandleValue(info.renderPass), info.attachmentCount);
+        signature = vlf::Hash(signature, info.width, info.height, info.layers);
+        Created(kFramebuffer, device, vlf::HandleValue(*pFramebuffer), signature, [&info]() {
+            char text[128];
+            snprintf(text, sizeof(text), "%ux%ux%u, %u attachments, render pass 0x%" PRIx64, info.width, info.height, info.layers,
+                     info.attachmentCount, vlf::HandleValue(info.renderPass));
+            return std::string(text);
+        });
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer, const VkAllocationCallbacks *pAllocator) {
+        Destroyed(kFramebuffer, vlf::HandleValue(framebuffer));
+    }
+
+    // Every member after pNext is a 32-bit value, so they are hashed as one block
+    VkResult PostCallCreateSampler(VkDevice device, const VkSamplerCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                   VkSampler *pSampler, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        const VkSamplerCreateInfo &info = *pCreateInfo;
+        uint64_t signature =
+            vlf::HashBytes(vlf::kHashSeed, &info.flags, sizeof(VkSamplerCreateInfo) - offsetof(VkSamplerCreateInfo, flags));
+        Created(kSampler, device, vlf::HandleValue(*pSampler), signature, [&info]() {
+            char text[128];
+            snprintf(text, sizeof(text), "filters %d/%d/%d, address modes %d/%d/%d, anisotropy %.0f", info.magFilter,
+                     info.minFilter, info.mipmapMode, info.addressModeU, info.addressModeV, info.addressModeW,
+                     info.anisotropyEnable ? info.maxAnisotropy : 0.0f);
+            return std::string(text);
+        });
+        return VK_SUCCESS;
+    }
+    void PreCallDestroySampler(VkDevice device, VkSampler sampler, const VkAllocationCallbacks *pAllocator) {
+        Destroyed(kSampler, vlf::HandleValue(sampler));
+    }
+
+    VkResult PostCallCreateFence(VkDevice device, const VkFenceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                 VkFence *pFence, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        VkFenceCreateFlags flags = pCreateInfo->flags;
+        Created(kFence, device, vlf::HandleValue(*pFence), vlf::Hash(vlf::kHashSeed, flags), [flags]() {
+            char text[32];
+            snprintf(text, sizeof(text), "flags 0x%x", flags);
+            return std::string(text);
+        });
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyFence(VkDevice device, VkFence fence, const VkAllocationCallbacks *pAllocator) {
+        Destroyed(kFence, vlf::HandleValue(fence));
+    }
+
+    VkResult PostCallCreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+                                       const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        const VkCommandPoolCreateInfo &info = *pCreateInfo;
+        Created(kCommandPool, device, vlf::HandleValue(*pCommandPool), vlf::Hash(vlf::kHashSeed, info.flags, info.queueFamilyIndex),
+                [&info]() {
+                    char text[64];
+                    snprintf(text, sizeof(text), "queue family %u, flags 0x%x", info.queueFamilyIndex, info.flags);
+                    return std::string(text);
+                });
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks *pAllocator) {
+        Destroyed(kCommandPool, vlf::HandleValue(commandPool));
+    }
+
+    VkResult PostCallCreateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo *pCreateInfo,
+                                          const VkAllocationCallbacks *pAllocator, VkDescriptorPool *pDescriptorPool,
+                                          VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        const VkDescriptorPoolCreateInfo &info = *pCreateInfo;
+        uint64_t signature = vlf::Hash(vlf::kHashSeed, info.flags, info.maxSets);
+        for (uint32_t i = 0; i < info.poolSizeCount; ++i) {
+            signature = vlf::Hash(signature, info.pPoolSizes[i].type, info.pPoolSizes[i].descriptorCount);
+        }
+        Created(kDescriptorPool, device, vlf::HandleValue(*pDescriptorPool), signature, [&info]() {
+            char text[96];
+            snprintf(text, sizeof(text), "%u sets, %u pool sizes, flags 0x%x", info.maxSets, info.poolSizeCount, info.flags);
+            return std::string(text);
+        });
+        return VK_SUCCESS;
+    }
+    // Destroying or resetting a pool frees its descriptor sets
+    void PreCallDestroyDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, const VkAllocationCallbacks *pAllocator) {
+        FreePool(vlf::HandleValue(descriptorPool));
+        Destroyed(kDescriptorPool, vlf::HandleValue(descriptorPool));
+    }
+    VkResult PreCallResetDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorPoolResetFlags flags) {
+        FreePool(vlf::HandleValue(descriptorPool));
+        return VK_SUCCESS;
+    }
+
+    VkResult PostCallAllocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo *pAllocateInfo,
+                                            VkDescriptorSet *pDescriptorSets, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        uint64_t pool = vlf::HandleValue(pAllocateInfo->descriptorPool);
+        for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i) {
+            uint64_t layout = vlf::HandleValue(pAllocateInfo->pSetLayouts[i]);
+            Created(kDescriptorSet, device, vlf::HandleValue(pDescriptorSets[i]), vlf::Hash(vlf::kHashSeed, layout),
+                    [layout]() {
+                        char text[48];
+                        snprintf(text, sizeof(text), "layout 0x%" PRIx64, layout);
+                        return std::string(text);
+                    },
+                    pool);
+        }
+        return VK_SUCCESS;
+    }
+    VkResult PreCallFreeDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool, uint32_t descriptorSetCount,
+                                       const VkDescriptorSet *pDescriptorSets) {
+        for (uint32_t i = 0; i < descriptorSetCount; ++i) Destroyed(kDescriptorSet, vlf::HandleValue(pDescriptorSets[i]));
+        return VK_SUCCESS;
+    }
+
+    VkResult PostCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkResult result) {
+        uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed) + 1;
+        for (int type = 0; type < kObjectTypeCount; ++type) {
+            create_statistics_[type].Record(static_cast<uint64_t>(creates_[type].Exchange()));
+            destroy_statistics_[type].Record(static_cast<uint64_t>(destroys_[type].Exchange()));
+            short_lived_statistics_[type].Record(static_cast<uint64_t>(short_lived_[type].Exchange()));
+        }
+        uint64_t report_frames = report_frames_.load(std::memory_order_relaxed);
+        if (report_frames != 0 && frame % report_frames == 0) Report(frame);
+        return VK_SUCCESS;
+    }
+
+   private:
+    static constexpr const char *kLayerIdentifier = "lunarg_object_churn";
+
+    enum ObjectType {
+        kDescriptorSet,
+        kDescriptorPool,
+        kCommandPool,
+        kBuffer,
+        kImage,
+        kImageView,
+        kFramebuffer,
+        kSampler,
+        kFence,
+        kObjectTypeCount
+    };
+
+    struct ObjectInfo {
+        VkDevice device;
+        uint64_t pool;  // Descriptor pool of a descriptor set
+        uint64_t signature;
+        uint64_t frame;
+    };
+
+    // Objects of one type created with the same parameters
+    struct Site {
+        ObjectType type = kObjectTypeCount;
+        std::string description;
+        uint64_t created = 0;
+        uint64_t short_lived = 0;
+        uint64_t short_lived_frames = 0;
+    };
+
+
+    // The description is only built the first time a site is seen
+    void Created(ObjectType type, VkDevice device, uint64_t handle, uint64_t signature,
+                 const std::function<std::string()> &describe, uint64_t pool = 0) {
+        signature = vlf::Hash(signature, type);
+        if (!sites_.UpdateExisting(signature, [](Site &site) { ++site.created; })) {
+            std::string description = describe();
+            sites_.Update(signature, [&](Site &site) {
+                if (site.description.empty()) {
+                    site.type = type;
+                    site.description = description;
+                }
+                ++site.created;
+            });
+        }
+        objects_[type].Insert(handle, ObjectInfo{device, pool, signature, frame_.load(std::memory_order_relaxed)});
+        creates_[type].Add(1);
+    }
+
+    void Destroyed(ObjectType type, uint64_t handle) {
+        ObjectInfo object;
+        if (objects_[type].Erase(handle, &object)) Destroyed(type, object);
+    }
+    void Destroyed(ObjectType type, const ObjectInfo &object) {
+        destroys_[type].Add(1);
+        uint64_t lifetime = frame_.load(std::memory_order_relaxed) - object.frame;
+        if (lifetime >= lifetime_frames_.load(std::memory_order_relaxed)) return;
+        short_lived_[type].Add(1);
+        sites_.UpdateExisting(object.signature, [lifetime](Site &site) {
+            ++site.short_lived;
+            site.short_lived_frames += lifetime;
+        });
+    }
+
+    void FreePool(uint64_t pool) {
+        std::vector<ObjectInfo> freed;
+        objects_[kDescriptorSet].EraseIf([pool, &freed](uint64_t, const ObjectInfo &object) {
+            if (object.pool != pool) return false;
+            freed.push_back(object);
+            return true;
+        });
+        for (const auto &object : freed) Destroyed(kDescriptorSet, object);
+    }
+
+    void Report(uint64_t frame) {
+        static const char *const type_names[] = {"VkDescriptorSet", "VkDescriptorPool", "VkCommandPool",
+                                                 "VkBuffer",        "VkImage",          "VkImageView",
+                                                 "VkFramebuffer",   "VkSampler",        "VkFence"};
+        std::string text;
+        char line[256];
+        snprintf(line, sizeof(line), "Object churn after %" PRIu64 " frames, mean per frame (lifetime under %" PRIu64 " frames):\n",
+                 frame, lifetime_frames_.load(std::memory_order_relaxed));
+        text += line;
+        for (int type = 0; type < kObjectTypeCount; ++type) {
+            if (create_statistics_[type].Sum() == 0 && destroy_statistics_[type].Sum() == 0) continue;
+            snprintf(line, sizeof(line), "  %-16s %10.1f created %10.1f destroyed %10.1f short-lived (max %" PRIu64 ")\n",
+                     type_names[type], create_statistics_[type].Mean(), destroy_statistics_[type].Mean(),
+                     short_lived_statistics_[type].Mean(), short_lived_statistics_[type].Max());
+            text += line;
+        }
+
+        std::vector<std::pair<uint64_t, Site>> sites;
+        sites_.ForEach([&sites](uint64_t signature, const Site &site) {
+            if (site.short_lived) sites.emplace_back(signature, site);
+        });
+        size_t count = std::min<size_t>(sites.size(), top_count_.load(std::memory_order_relaxed));
+        std::partial_sort(sites.begin(), sites.begin() + count, sites.end(),
+                          [](const std::pair<uint64_t, Site> &a, const std::pair<uint64_t, Site> &b) {
+                              return a.second.short_lived > b.second.short_lived;
+                          });
+        if (count) text += "  Sites with the most short-lived objects since start:\n";
+        for (size_t i = 0; i < count; ++i) {
+            const Site &site = sites[i].second;
+            double mean_lifetime = static_cast<double>(site.short_lived_frames) / site.short_lived;
+            snprintf(line, sizeof(line), "  %016" PRIx64 " %10" PRIu64 " of %10" PRIu64 " short-lived, %4.1f frames mean  %s %s\n",
+                     sites[i].first, site.short_lived, site.created, mean_lifetime, type_names[site.type],
+                     site.description.c_str());
+            text += line;
+        }
+        Print(text);
+        for (int type = 0; type < kObjectTypeCount; ++type) {
+            create_statistics_[type].Reset();
+            destroy_statistics_[type].Reset();
+            short_lived_statistics_[type].Reset();
+        }
+    }
+
+    // Settings
+    std::atomic<uint64_t> report_frames_;
+    std::atomic<uint64_t> top_count_;
+    std::atomic<uint64_t> lifetime_frames_;
+
+    // Handles of different object types may compare equal, so each type has its own map
+    vlf::ConcurrentHandleMap<uint64_t, ObjectInfo> objects_[kObjectTypeCount];
+    vlf::ConcurrentHandleMap<uint64_t, Site> sites_;
+
+    std::atomic<uint64_t> frame_;
+    vlf::PerThreadCounter<> creates_[kObjectTypeCount];
+    vlf::PerThreadCounter<> destroys_[kObjectTypeCount];
+    vlf::PerThreadCounter<> short_lived_[kObjectTypeCount];
+    vlf::StatisticsAccumulator create_statistics_[kObjectTypeCount];
+    vlf::StatisticsAccumulator destroy_statistics_[kObjectTypeCount];
+    vlf::StatisticsAccumulator short_lived_statistics_[kObjectTypeCount];
+};
+
+ObjectChurn object_churn;
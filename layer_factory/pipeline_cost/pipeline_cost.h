@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "vlf_concurrency.h"
+#include "vlf_histogram.h"
+#include "vlf_settings.h"
+
+// Measures the cost of pipeline creation. Every vkCreateGraphicsPipelines, vkCreateComputePipelines and
+// vkCreateRayTracingPipelinesKHR call is timed, and each pipeline it creates is recorded with its creation time, whether
+// a VkPipelineCache was supplied, whether the cache was hit, and the hashes of its shader modules' SPIR-V.
+//
+// Per-pipeline times and cache hits come from VK_EXT_pipeline_creation_feedback when the application chains a
+// VkPipelineCreationFeedbackCreateInfoEXT; otherwise the call's time is split evenly between its pipelines and the cache
+// outcome is unknown. Pipelines created after the first present on the thread that presents are flagged as created on
+// the render thread during frames, as they are the likely cause of hitches.
+//
+// Settings:
+//   lunarg_pipeline_cost.report_frames  Print a report every N presents, 0 to report only at exit (default 0)
+//   lunarg_pipeline_cost.top_count      Number of slowest pipelines listed in each report (default 10)
+class PipelineCost : public layer_factory {
+   public:
+    PipelineCost()
+        : layer_factory(this, kLayerIdentifier), report_frames_(0), top_count_(10), frame_count_(0), render_thread_(kNoThread){};
+
+    VkResult PostCallCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                    VkInstance *pInstance, VkResult result) {
+        std::lock_guard<std::mutex> lock(lock_);
+        report_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "report_frames", report_frames_);
+        top_count_ = vlf::GetLayerSettingUint(kLayerIdentifier, "top_count", top_count_);
+        return VK_SUCCESS;
+    }
+
+    void PostCallDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+        Report("at vkDestroyInstance");
+    }
+
+    VkResult PostCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkResult result) {
+        render_thread_.store(vlf::CurrentThreadIndex(), std::memory_order_relaxed);
+        uint64_t frame = ++frame_count_;
+        uint64_t report_frames = report_frames_.load(std::memory_order_relaxed);
+        if (report_frames != 0 && frame % report_frames == 0) {
+            Report("after " + std::to_string(frame) + " frames");
+        }
+        return VK_SUCCESS;
+    }
+
+    VkResult PostCallCreateShaderModule(VkDevice device, const VkShaderModuleCreateInfo *pCreateInfo,
+                                        const VkAllocationCallbacks *pAllocator, VkShaderModule *pShaderModule, VkResult result) {
+        if (result == VK_SUCCESS) shader_hashes_.Insert(*pShaderModule, HashSpirv(pCreateInfo->pCode, pCreateInfo->codeSize));
+        return VK_SUCCESS;
+    }
+
+    void PreCallDestroyShaderModule(VkDevice device, VkShaderModule shaderModule, const VkAllocationCallbacks *pAllocator) {
+        shader_hashes_.Erase(shaderModule);
+    }
+
+    VkResult PreCallCreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+                                            const VkGraphicsPipelineCreateInfo *pCreateInfos,
+                                            const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallCreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+                                             const VkGraphicsPipelineCreateInfo *pCreateInfos,
+                                             const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines, VkResult result) {
+        RecordCall(kGraphics, pipelineCache, createInfoCount, pCreateInfos, pPipelines);
+        return VK_SUCCESS;
+    }
+
+    VkResult PreCallCreateComputePipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+                                           const VkComputePipelineCreateInfo *pCreateInfos,
+                                           const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallCreateComputePipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+                                            const VkComputePipelineCreateInfo *pCreateInfos,
+                                            const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines, VkResult result) {
+        RecordCall(kCompute, pipelineCache, createInfoCount, pCreateInfos, pPipelines);
+        return VK_SUCCESS;
+    }
+
+#ifdef VK_ENABLE_BETA_EXTENSIONS
+    VkResult PreCallCreateRayTracingPipelinesKHR(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+                                                 const VkRayTracingPipelineCreateInfoKHR *pCreateInfos,
+                                                 const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallCreateRayTracingPipelinesKHR(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+                                                  const VkRayTracingPipelineCreateInfoKHR *pCreateInfos,
+                                                  const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines,
+                                                  VkResult result) {
+        RecordCall(kRayTracing, pipelineCache, createInfoCount, pCreateInfos, pPipelines);
+        return VK_SUCCESS;
+    }
+#endif
+
+   private:
+    static constexpr const char *kLayerIdentifier = "lunarg_pipeline_cost";
+    static const uint32_t kNoThread = std::numeric_limits<uint32_t>::max();
+
+    enum PipelineKind { kGraphics, kCompute, kRayTracing, kPipelineKindCount };
+    enum CacheOutcome { kNoCache, kCacheHit, kCacheMiss, kCacheUnknown };
+
+    struct PipelineRecord {
+        PipelineKind kind;
+        uint64_t duration;
+        CacheOutcome cache;
+        bool render_thread;
+        uint64_t frame;
+        std::vector<uint64_t> shader_hashes;
+    };
+
+    struct KindStatistics {
+        uint64_t calls = 0;
+        uint64_t call_time = 0;
+        uint64_t pipelines = 0;
+        uint64_t cached = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t render_thread = 0;
+        uint64_t render_thread_time = 0;
+    };
+
+    static const char *KindName(PipelineKind kind) {
+        static const char *const names[] = {"graphics", "compute", "ray tracing"};
+        return names[kind];
+    }
+    static const char *CacheName(CacheOutcome cache) {
+        static const char *const names[] = {"none", "hit", "miss", "unknown"};
+        return names[cache];
+    }
+
+    // FNV-1a over the SPIR-V words, so the same shader gets the same hash in every run
+    static uint64_t HashSpirv(const uint32_t *code, size_t size) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < size / sizeof(uint32_t); ++i) {
+            hash ^= code[i];
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    static uint64_t &StartTime() {
+        static thread_local uint64_t start_time = 0;
+        return start_time;
+    }
+    void StartTimer() { StartTime() = vlf::NowNanoseconds(); }
+
+    static const VkPipelineCreationFeedbackEXT *FindCreationFeedback(const void *next) {
+        for (auto *structure = static_cast<const VkBaseInStructure *>(next); structure; structure = structure->pNext) {
+            if (structure->sType == VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT) {
+                auto feedback = reinterpret_cast<const VkPipelineCreationFeedbackCreateInfoEXT *>(structure);
+                if (feedback->pPipelineCreationFeedback &&
+                    (feedback->pPipelineCreationFeedback->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+                    return feedback->pPipelineCreationFeedback;
+                }
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    void AddShaderHash(VkShaderModule module, std::vector<uint64_t> *hashes) const {
+        uint64_t hash = 0;
+        if (module != VK_NULL_HANDLE && shader_hashes_.Find(module, &hash)) hashes->push_back(hash);
+    }
+    void GetShaderHashes(const VkGraphicsPipelineCreateInfo &create_info, std::vector<uint64_t> *hashes) const {
+        for (uint32_t i = 0; i < create_info.stageCount; ++i) AddShaderHash(create_info.pStages[i].module, hashes);
+    }
+    void GetShaderHashes(const VkComputePipelineCreateInfo &create_info, std::vector<uint64_t> *hashes) const {
+        AddShaderHash(create_info.stage.module, hashes);
+    }
+#ifdef VK_ENABLE_BETA_EXTENSIONS
+    void GetShaderHashes(const VkRayTracingPipelineCreateInfoKHR &create_info, std::vector<uint64_t> *hashes) const {
+        for (uint32_t i = 0; i < create_info.stageCount; ++i) AddShaderHash(create_info.pStages[i].module, hashes);
+    }
+#endif
+
+    template <typename CreateInfo>
+    void RecordCall(PipelineKind kind, VkPipelineCache pipeline_cache, uint32_t count, const CreateInfo *create_infos,
+                    const VkPipeline *pipelines) {
+        uint64_t end_time = vlf::NowNanoseconds();
+        uint64_t start_time = StartTime();
+        if (start_time == 0) return;
+        StartTime() = 0;
+        uint64_t call_time = end_time - start_time;
+        uint32_t render_thread = render_thread_.load(std::memory_order_relaxed);
+        bool on_render_thread = render_thread != kNoThread && render_thread == vlf::CurrentThreadIndex();
+        uint64_t frame = frame_count_.load(std::memory_order_relaxed);
+
+        std::vector<PipelineRecord> records;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (pipelines[i] == VK_NULL_HANDLE) continue;
+            PipelineRecord record = {kind, count ? call_time / count : 0, kCacheUnknown, on_render_thread, frame, {}};
+            const VkPipelineCreationFeedbackEXT *feedback = FindCreationFeedback(create_infos[i].pNext);
+            if (pipeline_cache == VK_NULL_HANDLE) {
+                record.cache = kNoCache;
+            } else if (feedback) {
+                bool hit = (feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0;
+                record.cache = hit ? kCacheHit : kCacheMiss;
+            }
+            if (feedback) record.duration = feedback->duration;
+            GetShaderHashes(create_infos[i], &record.shader_hashes);
+            records.push_back(std::move(record));
+        }
+
+        if (on_render_thread && !records.empty()) {
+            char line[160];
+            snprintf(line, sizeof(line), "%zu %s pipeline(s) created on the render thread during frame %" PRIu64 ", taking %.3f ms",
+                     records.size(), KindName(kind), frame, call_time / 1e6);
+            PerformanceWarning(line);
+        }
+
+        std::lock_guard<std::mutex> lock(lock_);
+        KindStatistics &statistics = statistics_[kind];
+        ++statistics.calls;
+        statistics.call_time += call_time;
+        for (auto &record : records) {
+            ++statistics.pipelines;
+            if (record.cache != kNoCache) ++statistics.cached;
+            if (record.cache == kCacheHit) ++statistics.hits;
+            if (record.cache == kCacheMiss) ++statistics.misses;
+            if (record.render_thread) {
+                ++statistics.render_thread;
+                statistics.render_thread_time += record.duration;
+            }
+            KeepIfSlowest(std::move(record));
+        }
+    }
+
+    // Keeps the top_count slowest pipelines as a min-heap on duration. Called with lock_ held.
+    void KeepIfSlowest(PipelineRecord &&record) {
+        auto faster = [](const PipelineRecord &a, const PipelineRecord &b) { return a.duration > b.duration; };
+        if (slowest_.size() < top_count_) {
+            slowest_.push_back(std::move(record));
+            std::push_heap(slowest_.begin(), slowest_.end(), faster);
+        } else if (!slowest_.empty() && record.duration > slowest_.front().duration) {
+            std::pop_heap(slowest_.begin(), slowest_.end(), faster);
+            slowest_.back() = std::move(record);
+            std::push_heap(slowest_.begin(), slowest_.end(), faster);
+        }
+    }
+
+    void Report(const std::string &when) {
+        std::lock_guard<std::mutex> lock(lock_);
+        std::string text;
+        char line[256];
+        snprintf(line, sizeof(line), "Pipeline creation %s:\n", when.c_str());
+        text += line;
+        for (int kind = 0; kind < kPipelineKindCount; ++kind) {
+            const KindStatistics &statistics = statistics_[kind];
+            if (statistics.calls == 0) continue;
+            snprintf(line, sizeof(line),
+                     "  %-11s %6" PRIu64 " pipelines in %6" PRIu64 " calls, %10.3f ms total, %8.3f ms per pipeline; cache supplied "
+                     "for %" PRIu64 " (%" PRIu64 " hits, %" PRIu64 " misses)\n",
+                     KindName(static_cast<PipelineKind>(kind)), statistics.pipelines, statistics.calls, statistics.call_time / 1e6,
+                     statistics.pipelines ? statistics.call_time / 1e6 / statistics.pipelines : 0.0, statistics.cached,
+                     statistics.hits, statistics.misses);
+            text += line;
+            if (statistics.render_thread) {
+                snprintf(line, sizeof(line), "  %-11s %6" PRIu64 " pipelines created on the render thread during frames, %.3f ms\n",
+                         "", statistics.render_thread, statistics.render_thread_time / 1e6);
+                text += line;
+            }
+        }
+
+        std::vector<PipelineRecord> slowest(slowest_);
+        std::sort(slowest.begin(), slowest.end(),
+                  [](const PipelineRecord &a, const PipelineRecord &b) { return a.duration > b.duration; });
+        if (!slowest.empty()) {
+            snprintf(line, sizeof(line), "  Slowest pipelines:\n  %10s %-11s %-7s %8s %-6s %s\n", "ms", "kind", "cache", "frame",
+                     "render", "shader modules");
+            text += line;
+        }
+        for (const auto &record : slowest) {
+            snprintf(line, sizeof(line), "  %10.3f %-11s %-7s %8" PRIu64 " %-6s", record.duration / 1e6, KindName(record.kind),
+                     CacheName(record.cache), record.frame, record.render_thread ? "yes" : "no");
+            text += line;
+            for (uint64_t hash : record.shader_hashes) {
+                snprintf(line, sizeof(line), " %016" PRIx64, hash);
+                text += line;
+            }
+            text += "\n";
+        }
+        Print(text);
+    }
+
+    // Settings
+    std::atomic<uint64_t> report_frames_;
+    uint64_t top_count_;
+
+    std::atomic<uint64_t> frame_count_;
+    // Thread index of the most recent vkQueuePresentKHR caller
+    std::atomic<uint32_t> render_thread_;
+    vlf::ConcurrentHandleMap<VkShaderModule, uint64_t> shader_hashes_;
+
+    std::mutex lock_;
+    KindStatistics statistics_[kPipelineKindCount];
+    std::vector<PipelineRecord> slowest_;
+};
+
+PipelineCost pipeline_cost;
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "vlf_concurrency.h"
+
+// Answers repeated physical device queries whose results cannot change while the instance exists, without calling
+// down the layer stack. The first call for a given set of parameters goes to the driver and its result is stored; later
+// calls are served from lock-free tables and skipped. Covered are vkGetPhysicalDeviceFormatProperties,
+// vkGetPhysicalDeviceImageFormatProperties and vkGetPhysicalDeviceQueueFamilyProperties, with their *2 and *2KHR forms.
+//
+// Calls whose input or output structures carry a pNext chain always go to the driver, as the chained structures may
+// hold results that are not stored. The tables are emptied, and their entries freed, at vkDestroyInstance, since a
+// later instance may reuse physical device handle values.
+class QueryCache : public layer_factory {
+   public:
+    QueryCache() : layer_factory(this, "lunarg_query_cache"){};
+
+    void PostCallDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+        int64_t hits = hits_.Exchange();
+        int64_t misses = misses_.Exchange();
+        if (hits + misses > 0) {
+            char line[160];
+            snprintf(line, sizeof(line), "Query cache: %lld of %lld physical device queries answered from the cache\n",
+                     static_cast<long long>(hits), static_cast<long long>(hits + misses));
+            Print(line);
+        }
+        format_properties_.Clear();
+        image_format_properties_.Clear();
+        queue_family_counts_.Clear();
+        queue_families_.Clear();
+    }
+
+    void PreCallGetPhysicalDeviceFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                  VkFormatProperties *pFormatProperties) {
+        LookUpFormatProperties(physicalDevice, format, pFormatProperties);
+    }
+    void PostCallGetPhysicalDeviceFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                   VkFormatProperties *pFormatProperties) {
+        if (!Served()) StoreFormatProperties(physicalDevice, format, *pFormatProperties);
+    }
+    void PreCallGetPhysicalDeviceFormatProperties2(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                   VkFormatProperties2 *pFormatProperties) {
+        if (!pFormatProperties->pNext) LookUpFormatProperties(physicalDevice, format, &pFormatProperties->formatProperties);
+    }
+    void PostCallGetPhysicalDeviceFormatProperties2(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                    VkFormatProperties2 *pFormatProperties) {
+        if (Served()) return;
+        if (pFormatProperties->pNext) {
+            misses_.Increment();
+        } else {
+            StoreFormatProperties(physicalDevice, format, pFormatProperties->formatProperties);
+        }
+    }
+    void PreCallGetPhysicalDeviceFormatProperties2KHR(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                      VkFormatProperties2 *pFormatProperties) {
+        PreCallGetPhysicalDeviceFormatProperties2(physicalDevice, format, pFormatProperties);
+    }
+    void PostCallGetPhysicalDeviceFormatProperties2KHR(VkPhysicalDevice physicalDevice, VkFormat format,
+                                                       VkFormatProperties2 *pFormatProperties) {
+        PostCallGetPhysicalDeviceFormatProperties2(physicalDevice, format, pFormatProperties);
+    }
+
+    VkResult PreCallGetPhysicalDeviceImageFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format, VkImageType type,
+                                                           VkImageTiling tiling, VkImageUsageFlags usage,
+                                                           VkImageCreateFlags flags,
+                                                           VkImageFormatProperties *pImageFormatProperties) {
+        LookUpImageFormatProperties({physicalDevice, format, type, tiling, usage, flags}, pImageFormatProperties);
+        return VK_SUCCESS;
+    }
+    VkResult PostCallGetPhysicalDeviceImageFormatProperties(VkPhysicalDevice physicalDevice, VkFormat format, VkImageType type,
+                                                            VkImageTiling tiling, VkImageUsageFlags usage,
+                                                            VkImageCreateFlags flags,
+                                                            VkImageFormatProperties *pImageFormatProperties, VkResult result) {
+        if (!Served()) {
+            StoreImageFormatProperties({physicalDevice, format, type, tiling, usage, flags}, *pImageFormatProperties, result);
+        }
+        return VK_SUCCESS;
+    }
+    VkResult PreCallGetPhysicalDeviceImageFormatProperties2(VkPhysicalDevice physicalDevice,
+                                                            const VkPhysicalDeviceImageFormatInfo2 *pImageFormatInfo,
+                                                            VkImageFormatProperties2 *pImageFormatProperties) {
+        if (!pImageFormatInfo->pNext && !pImageFormatProperties->pNext) {
+            LookUpImageFormatProperties(MakeImageFormatKey(physicalDevice, *pImageFormatInfo),
+                                        &pImageFormatProperties->imageFormatProperties);
+        }
+        return VK_SUCCESS;
+    }
+    VkResult PostCallGetPhysicalDeviceImageFormatProperties2(VkPhysicalDevice physicalDevice,
+                                                             const VkPhysicalDeviceImageFormatInfo2 *pImageFormatInfo,
+                                                             VkImageFormatProperties2 *pImageFormatProperties, VkResult result) {
+        if (Served()) return VK_SUCCESS;
+        if (pImageFormatInfo->pNext || pImageFormatProperties->pNext) {
+            misses_.Increment();
+        } else {
+            StoreImageFormatProperties(MakeImageFormatKey(physicalDevice, *pImageFormatInfo),
+                                       pImageFormatProperties->imageFormatProperties, result);
+        }
+        return VK_SUCCESS;
+    }
+    VkResult PreCallGetPhysicalDeviceImageFormatProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                               const VkPhysicalDeviceImageFormatInfo2 *pImageFormatInfo,
+                                                               VkImageFormatProperties2 *pImageFormatProperties) {
+        return PreCallGetPhysicalDeviceImageFormatProperties2(physicalDevice, pImageFormatInfo, pImageFormatProperties);
+    }
+    VkResult PostCallGetPhysicalDeviceImageFormatProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                                const VkPhysicalDeviceImageFormatInfo2 *pImageFormatInfo,
+                                                                VkImageFormatProperties2 *pImageFormatProperties,
+                                                                VkResult result) {
+        return PostCallGetPhysicalDeviceImageFormatProperties2(physicalDevice, pImageFormatInfo, pImageFormatProperties,
+                                                               result);
+    }
+
+    void PreCallGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice physicalDevice, uint32_t *pQueueFamilyPropertyCount,
+                                                       VkQueueFamilyProperties *pQueueFamilyProperties) {
+        if (pQueueFamilyProperties == nullptr) {
+            LookUpQueueFamilyCount(physicalDevice, pQueueFamilyPropertyCount);
+            return;
+        }
+        std::vector<VkQueueFamilyProperties> families;
+        if (!queue_families_.Find(physicalDevice, &families)) return;
+        *pQueueFamilyPropertyCount = std::min(*pQueueFamilyPropertyCount, static_cast<uint32_t>(families.size()));
+        std::copy(families.begin(), families.begin() + *pQueueFamilyPropertyCount, pQueueFamilyProperties);
+        ServeFromCache();
+    }
+    void PostCallGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice physicalDevice, uint32_t *pQueueFamilyPropertyCount,
+                                                        VkQueueFamilyProperties *pQueueFamilyProperties) {
+        if (Served()) return;
+        misses_.Increment();
+        if (pQueueFamilyProperties == nullptr) {
+            queue_family_counts_.Insert(physicalDevice, *pQueueFamilyPropertyCount);
+        } else if (IsCompleteQueueFamilyList(physicalDevice, *pQueueFamilyPropertyCount)) {
+            queue_families_.Insert(physicalDevice, std::vector<VkQueueFamilyProperties>(
+                                                       pQueueFamilyProperties, pQueueFamilyProperties + *pQueueFamilyPropertyCount));
+        }
+    }
+    void PreCallGetPhysicalDeviceQueueFamilyProperties2(VkPhysicalDevice physicalDevice, uint32_t *pQueueFamilyPropertyCount,
+                                                        VkQueueFamilyProperties2 *pQueueFamilyProperties) {
+        if (pQueueFamilyProperties == nullptr) {
+            LookUpQueueFamilyCount(physicalDevice, pQueueFamilyPropertyCount);
+            return;
+        }
+        if (HasChainedOutput(*pQueueFamilyPropertyCount, pQueueFamilyProperties)) return;
+        std::vector<VkQueueFamilyProperties> families;
+        if (!queue_families_.Find(physicalDevice, &families)) return;
+        *pQueueFamilyPropertyCount = std::min(*pQueueFamilyPropertyCount, static_cast<uint32_t>(families.size()));
+        for (uint32_t i = 0; i < *pQueueFamilyPropertyCount; ++i) {
+            pQueueFamilyProperties[i].queueFamilyProperties = families[i];
+        }
+        ServeFromCache();
+    }
+    void PostCallGetPhysicalDeviceQueueFamilyProperties2(VkPhysicalDevice physicalDevice, uint32_t *pQueueFamilyPropertyCount,
+                                                         VkQueueFamilyProperties2 *pQueueFamilyProperties) {
+        if (Served()) return;
+        misses_.Increment();
+        if (pQueueFamilyProperties == nullptr) {
+            queue_family_counts_.Insert(physicalDevice, *pQueueFamilyPropertyCount);
+        } else if (!HasChainedOutput(*pQueueFamilyPropertyCount, pQueueFamilyProperties) &&
+                   IsCompleteQueueFamilyList(physicalDevice, *pQueueFamilyPropertyCount)) {
+            std::vector<VkQueueFamilyProperties> families(*pQueueFamilyPropertyCount);
+            for (uint32_t i = 0; i < *pQueueFamilyPropertyCount; ++i) {
+                families[i] = pQueueFamilyProperties[i].queueFamilyProperties;
+            }
+            queue_families_.Insert(physicalDevice, families);
+        }
+    }
+    void PreCallGetPhysicalDeviceQueueFamilyProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                           uint32_t *pQueueFamilyPropertyCount,
+                                                           VkQueueFamilyProperties2 *pQueueFamilyProperties) {
+        PreCallGetPhysicalDeviceQueueFamilyProperties2(physicalDevice, pQueueFamilyPropertyCount, pQueueFamilyProperties);
+    }
+    void PostCallGetPhysicalDeviceQueueFamilyProperties2KHR(VkPhysicalDevice physicalDevice,
+                                                            uint32_t *pQueueFamilyPropertyCount,
+                                                            VkQueueFamilyProperties2 *pQueueFamilyProperties) {
+        PostCallGetPhysicalDeviceQueueFamilyProperties2(physicalDevice, pQueueFamilyPropertyCount, pQueueFamilyProperties);
+    }
+
+   private:
+    struct FormatKey {
+        VkPhysicalDevice physical_device;
+        VkFormat format;
+        bool operator==(const FormatKey &other) const {
+            return physical_device == other.physical_device && format == other.format;
+        }
+    };
+
+    struct ImageFormatKey {
+        VkPhysicalDevice physical_device;
+        VkFormat format;
+        VkImageType type;
+        VkImageTiling tiling;
+        VkImageUsageFlags usage;
+        VkImageCreateFlags flags;
+        bool operator==(const ImageFormatKey &other) const {
+            return physical_device == other.physical_device && format == other.format && type == other.type &&
+                   tiling == other.tiling && usage == other.usage && flags == other.flags;
+        }
+    };
+
+    struct ImageFormatResult {
+        VkResult result;
+        VkImageFormatProperties properties;
+    };
+
+    struct KeyHash {
+        static size_t Combine(size_t seed, uint64_t value) { return (seed ^ static_cast<size_t>(value)) * 0x100000001b3ULL; }
+        size_t operator()(VkPhysicalDevice physical_device) const { return std::hash<VkPhysicalDevice>()(physical_device); }
+        size_t operator()(const FormatKey &key) const { return Combine((*this)(key.physical_device), key.format); }
+        size_t operator()(const ImageFormatKey &key) const {
+            size_t hash = Combine((*this)(key.physical_device), key.format);
+            hash = Combine(hash, key.type);
+            hash = Combine(hash, key.tiling);
+            hash = Combine(hash, key.usage);
+            return Combine(hash, key.flags);
+        }
+    };
+
+    static ImageFormatKey MakeImageFormatKey(VkPhysicalDevice physical_device, const VkPhysicalDeviceImageFormatInfo2 &info) {
+        return {physical_device, info.format, info.type, info.tiling, info.usage, info.flags};
+    }
+
+    // Set by a PreCall hook that answered the call, so the matching PostCall hook does not store the result again
+    static bool &ServedFlag() {
+        static thread_local bool served = false;
+        return served;
+    }
+    static bool Served() {
+        bool served = ServedFlag();
+        ServedFlag() = false;
+        return served;
+    }
+    void ServeFromCache(VkResult result = VK_SUCCESS) {
+        ServedFlag() = true;
+        hits_.Increment();
+        SkipCall(result);
+    }
+
+    void LookUpFormatProperties(VkPhysicalDevice physical_device, VkFormat format, VkFormatProperties *properties) {
+        if (!format_properties_.Find({physical_device, format}, properties)) return;
+        ServeFromCache();
+    }
+    void StoreFormatProperties(VkPhysicalDevice physical_device, VkFormat format, const VkFormatProperties &properties) {
+        misses_.Increment();
+        format_properties_.Insert({physical_device, format}, properties);
+    }
+
+    void LookUpImageFormatProperties(const ImageFormatKey &key, VkImageFormatProperties *properties) {
+        ImageFormatResult cached;
+        if (!image_format_properties_.Find(key, &cached)) return;
+        *properties = cached.properties;
+        ServeFromCache(cached.result);
+    }
+    // Out of memory errors are transient and are not stored
+    void StoreImageFormatProperties(const ImageFormatKey &key, const VkImageFormatProperties &properties, VkResult result) {
+        misses_.Increment();
+        if (result == VK_SUCCESS || result == VK_ERROR_FORMAT_NOT_SUPPORTED) {
+            image_format_properties_.Insert(key, {result, properties});
+        }
+    }
+
+    void LookUpQueueFamilyCount(VkPhysicalDevice physical_device, uint32_t *count) {
+        if (!queue_family_counts_.Find(physical_device, count)) return;
+        ServeFromCache();
+    }
+    // A list is only stored when it is known to hold every family, that is when its length matches a count query
+    bool IsCompleteQueueFamilyList(VkPhysicalDevice physical_device, uint32_t count) const {
+        uint32_t family_count = 0;
+        return queue_family_counts_.Find(physical_device, &family_count) && family_count == count;
+    }
+    static bool HasChainedOutput(uint32_t count, const VkQueueFamilyProperties2 *properties) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (properties[i].pNext) return true;
+        }
+        return false;
+    }
+
+    vlf::ConcurrentMemoTable<FormatKey, VkFormatProperties, KeyHash> format_properties_;
+    vlf::ConcurrentMemoTable<ImageFormatKey, ImageFormatResult, KeyHash, 14> image_format_properties_;
+    vlf::ConcurrentMemoTable<VkPhysicalDevice, uint32_t, KeyHash, 4> queue_family_counts_;
+    vlf::ConcurrentMemoTable<VkPhysicalDevice, std::vector<VkQueueFamilyProperties>, KeyHash, 4> queue_families_;
+    vlf::PerThreadCounter<> hits_;
+    vlf::PerThreadCounter<> misses_;
+};
+
+QueryCache query_cache;
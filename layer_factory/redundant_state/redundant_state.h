@@ -0,0 +1,572 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "vlf_concurrency.h"
+#include "vlf_hash.h"
+#include "vlf_settings.h"
+
+// Counts vkCmdBind* and vkCmdSet* calls that bind state identical to what the command buffer already has bound:
+// pipelines, descriptor sets, vertex and index buffers, and dynamic state, including VK_EXT_extended_dynamic_state.
+// Bound state is tracked in each command buffer's context while recording, so recording threads share no locks. State
+// a command could have disturbed is forgotten rather than guessed at: dynamic state the bound pipeline does not declare
+// dynamic, descriptor sets bound with a different pipeline layout, and everything after vkCmdExecuteCommands. Counts
+// are taken at every submission, and every report_frames presents the binds per frame, the share of them that were
+// redundant, and the render passes with the most redundant binds are printed.
+//
+// Settings:
+//   lunarg_redundant_state.report_frames  Print a summary every N presents, 0 to disable (default 600)
+//   lunarg_redundant_state.top_count      Number of render passes listed in the summary (default 10)
+class RedundantState : public layer_factory {
+   public:
+    RedundantState() : layer_factory(this, kLayerIdentifier), report_frames_(600), top_count_(10), frame_(0){};
+
+    VkResult PostCallCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                    VkInstance *pInstance, VkResult result) {
+        report_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "report_frames", report_frames_);
+        top_count_ = vlf::GetLayerSettingUint(kLayerIdentifier, "top_count", top_count_);
+        return VK_SUCCESS;
+    }
+
+    // Frames presented since the last periodic summary are reported at shutdown
+    void PreCallDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+        if (bind_statistics_[0].Count() != 0) Report(frame_.load(std::memory_order_relaxed));
+    }
+
+    void PreCallDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+        pipelines_.EraseIf([device](VkPipeline, const PipelineInfo &pipeline) { return pipeline.device == device; });
+    }
+
+    VkResult PostCallCreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+                                             const VkGraphicsPipelineCreateInfo *pCreateInfos,
+                                             const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines, VkResult result) {
+        for (uint32_t i = 0; i < createInfoCount; ++i) {
+            if (pPipelines[i] == VK_NULL_HANDLE) continue;
+            uint64_t dynamic_slots = 0;
+            const VkPipelineDynamicStateCreateInfo *dynamic_state = pCreateInfos[i].pDynamicState;
+            for (uint32_t j = 0; dynamic_state && j < dynamic_state->dynamicStateCount; ++j) {
+                dynamic_slots |= DynamicStateSlots(dynamic_state->pDynamicStates[j]);
+            }
+            pipelines_.Insert(pPipelines[i], PipelineInfo{device, dynamic_slots});
+        }
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks *pAllocator) {
+        pipelines_.Erase(pipeline);
+    }
+
+    void PreCallCmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                   VkSubpassContents contents) {
+        BeginRenderPass(commandBuffer, pRenderPassBegin->renderPass);
+    }
+    void PreCallCmdBeginRenderPass2(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                    const VkSubpassBeginInfo *pSubpassBeginInfo) {
+        BeginRenderPass(commandBuffer, pRenderPassBegin->renderPass);
+    }
+    void PreCallCmdBeginRenderPass2KHR(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                       const VkSubpassBeginInfo *pSubpassBeginInfo) {
+        BeginRenderPass(commandBuffer, pRenderPassBegin->renderPass);
+    }
+    void PreCallCmdEndRenderPass(VkCommandBuffer commandBuffer) { EndRenderPass(commandBuffer); }
+    void PreCallCmdEndRenderPass2(VkCommandBuffer commandBuffer, const VkSubpassEndInfo *pSubpassEndInfo) {
+        EndRenderPass(commandBuffer);
+    }
+    void PreCallCmdEndRenderPass2KHR(VkCommandBuffer commandBuffer, const VkSubpassEndInfo *pSubpassEndInfo) {
+        EndRenderPass(commandBuffer);
+    }
+
+    void PreCallCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline) {
+        CommandBufferState *state = GetState(commandBuffer);
+        int bind_point = BindPointIndex(pipelineBindPoint);
+        if (!state || bind_point < 0) return;
+        bool redundant = state->pipelines[bind_point] == pipeline;
+        Count(*state, kPipeline, redundant);
+        if (redundant) return;
+        state->pipelines[bind_point] = pipeline;
+        // Binding a graphics pipeline replaces all dynamic state the pipeline does not declare dynamic
+        if (bind_point == 0) state->dynamic_valid &= PipelineDynamicSlots(*state, pipeline);
+    }
+
+    void PreCallCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
+                                      VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount,
+                                      const VkDescriptorSet *pDescriptorSets, uint32_t dynamicOffsetCount,
+                                      const uint32_t *pDynamicOffsets) {
+        CommandBufferState *state = GetState(commandBuffer);
+        int bind_point = BindPointIndex(pipelineBindPoint);
+        if (!state || bind_point < 0) return;
+        // Dynamic offsets cannot be matched to sets without the set layouts, so they are compared per call
+        uint64_t offsets = 0;
+        if (dynamicOffsetCount) {
+            offsets = vlf::Hash(vlf::kHashSeed, firstSet, descriptorSetCount);
+            for (uint32_t i = 0; i < dynamicOffsetCount; ++i) offsets = vlf::Hash(offsets, pDynamicOffsets[i]);
+        }
+        DescriptorSetBinding *sets = state->descriptor_sets[bind_point];
+        bool redundant = firstSet + descriptorSetCount <= kMaxDescriptorSets;
+        for (uint32_t i = 0; redundant && i < descriptorSetCount; ++i) {
+            const DescriptorSetBinding &binding = sets[firstSet + i];
+            redundant = binding.valid && binding.set == pDescriptorSets[i] && binding.layout == layout &&
+                        binding.offsets == offsets;
+        }
+        Count(*state, kDescriptorSets, redundant);
+        if (redundant) return;
+        // Sets bound with another pipeline layout may be disturbed; forget them rather than check compatibility
+        for (uint32_t i = 0; i < kMaxDescriptorSets; ++i) {
+            if (sets[i].layout != layout) sets[i].valid = false;
+        }
+        for (uint32_t i = 0; i < descriptorSetCount && firstSet + i < kMaxDescriptorSets; ++i) {
+            sets[firstSet + i] = {pDescriptorSets[i], layout, offsets, true};
+        }
+    }
+
+    void PreCallCmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount,
+                                     const VkBuffer *pBuffers, const VkDeviceSize *pOffsets) {
+        BindVertexBuffers(commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets, nullptr, nullptr);
+    }
+    void PreCallCmdBindVertexBuffers2EXT(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount,
+                                         const VkBuffer *pBuffers, const VkDeviceSize *pOffsets, const VkDeviceSize *pSizes,
+                                         const VkDeviceSize *pStrides) {
+        BindVertexBuffers(commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets, pSizes, pStrides);
+    }
+
+    void PreCallCmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+        CommandBufferState *state = GetState(commandBuffer);
+        if (!state) return;
+        uint64_t value = vlf::Hash(vlf::kHashSeed, vlf::HandleValue(buffer), offset, indexType);
+        bool redundant = state->index_buffer_valid && state->index_buffer == value;
+        Count(*state, kIndexBuffer, redundant);
+        state->index_buffer = value;
+        state->index_buffer_valid = true;
+    }
+
+    void PreCallCmdSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount,
+                               const VkViewport *pViewports) {
+        SetIndexedState(commandBuffer, kViewportSlot, firstViewport, viewportCount, pViewports);
+    }
+    void PreCallCmdSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount,
+                              const VkRect2D *pScissors) {
+        SetIndexedState(commandBuffer, kScissorSlot, firstScissor, scissorCount, pScissors);
+    }
+    void PreCallCmdSetLineWidth(VkCommandBuffer commandBuffer, float lineWidth) {
+        SetState(commandBuffer, kLineWidthSlot, vlf::HashBytes(vlf::kHashSeed, &lineWidth, sizeof(lineWidth)));
+    }
+    void PreCallCmdSetDepthBias(VkCommandBuffer commandBuffer, float depthBiasConstantFactor, float depthBiasClamp,
+                                float depthBiasSlopeFactor) {
+        const float values[] = {depthBiasConstantFactor, depthBiasClamp, depthBiasSlopeFactor};
+        SetState(commandBuffer, kDepthBiasSlot, vlf::HashBytes(vlf::kHashSeed, values, sizeof(values)));
+    }
+    void PreCallCmdSetBlendConstants(VkCommandBuffer commandBuffer, const float blendConstants[4]) {
+        SetState(commandBuffer, kBlendConstantsSlot, vlf::HashBytes(vlf::kHashSeed, blendConstants, 4 * sizeof(float)));
+    }
+    void PreCallCmdSetDepthBounds(VkCommandBuffer commandBuffer, float minDepthBounds, float maxDepthBounds) {
+        const float values[] = {minDepthBounds, maxDepthBounds};
+        SetState(commandBuffer, kDepthBoundsSlot, vlf::HashBytes(vlf::kHashSeed, values, sizeof(values)));
+    }
+    void PreCallCmdSetStencilCompareMask(VkCommandBuffer commandBuffer, VkStencilFaceFlags faceMask, uint32_t compareMask) {
+        SetStencilState(commandBuffer, kStencilCompareMaskSlot, faceMask, vlf::Hash(vlf::kHashSeed, compareMask));
+    }
+    void PreCallCmdSetStencilWriteMask(VkCommandBuffer commandBuffer, VkStencilFaceFlags faceMask, uint32_t writeMask) {
+        SetStencilState(commandBuffer, kStencilWriteMaskSlot, faceMask, vlf::Hash(vlf::kHashSeed, writeMask));
+    }
+    void PreCallCmdSetStencilReference(VkCommandBuffer commandBuffer, VkStencilFaceFlags faceMask, uint32_t reference) {
+        SetStencilState(commandBuffer, kStencilReferenceSlot, faceMask, vlf::Hash(vlf::kHashSeed, reference));
+    }
+
+    void PreCallCmdSetCullModeEXT(VkCommandBuffer commandBuffer, VkCullModeFlags cullMode) {
+        SetState(commandBuffer, kCullModeSlot, vlf::Hash(vlf::kHashSeed, cullMode));
+    }
+    void PreCallCmdSetFrontFaceEXT(VkCommandBuffer commandBuffer, VkFrontFace frontFace) {
+        SetState(commandBuffer, kFrontFaceSlot, vlf::Hash(vlf::kHashSeed, frontFace));
+    }
+    void PreCallCmdSetPrimitiveTopologyEXT(VkCommandBuffer commandBuffer, VkPrimitiveTopology primitiveTopology) {
+        SetState(commandBuffer, kPrimitiveTopologySlot, vlf::Hash(vlf::kHashSeed, primitiveTopology));
+    }
+    void PreCallCmdSetViewportWithCountEXT(VkCommandBuffer commandBuffer, uint32_t viewportCount, const VkViewport *pViewports) {
+        SetState(commandBuffer, kViewportWithCountSlot,
+                 vlf::HashBytes(vlf::Hash(vlf::kHashSeed, viewportCount), pViewports, viewportCount * sizeof(VkViewport)));
+    }
+    void PreCallCmdSetScissorWithCountEXT(VkCommandBuffer commandBuffer, uint32_t scissorCount, const VkRect2D *pScissors) {
+        SetState(commandBuffer, kScissorWithCountSlot,
+                 vlf::HashBytes(vlf::Hash(vlf::kHashSeed, scissorCount), pScissors, scissorCount * sizeof(VkRect2D)));
+    }
+    void PreCallCmdSetDepthTestEnableEXT(VkCommandBuffer commandBuffer, VkBool32 depthTestEnable) {
+        SetState(commandBuffer, kDepthTestEnableSlot, vlf::Hash(vlf::kHashSeed, depthTestEnable));
+    }
+    void PreCallCmdSetDepthWriteEnableEXT(VkCommandBuffer commandBuffer, VkBool32 depthWriteEnable) {
+        SetState(commandBuffer, kDepthWriteEnableSlot, vlf::Hash(vlf::kHashSeed, depthWriteEnable));
+    }
+    void PreCallCmdSetDepthCompareOpEXT(VkCommandBuffer commandBuffer, VkCompareOp depthCompareOp) {
+        SetState(commandBuffer, kDepthCompareOpSlot, vlf::Hash(vlf::kHashSeed, depthCompareOp));
+    }
+    void PreCallCmdSetDepthBoundsTestEnableEXT(VkCommandBuffer commandBuffer, VkBool32 depthBoundsTestEnable) {
+        SetState(commandBuffer, kDepthBoundsTestEnableSlot, vlf::Hash(vlf::kHashSeed, depthBoundsTestEnable));
+    }
+    void PreCallCmdSetStencilTestEnableEXT(VkCommandBuffer commandBuffer, VkBool32 stencilTestEnable) {
+        SetState(commandBuffer, kStencilTestEnableSlot, vlf::Hash(vlf::kHashSeed, stencilTestEnable));
+    }
+    void PreCallCmdSetStencilOpEXT(VkCommandBuffer commandBuffer, VkStencilFaceFlags faceMask, VkStencilOp failOp,
+                                   VkStencilOp passOp, VkStencilOp depthFailOp, VkCompareOp compareOp) {
+        uint64_t value = vlf::Hash(vlf::kHashSeed, failOp, passOp, depthFailOp, compareOp);
+        SetStencilState(commandBuffer, kStencilOpSlot, faceMask, value);
+    }
+
+    // All state is undefined after secondary command buffers execute
+    void PreCallCmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
+                                   const VkCommandBuffer *pCommandBuffers) {
+        CommandBufferState *state = GetState(commandBuffer);
+        if (!state) return;
+        for (auto &pipeline : state->pipelines) pipeline = VK_NULL_HANDLE;
+        for (auto &sets : state->descriptor_sets) {
+            for (auto &binding : sets) binding.valid = false;
+        }
+        state->vertex_buffers_valid = 0;
+        state->index_buffer_valid = false;
+        state->dynamic_valid = 0;
+    }
+
+    // Counts are taken per execution of the command buffer, so command buffers recorded once and submitted every frame
+    // are accounted for
+    void SubmittedCommandBuffer(VkQueue queue, VkCommandBuffer command_buffer, vlf::CommandBufferContext &context) {
+        CommandBufferState &state = context.State<CommandBufferState>(this);
+        for (int category = 0; category < kCategoryCount; ++category) {
+            binds_[category].Add(state.totals.binds[category]);
+            redundant_[category].Add(state.totals.redundant[category]);
+        }
+        for (const auto &render_pass : state.render_passes) {
+            render_pass_counts_.Update(render_pass.first, [&render_pass](RenderPassCounts &counts) {
+                ++counts.instances;
+                for (int category = 0; category < kCategoryCount; ++category) {
+                    counts.binds += render_pass.second.binds[category];
+                    counts.redundant += render_pass.second.redundant[category];
+                }
+            });
+        }
+    }
+
+    VkResult PostCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkResult result) {
+        uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed) + 1;
+        for (int category = 0; category < kCategoryCount; ++category) {
+            bind_statistics_[category].Record(static_cast<uint64_t>(binds_[category].Exchange()));
+            redundant_statistics_[category].Record(static_cast<uint64_t>(redundant_[category].Exchange()));
+        }
+        uint64_t report_frames = report_frames_.load(std::memory_order_relaxed);
+        if (report_frames != 0 && frame % report_frames == 0) Report(frame);
+        return VK_SUCCESS;
+    }
+
+   private:
+    static constexpr const char *kLayerIdentifier = "lunarg_redundant_state";
+    static const uint32_t kBindPointCount = 3;
+    static const uint32_t kMaxDescriptorSets = 32;
+    static const uint32_t kMaxVertexBindings = 32;
+    static const uint32_t kMaxViewports = 16;
+
+    enum Category { kPipeline, kDescriptorSets, kVertexBuffers, kIndexBuffer, kDynamicState, kCategoryCount };
+
+    // Dynamic state is kept in numbered slots, one per value a vkCmdSet* call can change independently
+    enum DynamicSlot {
+        kViewportSlot = 0,
+        kScissorSlot = kViewportSlot + kMaxViewports,
+        kLineWidthSlot = kScissorSlot + kMaxViewports,
+        kDepthBiasSlot,
+        kBlendConstantsSlot,
+        kDepthBoundsSlot,
+        kStencilCompareMaskSlot,  // Front and back faces use two slots
+        kStencilWriteMaskSlot = kStencilCompareMaskSlot + 2,
+        kStencilReferenceSlot = kStencilWriteMaskSlot + 2,
+        kCullModeSlot = kStencilReferenceSlot + 2,
+        kFrontFaceSlot,
+        kPrimitiveTopologySlot,
+        kViewportWithCountSlot,
+        kScissorWithCountSlot,
+        kDepthTestEnableSlot,
+        kDepthWriteEnableSlot,
+        kDepthCompareOpSlot,
+        kDepthBoundsTestEnableSlot,
+        kStencilTestEnableSlot,
+        kStencilOpSlot,
+        kDynamicSlotCount = kStencilOpSlot + 2
+    };
+    static_assert(kDynamicSlotCount <= 64, "Dynamic state slots must fit in a 64-bit mask");
+
+    struct PipelineInfo {
+        VkDevice device;
+        uint64_t dynamic_slots;
+    };
+
+    struct DescriptorSetBinding {
+        VkDescriptorSet set;
+        VkPipelineLayout layout;
+        uint64_t offsets;
+        bool valid;
+    };
+
+    struct Counts {
+        uint32_t binds[kCategoryCount] = {};
+        uint32_t redundant[kCategoryCount] = {};
+    };
+
+    struct RenderPassCounts {
+        uint64_t instances = 0;
+        uint64_t binds = 0;
+        uint64_t redundant = 0;
+    };
+
+    // Bound state of one recording, kept in the command buffer's context
+    struct CommandBufferState {
+        VkPipeline pipelines[kBindPointCount] = {};
+        DescriptorSetBinding descriptor_sets[kBindPointCount][kMaxDescriptorSets] = {};
+        uint64_t vertex_buffers[kMaxVertexBindings] = {};
+        uint32_t vertex_buffers_valid = 0;
+        uint64_t index_buffer = 0;
+        bool index_buffer_valid = false;
+        uint64_t dynamic_state[kDynamicSlotCount] = {};
+        uint64_t dynamic_valid = 0;
+        // Dynamic state slots of the pipelines bound in this recording, looked up once each
+        std::unordered_map<VkPipeline, uint64_t> pipeline_dynamic_slots;
+
+        Counts totals;
+        bool in_render_pass = false;
+        std::vector<std::pair<VkRenderPass, Counts>> render_passes;
+    };
+
+
+    static int BindPointIndex(VkPipelineBindPoint bind_point) {
+        switch (bind_point) {
+            case VK_PIPELINE_BIND_POINT_GRAPHICS:
+                return 0;
+            case VK_PIPELINE_BIND_POINT_COMPUTE:
+                return 1;
+            case VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR:
+                return 2;
+            default:
+                return -1;
+        }
+    }
+
+    static uint64_t SlotRange(uint32_t first, uint32_t count) { return ((count == 64 ? 0 : uint64_t(1) << count) - 1) << first; }
+
+    static uint64_t DynamicStateSlots(VkDynamicState dynamic_state) {
+        switch (dynamic_state) {
+            case VK_DYNAMIC_STATE_VIEWPORT:
+                return SlotRange(kViewportSlot, kMaxViewports);
+            case VK_DYNAMIC_STATE_SCISSOR:
+                return SlotRange(kScissorSlot, kMaxViewports);
+            case VK_DYNAMIC_STATE_LINE_WIDTH:
+                return SlotRange(kLineWidthSlot, 1);
+            case VK_DYNAMIC_STATE_DEPTH_BIAS:
+                return SlotRange(kDepthBiasSlot, 1);
+            case VK_DYNAMIC_STATE_BLEND_CONSTANTS:
+                return SlotRange(kBlendConstantsSlot, 1);
+            case VK_DYNAMIC_STATE_DEPTH_BOUNDS:
+                return SlotRange(kDepthBoundsSlot, 1);
+            case VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK:
+                return SlotRange(kStencilCompareMaskSlot, 2);
+            case VK_DYNAMIC_STATE_STENCIL_WRITE_MASK:
+                return SlotRange(kStencilWriteMaskSlot, 2);
+            case VK_DYNAMIC_STATE_STENCIL_REFERENCE:
+                return SlotRange(kStencilReferenceSlot, 2);
+            case VK_DYNAMIC_STATE_CULL_MODE_EXT:
+                return SlotRange(kCullModeSlot, 1);
+            case VK_DYNAMIC_STATE_FRONT_FACE_EXT:
+                return SlotRange(kFrontFaceSlot, 1);
+            case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT:
+                return SlotRange(kPrimitiveTopologySlot, 1);
+            case VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT_EXT:
+                return SlotRange(kViewportWithCountSlot, 1);
+            case VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT_EXT:
+                return SlotRange(kScissorWithCountSlot, 1);
+            case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT:
+                return SlotRange(kDepthTestEnableSlot, 1);
+            case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT:
+                return SlotRange(kDepthWriteEnableSlot, 1);
+            case VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT:
+                return SlotRange(kDepthCompareOpSlot, 1);
+            case VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE_EXT:
+                return SlotRange(kDepthBoundsTestEnableSlot, 1);
+            case VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT:
+                return SlotRange(kStencilTestEnableSlot, 1);
+            case VK_DYNAMIC_STATE_STENCIL_OP_EXT:
+                return SlotRange(kStencilOpSlot, 2);
+            default:
+                return 0;
+        }
+    }
+
+    CommandBufferState *GetState(VkCommandBuffer command_buffer) {
+        vlf::CommandBufferContext *context = GetCommandBufferContext(command_buffer);
+        return context ? &context->State<CommandBufferState>(this) : nullptr;
+    }
+
+    // Pipelines created before the layer was loaded are treated as having no dynamic state
+    uint64_t PipelineDynamicSlots(CommandBufferState &state, VkPipeline pipeline) {
+        auto found = state.pipeline_dynamic_slots.find(pipeline);
+        if (found != state.pipeline_dynamic_slots.end()) return found->second;
+        PipelineInfo info = {VK_NULL_HANDLE, 0};
+        pipelines_.Find(pipeline, &info);
+        state.pipeline_dynamic_slots[pipeline] = info.dynamic_slots;
+        return info.dynamic_slots;
+    }
+
+    static void Count(CommandBufferState &state, Category category, bool redundant) {
+        ++state.totals.binds[category];
+        if (redundant) ++state.totals.redundant[category];
+        if (!state.in_render_pass) return;
+        Counts &render_pass = state.render_passes.back().second;
+        ++render_pass.binds[category];
+        if (redundant) ++render_pass.redundant[category];
+    }
+
+    void BeginRenderPass(VkCommandBuffer command_buffer, VkRenderPass render_pass) {
+        CommandBufferState *state = GetState(command_buffer);
+        if (!state) return;
+        state->render_passes.emplace_back(render_pass, Counts());
+        state->in_render_pass = true;
+    }
+    void EndRenderPass(VkCommandBuffer command_buffer) {
+        CommandBufferState *state = GetState(command_buffer);
+        if (state) state->in_render_pass = false;
+    }
+
+    void BindVertexBuffers(VkCommandBuffer command_buffer, uint32_t first_binding, uint32_t binding_count, const VkBuffer *buffers,
+                           const VkDeviceSize *offsets, const VkDeviceSize *sizes, const VkDeviceSize *strides) {
+        CommandBufferState *state = GetState(command_buffer);
+        if (!state) return;
+        bool redundant = first_binding + binding_count <= kMaxVertexBindings;
+        uint64_t values[kMaxVertexBindings];
+        for (uint32_t i = 0; i < binding_count && first_binding + i < kMaxVertexBindings; ++i) {
+            uint64_t value = vlf::Hash(vlf::kHashSeed, vlf::HandleValue(buffers[i]), offsets[i]);
+            value = vlf::Hash(value, sizes ? sizes[i] : VK_WHOLE_SIZE);
+            // Without strides the stride comes from the pipeline, which is a different state from any explicit stride
+            value = vlf::Hash(value, strides ? strides[i] : ~0ull);
+            values[i] = value;
+            uint32_t binding = first_binding + i;
+            redundant = redundant && (state->vertex_buffers_valid & (1u << binding)) && state->vertex_buffers[binding] == value;
+        }
+        Count(*state, kVertexBuffers, redundant);
+        for (uint32_t i = 0; i < binding_count && first_binding + i < kMaxVertexBindings; ++i) {
+            state->vertex_buffers[first_binding + i] = values[i];
+            state->vertex_buffers_valid |= 1u << (first_binding + i);
+        }
+    }
+
+    // Sets consecutive slots from an array, as vkCmdSetViewport and vkCmdSetScissor do
+    template <typename Value>
+    void SetIndexedState(VkCommandBuffer command_buffer, uint32_t first_slot, uint32_t first, uint32_t count, const Value *values) {
+        CommandBufferState *state = GetState(command_buffer);
+        if (!state) return;
+        bool redundant = first + count <= kMaxViewports;
+        for (uint32_t i = 0; i < count && first + i < kMaxViewports; ++i) {
+            uint32_t slot = first_slot + first + i;
+            uint64_t value = vlf::HashBytes(vlf::kHashSeed, &values[i], sizeof(Value));
+            redundant = redundant && (state->dynamic_valid & (uint64_t(1) << slot)) && state->dynamic_state[slot] == value;
+            state->dynamic_state[slot] = value;
+            state->dynamic_valid |= uint64_t(1) << slot;
+        }
+        Count(*state, kDynamicState, redundant);
+    }
+
+    void SetStencilState(VkCommandBuffer command_buffer, uint32_t first_slot, VkStencilFaceFlags face_mask, uint64_t value) {
+        CommandBufferState *state = GetState(command_buffer);
+        if (!state) return;
+        bool redundant = (face_mask & (VK_STENCIL_FACE_FRONT_BIT | VK_STENCIL_FACE_BACK_BIT)) != 0;
+        for (uint32_t face = 0; face < 2; ++face) {
+            if (!(face_mask & (1u << face))) continue;
+            uint32_t slot = first_slot + face;
+            redundant = redundant && (state->dynamic_valid & (uint64_t(1) << slot)) && state->dynamic_state[slot] == value;
+            state->dynamic_state[slot] = value;
+            state->dynamic_valid |= uint64_t(1) << slot;
+        }
+        Count(*state, kDynamicState, redundant);
+    }
+
+    void SetState(VkCommandBuffer command_buffer, uint32_t slot, uint64_t value) {
+        CommandBufferState *state = GetState(command_buffer);
+        if (!state) return;
+        bool redundant = (state->dynamic_valid & (uint64_t(1) << slot)) && state->dynamic_state[slot] == value;
+        Count(*state, kDynamicState, redundant);
+        state->dynamic_state[slot] = value;
+        state->dynamic_valid |= uint64_t(1) << slot;
+    }
+
+    void Report(uint64_t frame) {
+        static const char *const category_names[] = {"Pipelines", "Descriptor sets", "Vertex buffers", "Index buffers",
+                                                     "Dynamic state"};
+        std::string text;
+        char line[256];
+        snprintf(line, sizeof(line), "Redundant state binding after %" PRIu64 " frames, mean per frame:\n", frame);
+        text += line;
+        uint64_t total_binds = 0, total_redundant = 0;
+        for (int category = 0; category < kCategoryCount; ++category) {
+            uint64_t binds = bind_statistics_[category].Sum(), redundant = redundant_statistics_[category].Sum();
+            total_binds += binds;
+            total_redundant += redundant;
+            snprintf(line, sizeof(line), "  %-16s %10.1f binds %10.1f redundant (max %" PRIu64 ") %6.1f%%\n",
+                     category_names[category], bind_statistics_[category].Mean(), redundant_statistics_[category].Mean(),
+                     redundant_statistics_[category].Max(), binds ? 100.0 * redundant / binds : 0.0);
+            text += line;
+        }
+        snprintf(line, sizeof(line), "  %-16s %6.1f%% of %" PRIu64 " binds redundant\n", "Total",
+                 total_binds ? 100.0 * total_redundant / total_binds : 0.0, total_binds);
+        text += line;
+
+        std::vector<std::pair<VkRenderPass, RenderPassCounts>> render_passes;
+        render_pass_counts_.ForEach([&render_passes](VkRenderPass render_pass, const RenderPassCounts &counts) {
+            render_passes.emplace_back(render_pass, counts);
+        });
+        render_pass_counts_.Clear();
+        size_t count = std::min<size_t>(render_passes.size(), top_count_.load(std::memory_order_relaxed));
+        typedef std::pair<VkRenderPass, RenderPassCounts> Entry;
+        std::partial_sort(render_passes.begin(), render_passes.begin() + count, render_passes.end(),
+                          [](const Entry &a, const Entry &b) { return a.second.redundant > b.second.redundant; });
+        if (count) text += "  Render passes with the most redundant binds:\n";
+        for (size_t i = 0; i < count; ++i) {
+            const RenderPassCounts &counts = render_passes[i].second;
+            snprintf(line, sizeof(line), "  0x%016" PRIx64 " %10" PRIu64 " instances %12" PRIu64 " binds %6.1f%% redundant\n",
+                     vlf::HandleValue(render_passes[i].first), counts.instances, counts.binds,
+                     counts.binds ? 100.0 * counts.redundant / counts.binds : 0.0);
+            text += line;
+        }
+        Print(text);
+        for (auto &statistics : bind_statistics_) statistics.Reset();
+        for (auto &statistics : redundant_statistics_) statistics.Reset();
+    }
+
+    // Settings
+    std::atomic<uint64_t> report_frames_;
+    std::atomic<uint64_t> top_count_;
+
+    vlf::ConcurrentHandleMap<VkPipeline, PipelineInfo> pipelines_;
+    vlf::ConcurrentHandleMap<VkRenderPass, RenderPassCounts> render_pass_counts_;
+
+    std::atomic<uint64_t> frame_;
+    vlf::PerThreadCounter<> binds_[kCategoryCount];
+    vlf::PerThreadCounter<> redundant_[kCategoryCount];
+    vlf::StatisticsAccumulator bind_statistics_[kCategoryCount];
+    vlf::StatisticsAccumulator redundant_statistics_[kCategoryCount];
+};
+
+RedundantState redundant_state;
@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "vlf_concurrency.h"
+#include "vlf_settings.h"
+
+// Finds render pass load and store operations that move attachment contents to or from memory for nothing, which on
+// tile-based GPUs costs a full read or write of the attachment per render pass. Flagged are:
+//   - LOAD_OP_LOAD of an attachment whose initial layout is UNDEFINED, so there is nothing to load
+//   - LOAD_OP_LOAD of an attachment that vkCmdClearAttachments fully overwrites before the first draw of its subpass
+//   - STORE_OP_STORE of a depth/stencil attachment whose image cannot be sampled, copied or read as an input attachment
+//     and that no render pass has loaded, so the stored contents are never read
+//   - images only ever used as attachments that are neither loaded nor stored but lack TRANSIENT_ATTACHMENT usage, so
+//     they cannot be placed in lazily allocated memory
+// Each render pass instance is analyzed when it is recorded, and the avoidable traffic is counted whenever its command
+// buffer is submitted. Traffic is estimated as render area x framebuffer layers x samples x bytes per texel. Each
+// problem is reported once as a performance warning, and the avoidable bytes per frame are summarized periodically.
+//
+// Settings:
+//   lunarg_render_pass_bandwidth.report_frames  Print a summary every N presents, 0 to disable (default 600)
+class RenderPassBandwidth : public layer_factory {
+   public:
+    RenderPassBandwidth() : layer_factory(this, kLayerIdentifier), report_frames_(600), frame_(0), transient_candidates_(0){};
+
+    VkResult PostCallCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                    VkInstance *pInstance, VkResult result) {
+        report_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "report_frames", report_frames_);
+        return VK_SUCCESS;
+    }
+
+    // Frames presented since the last periodic summary are reported at shutdown
+    void PreCallDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+        if (total_statistics_.Count() != 0) Report(frame_.load(std::memory_order_relaxed));
+    }
+
+    void PreCallDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+        images_.EraseIf([device](VkImage, const ImageInfo &image) { return image.device == device; });
+        views_.EraseIf([device](VkImageView, const ViewInfo &view) { return view.device == device; });
+        framebuffers_.EraseIf([device](VkFramebuffer, const std::shared_ptr<const FramebufferInfo> &framebuffer) {
+            return framebuffer->device == device;
+        });
+        render_passes_.EraseIf([device](VkRenderPass, const std::shared_ptr<const RenderPassInfo> &render_pass) {
+            return render_pass->device == device;
+        });
+    }
+
+    VkResult PostCallCreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                 VkImage *pImage, VkResult result) {
+        if (result == VK_SUCCESS) images_.Insert(*pImage, ImageInfo{device, pCreateInfo->usage});
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks *pAllocator) {
+        images_.Erase(image);
+        loaded_images_.Erase(image);
+        warned_images_.Erase(image);
+    }
+
+    VkResult PostCallCreateImageView(VkDevice device, const VkImageViewCreateInfo *pCreateInfo,
+                                     const VkAllocationCallbacks *pAllocator, VkImageView *pView, VkResult result) {
+        if (result == VK_SUCCESS) views_.Insert(*pView, ViewInfo{device, pCreateInfo->image});
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyImageView(VkDevice device, VkImageView imageView, const VkAllocationCallbacks *pAllocator) {
+        views_.Erase(imageView);
+    }
+
+    VkResult PostCallCreateFramebuffer(VkDevice device, const VkFramebufferCreateInfo *pCreateInfo,
+                                       const VkAllocationCallbacks *pAllocator, VkFramebuffer *pFramebuffer, VkResult result) {
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        std::shared_ptr<FramebufferInfo> framebuffer = std::make_shared<FramebufferInfo>();
+        framebuffer->device = device;
+        framebuffer->width = pCreateInfo->width;
+        framebuffer->height = pCreateInfo->height;
+        framebuffer->layers = pCreateInfo->layers;
+        framebuffer->imageless = (pCreateInfo->flags & VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT) != 0;
+        if (!framebuffer->imageless) {
+            framebuffer->views.assign(pCreateInfo->pAttachments, pCreateInfo->pAttachments + pCreateInfo->attachmentCount);
+        }
+        framebuffers_.Insert(*pFramebuffer, framebuffer);
+        return VK_SUCCESS;
+    }
+    void PreCallDestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer, const VkAllocationCallbacks *pAllocator) {
+        framebuffers_.Erase(framebuffer);
+    }
+
+    VkResult PostCallCreateRenderPass(VkDevice device, const VkRenderPassCreateInfo *pCreateInfo,
+                                      const VkAllocationCallbacks *pAllocator, VkRenderPass *pRenderPass, VkResult result) {
+        if (result == VK_SUCCESS) render_passes_.Insert(*pRenderPass, MakeRenderPassInfo(device, *pCreateInfo));
+        return VK_SUCCESS;
+    }
+    VkResult PostCallCreateRenderPass2(VkDevice device, const VkRenderPassCreateInfo2 *pCreateInfo,
+                                       const VkAllocationCallbacks *pAllocator, VkRenderPass *pRenderPass, VkResult result) {
+        if (result == VK_SUCCESS) render_passes_.Insert(*pRenderPass, MakeRenderPassInfo(device, *pCreateInfo));
+        return VK_SUCCESS;
+    }
+    VkResult PostCallCreateRenderPass2KHR(VkDevice device, const VkRenderPassCreateInfo2 *pCreateInfo,
+                                          const VkAllocationCallbacks *pAllocator, VkRenderPass *pRenderPass, VkResult result) {
+        return PostCallCreateRenderPass2(device, pCreateInfo, pAllocator, pRenderPass, result);
+    }
+    void PreCallDestroyRenderPass(VkDevice device, VkRenderPass renderPass, const VkAllocationCallbacks *pAllocator) {
+        render_passes_.Erase(renderPass);
+        warned_render_passes_.Erase(renderPass);
+    }
+
+    void PreCallCmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                   VkSubpassContents contents) {
+        BeginRenderPass(commandBuffer, *pRenderPassBegin);
+    }
+    void PreCallCmdBeginRenderPass2(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                    const VkSubpassBeginInfo *pSubpassBeginInfo) {
+        BeginRenderPass(commandBuffer, *pRenderPassBegin);
+    }
+    void PreCallCmdBeginRenderPass2KHR(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *pRenderPassBegin,
+                                       const VkSubpassBeginInfo *pSubpassBeginInfo) {
+        BeginRenderPass(commandBuffer, *pRenderPassBegin);
+    }
+
+    void PreCallCmdNextSubpass(VkCommandBuffer commandBuffer, VkSubpassContents contents) { NextSubpass(commandBuffer); }
+    void PreCallCmdNextSubpass2(VkCommandBuffer commandBuffer, const VkSubpassBeginInfo *pSubpassBeginInfo,
+                                const VkSubpassEndInfo *pSubpassEndInfo) {
+        NextSubpass(commandBuffer);
+    }
+    void PreCallCmdNextSubpass2KHR(VkCommandBuffer commandBuffer, const VkSubpassBeginInfo *pSubpassBeginInfo,
+                                   const VkSubpassEndInfo *pSubpassEndInfo) {
+        NextSubpass(commandBuffer);
+    }
+
+    void PreCallCmdEndRenderPass(VkCommandBuffer commandBuffer) { EndRenderPass(commandBuffer); }
+    void PreCallCmdEndRenderPass2(VkCommandBuffer commandBuffer, const VkSubpassEndInfo *pSubpassEndInfo) {
+        EndRenderPass(commandBuffer);
+    }
+    void PreCallCmdEndRenderPass2KHR(VkCommandBuffer commandBuffer, const VkSubpassEndInfo *pSubpassEndInfo) {
+        EndRenderPass(commandBuffer);
+    }
+
+    void PreCallCmdClearAttachments(VkCommandBuffer commandBuffer, uint32_t attachmentCount, const VkClearAttachment *pAttachments,
+                                    uint32_t rectCount, const VkClearRect *pRects) {
+        vlf::CommandBufferContext *context = GetCommandBufferContext(commandBuffer);
+        if (!context) return;
+        CommandBufferState &state = context->State<CommandBufferState>(this);
+        if (!state.render_pass || !state.full_render_area || DrawnInSubpass(*context, state)) return;
+        bool full_clear = false;
+        for (uint32_t i = 0; i < rectCount; ++i) {
+            const VkClearRect &rect = pRects[i];
+            full_clear |= rect.rect.offset.x <= 0 && rect.rect.offset.y <= 0 &&
+                          rect.rect.offset.x + static_cast<int64_t>(rect.rect.extent.width) >= state.render_area.width &&
+                          rect.rect.offset.y + static_cast<int64_t>(rect.rect.extent.height) >= state.render_area.height &&
+                          rect.baseArrayLayer == 0 && rect.layerCount >= state.layers;
+        }
+        if (!full_clear) return;
+
+        const Subpass &subpass = state.render_pass->subpasses[state.subpass];
+        for (uint32_t i = 0; i < attachmentCount; ++i) {
+            const VkClearAttachment &clear = pAttachments[i];
+            uint32_t index = VK_ATTACHMENT_UNUSED;
+            if (clear.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) {
+                if (clear.colorAttachment < subpass.color.size()) index = subpass.color[clear.colorAttachment];
+            } else {
+                index = subpass.depth_stencil;
+            }
+            if (index == VK_ATTACHMENT_UNUSED || index >= state.attachments.size()) continue;
+            const Attachment &attachment = state.render_pass->attachments[index];
+            const AttachmentUse &use = state.attachments[index];
+            // Only the first subpass using an attachment performs its load, and loads of UNDEFINED are counted already
+            if (attachment.first_subpass != state.subpass || attachment.initial_layout == VK_IMAGE_LAYOUT_UNDEFINED) continue;
+            uint64_t bytes = 0;
+            if ((clear.aspectMask & (VK_IMAGE_ASPECT_COLOR_BIT | VK_IMAGE_ASPECT_DEPTH_BIT)) &&
+                attachment.load_op == VK_ATTACHMENT_LOAD_OP_LOAD) {
+                bytes += use.main_bytes;
+            }
+            if ((clear.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) && attachment.stencil_load_op == VK_ATTACHMENT_LOAD_OP_LOAD) {
+                bytes += use.stencil_bytes;
+            }
+            if (bytes == 0 || state.cleared_attachments[index]) continue;
+            state.cleared_attachments[index] = true;
+            state.avoidable_bytes[kLoadOverwritten] += bytes;
+            if (FirstRenderPassWarning(state.render_pass_handle, kLoadOverwritten, index)) {
+                PerformanceWarning("Render pass attachment " + std::to_string(index) +
+                                   " uses LOAD_OP_LOAD but is fully cleared by vkCmdClearAttachments before any draw; use "
+                                   "LOAD_OP_CLEAR instead");
+            }
+        }
+    }
+
+    // Avoidable traffic is counted per execution of the command buffer, so command buffers recorded once and submitted
+    // every frame are accounted for
+    void SubmittedCommandBuffer(VkQueue queue, VkCommandBuffer command_buffer, vlf::CommandBufferContext &context) {
+        CommandBufferState &state = context.State<CommandBufferState>(this);
+        frame_bytes_[kLoadUndefined].Add(static_cast<int64_t>(state.avoidable_bytes[kLoadUndefined]));
+        frame_bytes_[kLoadOverwritten].Add(static_cast<int64_t>(state.avoidable_bytes[kLoadOverwritten]));
+        for (const auto &store : state.depth_stores) {
+            bool loaded = false;
+            if (loaded_images_.Find(store.image, &loaded)) continue;
+            frame_bytes_[kStoreUnread].Add(static_cast<int64_t>(store.bytes));
+            if (FirstImageWarning(store.image, kStoreUnread)) {
+                PerformanceWarning("Depth/stencil image is stored with STORE_OP_STORE but is never read afterwards; use "
+                                   "STORE_OP_DONT_CARE");
+            }
+        }
+    }
+
+    VkResult PostCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkResult result) {
+        uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed) + 1;
+        uint64_t total = 0;
+        for (int issue = 0; issue < kTrafficIssueCount; ++issue) {
+            uint64_t bytes = static_cast<uint64_t>(frame_bytes_[issue].Exchange());
+            frame_statistics_[issue].Record(bytes);
+            total += bytes;
+        }
+        total_statistics_.Record(total);
+        uint64_t report_frames = report_frames_.load(std::memory_order_relaxed);
+        if (report_frames != 0 && frame % report_frames == 0) Report(frame);
+        return VK_SUCCESS;
+    }
+
+   private:
+    static constexpr const char *kLayerIdentifier = "lunarg_render_pass_bandwidth";
+
+    enum Issue { kLoadUndefined, kLoadOverwritten, kStoreUnread, kTrafficIssueCount, kMissingTransient = kTrafficIssueCount };
+
+    struct ImageInfo {
+        VkDevice device;
+        VkImageUsageFlags usage;
+    };
+
+    struct ViewInfo {
+        VkDevice device;
+        VkImage image;
+    };
+
+    struct FramebufferInfo {
+        VkDevice device;
+        uint32_t width;
+        uint32_t height;
+        uint32_t layers;
+        bool imageless;
+        std::vector<VkImageView> views;
+    };
+
+    struct Attachment {
+        VkFormat format;
+        uint32_t samples;
+        VkAttachmentLoadOp load_op;
+        VkAttachmentStoreOp store_op;
+        VkAttachmentLoadOp stencil_load_op;
+        VkAttachmentStoreOp stencil_store_op;
+        VkImageLayout initial_layout;
+        uint32_t first_subpass;
+    };
+
+    struct Subpass {
+        std::vector<uint32_t> color;
+        uint32_t depth_stencil;
+    };
+
+    struct RenderPassInfo {
+        VkDevice device;
+        std::vector<Attachment> attachments;
+        std::vector<Subpass> subpasses;
+    };
+
+    // An attachment of the render pass instance being recorded, with the bytes a load or store of it moves
+    struct AttachmentUse {
+        VkImage image;
+        uint64_t main_bytes;
+        uint64_t stencil_bytes;
+    };
+
+    struct DepthStore {
+        VkImage image;
+        uint64_t bytes;
+    };
+
+    // Per-recording state, kept in the command buffer's context
+    struct CommandBufferState {
+        std::shared_ptr<const RenderPassInfo> render_pass;
+        VkRenderPass render_pass_handle = VK_NULL_HANDLE;
+        std::vector<AttachmentUse> attachments;
+        VkExtent2D render_area = {};
+        uint32_t layers = 0;
+        bool full_render_area = false;
+        uint32_t subpass = 0;
+        uint32_t subpass_start = 0;
+        // Attachments of the current subpass already counted as fully cleared, indexed like attachments
+        std::vector<bool> cleared_attachments;
+        uint64_t avoidable_bytes[kTrafficIssueCount] = {};
+        std::vector<DepthStore> depth_stores;
+    };
+
+    // Usage that lets an image's contents be read other than by loading it as an attachment
+    static const VkImageUsageFlags kReadableUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                    VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    static const VkImageUsageFlags kAttachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                                      VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+    // Bytes per texel of the color or depth part and of the stencil part of a format. Formats that cannot be attachments
+    // report zero.
+    static void FormatSizes(VkFormat format, uint32_t *main_size, uint32_t *stencil_size) {
+        static const struct {
+            VkFormat first;
+            VkFormat last;
+            uint32_t size;
+        } color_sizes[] = {
+            {VK_FORMAT_R4G4_UNORM_PACK8, VK_FORMAT_R4G4_UNORM_PACK8, 1},
+            {VK_FORMAT_R4G4B4A4_UNORM_PACK16, VK_FORMAT_A1R5G5B5_UNORM_PACK16, 2},
+            {VK_FORMAT_R8_UNORM, VK_FORMAT_R8_SRGB, 1},
+            {VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8_SRGB, 2},
+            {VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_B8G8R8_SRGB, 3},
+            {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_A2B10G10R10_SINT_PACK32, 4},
+            {VK_FORMAT_R16_UNORM, VK_FORMAT_R16_SFLOAT, 2},
+            {VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT, 4},
+            {VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16_SFLOAT, 6},
+            {VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT, 8},
+            {VK_FORMAT_R32_UINT, VK_FORMAT_R32_SFLOAT, 4},
+            {VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32_SFLOAT, 8},
+            {VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32_SFLOAT, 12},
+            {VK_FORMAT_R32G32B32A32_UINT, VK_FORMAT_R32G32B32A32_SFLOAT, 16},
+            {VK_FORMAT_R64_UINT, VK_FORMAT_R64_SFLOAT, 8},
+            {VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64_SFLOAT, 16},
+            {VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64_SFLOAT, 24},
+            {VK_FORMAT_R64G64B64A64_UINT, VK_FORMAT_R64G64B64A64_SFLOAT, 32},
+            {VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_E5B9G9R9_UFLOAT_PACK32, 4},
+        };
+        *main_size = 0;
+        *stencil_size = 0;
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+                *main_size = 2;
+                return;
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+                *main_size = 4;
+                return;
+            case VK_FORMAT_S8_UINT:
+                *stencil_size = 1;
+                return;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+                *main_size = 2;
+                *stencil_size = 1;
+                return;
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+                *main_size = 3;
+                *stencil_size = 1;
+                return;
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                *main_size = 4;
+                *stencil_size = 1;
+                return;
+            default:
+                break;
+        }
+        for (const auto &range : color_sizes) {
+            if (format >= range.first && format <= range.last) {
+                *main_size = range.size;
+                return;
+            }
+        }
+    }
+
+    static bool IsDepthStencilFormat(VkFormat format) {
+        return format >= VK_FORMAT_D16_UNORM && format <= VK_FORMAT_D32_SFLOAT_S8_UINT;
+    }
+
+    // VkRenderPassCreateInfo and VkRenderPassCreateInfo2 share the member names used here
+    template <typename CreateInfo>
+    static std::shared_ptr<const RenderPassInfo> MakeRenderPassInfo(VkDevice device, const CreateInfo &create_info) {
+        std::shared_ptr<RenderPassInfo> render_pass = std::make_shared<RenderPassInfo>();
+        render_pass->device = device;
+        for (uint32_t i = 0; i < create_info.attachmentCount; ++i) {
+            const auto &description = create_info.pAttachments[i];
+            render_pass->attachments.push_back({description.format, static_cast<uint32_t>(description.samples), description.loadOp,
+                                                description.storeOp, description.stencilLoadOp, description.stencilStoreOp,
+                                                description.initialLayout, VK_ATTACHMENT_UNUSED});
+        }
+        for (uint32_t i = 0; i < create_info.subpassCount; ++i) {
+            const auto &description = create_info.pSubpasses[i];
+            Subpass subpass;
+            for (uint32_t j = 0; j < description.colorAttachmentCount; ++j) {
+                subpass.color.push_back(description.pColorAttachments[j].attachment);
+            }
+            subpass.depth_stencil =
+                description.pDepthStencilAttachment ? description.pDepthStencilAttachment->attachment : VK_ATTACHMENT_UNUSED;
+            for (uint32_t index : subpass.color) MarkFirstUse(render_pass.get(), index, i);
+            MarkFirstUse(render_pass.get(), subpass.depth_stencil, i);
+            for (uint32_t j = 0; j < description.inputAttachmentCount; ++j) {
+                MarkFirstUse(render_pass.get(), description.pInputAttachments[j].attachment, i);
+            }
+            render_pass->subpasses.push_back(std::move(subpass));
+        }
+        return render_pass;
+    }
+    static void MarkFirstUse(RenderPassInfo *render_pass, uint32_t index, uint32_t subpass) {
+        if (index < render_pass->attachments.size() && render_pass->attachments[index].first_subpass == VK_ATTACHMENT_UNUSED) {
+            render_pass->attachments[index].first_subpass = subpass;
+        }
+    }
+
+    static const VkImageView *FindAttachmentViews(const VkRenderPassBeginInfo &begin, uint32_t *count) {
+        for (auto *structure = static_cast<const VkBaseInStructure *>(begin.pNext); structure; structure = structure->pNext) {
+            if (structure->sType == VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO) {
+                auto attachment_begin = reinterpret_cast<const VkRenderPassAttachmentBeginInfo *>(structure);
+                *count = attachment_begin->attachmentCount;
+                return attachment_begin->pAttachments;
+            }
+        }
+        *count = 0;
+        return nullptr;
+    }
+
+    void BeginRenderPass(VkCommandBuffer command_buffer, const VkRenderPassBeginInfo &begin) {
+        vlf::CommandBufferContext *context = GetCommandBufferContext(command_buffer);
+        if (!context) return;
+        CommandBufferState &state = context->State<CommandBufferState>(this);
+        state.render_pass.reset();
+        std::shared_ptr<const RenderPassInfo> render_pass;
+        std::shared_ptr<const FramebufferInfo> framebuffer;
+        if (!render_passes_.Find(begin.renderPass, &render_pass) || !framebuffers_.Find(begin.framebuffer, &framebuffer)) return;
+
+        uint32_t view_count = static_cast<uint32_t>(framebuffer->views.size());
+        const VkImageView *views = framebuffer->views.data();
+        if (framebuffer->imageless) views = FindAttachmentViews(begin, &view_count);
+
+        state.render_pass = render_pass;
+        state.render_pass_handle = begin.renderPass;
+        state.render_area = begin.renderArea.extent;
+        state.layers = framebuffer->layers;
+        state.full_render_area = begin.renderArea.offset.x == 0 && begin.renderArea.offset.y == 0 &&
+                                 begin.renderArea.extent.width >= framebuffer->width &&
+                                 begin.renderArea.extent.height >= framebuffer->height;
+        state.subpass = 0;
+        state.subpass_start = context->CommandIndex();
+        state.attachments.clear();
+        state.cleared_attachments.assign(render_pass->attachments.size(), false);
+
+        uint64_t texels = uint64_t(begin.renderArea.extent.width) * begin.renderArea.extent.height * framebuffer->layers;
+        for (uint32_t i = 0; i < render_pass->attachments.size(); ++i) {
+            const Attachment &attachment = render_pass->attachments[i];
+            uint32_t main_size, stencil_size;
+            FormatSizes(attachment.format, &main_size, &stencil_size);
+            AttachmentUse use = {VK_NULL_HANDLE, texels * attachment.samples * main_size,
+                                 texels * attachment.samples * stencil_size};
+            ViewInfo view;
+            if (i < view_count && views_.Find(views[i], &view)) use.image = view.image;
+            state.attachments.push_back(use);
+            AnalyzeLoadStore(state, i);
+        }
+    }
+
+    void AnalyzeLoadStore(CommandBufferState &state, uint32_t index) {
+        const Attachment &attachment = state.render_pass->attachments[index];
+        const AttachmentUse &use = state.attachments[index];
+        bool loads_main = use.main_bytes && attachment.load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+        bool loads_stencil = use.stencil_bytes && attachment.stencil_load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+        bool stores_main = use.main_bytes && attachment.store_op == VK_ATTACHMENT_STORE_OP_STORE;
+        bool stores_stencil = use.stencil_bytes && attachment.stencil_store_op == VK_ATTACHMENT_STORE_OP_STORE;
+        if (attachment.first_subpass == VK_ATTACHMENT_UNUSED) return;
+
+        if (loads_main || loads_stencil) {
+            if (use.image != VK_NULL_HANDLE) loaded_images_.Insert(use.image, true);
+            if (attachment.initial_layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+                state.avoidable_bytes[kLoadUndefined] +=
+                    (loads_main ? use.main_bytes : 0) + (loads_stencil ? use.stencil_bytes : 0);
+                if (FirstRenderPassWarning(state.render_pass_handle, kLoadUndefined, index)) {
+                    PerformanceWarning("Render pass attachment " + std::to_string(index) +
+                                       " uses LOAD_OP_LOAD with initialLayout UNDEFINED, loading undefined contents; use "
+                                       "LOAD_OP_DONT_CARE or LOAD_OP_CLEAR");
+                }
+            }
+        }
+
+        ImageInfo image;
+        if (use.image == VK_NULL_HANDLE || !images_.Find(use.image, &image)) return;
+        if (IsDepthStencilFormat(attachment.format) && (stores_main || stores_stencil) && !(image.usage & kReadableUsage)) {
+            state.depth_stores.push_back(
+                {use.image, (stores_main ? use.main_bytes : 0) + (stores_stencil ? use.stencil_bytes : 0)});
+        }
+        if (!loads_main && !loads_stencil && !stores_main && !stores_stencil && !(image.usage & ~kAttachmentUsage) &&
+            !(image.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && FirstImageWarning(use.image, kMissingTransient)) {
+            ++transient_candidates_;
+            PerformanceWarning("Attachment image is never loaded or stored but was created without "
+                               "VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT; with it the image could use lazily allocated memory");
+        }
+    }
+
+    void NextSubpass(VkCommandBuffer command_buffer) {
+        vlf::CommandBufferContext *context = GetCommandBufferContext(command_buffer);
+        if (!context) return;
+        CommandBufferState &state = context->State<CommandBufferState>(this);
+        if (!state.render_pass || state.subpass + 1 >= state.render_pass->subpasses.size()) return;
+        ++state.subpass;
+        state.subpass_start = context->CommandIndex();
+        state.cleared_attachments.assign(state.cleared_attachments.size(), false);
+    }
+
+    void EndRenderPass(VkCommandBuffer command_buffer) {
+        vlf::CommandBufferContext *context = GetCommandBufferContext(command_buffer);
+        if (context) context->State<CommandBufferState>(this).render_pass.reset();
+    }
+
+    static bool DrawnInSubpass(const vlf::CommandBufferContext &context, const CommandBufferState &state) {
+        const std::vector<vlf::RecordedCommand> &commands = context.Commands();
+        for (size_t i = state.subpass_start; i < commands.size(); ++i) {
+            if (strncmp(commands[i].name, "vkCmdDraw", 9) == 0) return true;
+        }
+        return false;
+    }
+
+    // Each problem is warned about once per render pass attachment or per image
+    bool FirstRenderPassWarning(VkRenderPass render_pass, Issue issue, uint32_t attachment) {
+        size_t index = size_t(attachment) * kTrafficIssueCount + issue;
+        bool first = false;
+        warned_render_passes_.Update(render_pass, [index, &first](std::vector<bool> &warned) {
+            if (index >= warned.size()) warned.resize(index + 1, false);
+            first = !warned[index];
+            warned[index] = true;
+        });
+        return first;
+    }
+    bool FirstImageWarning(VkImage image, Issue issue) {
+        uint32_t bit = 1u << issue;
+        bool first = false;
+        warned_images_.Update(image, [bit, &first](uint32_t &warned) {
+            first = !(warned & bit);
+            warned |= bit;
+        });
+        return first;
+    }
+
+    void Report(uint64_t frame) {
+        static const char *const issue_names[] = {"LOAD_OP_LOAD of undefined contents", "LOAD_OP_LOAD of cleared attachments",
+                                                  "STORE_OP_STORE of unread depth/stencil"};
+        std::string text;
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "Render pass bandwidth after %" PRIu64 " frames: avoidable traffic %.3f MiB/frame mean, %.3f MiB max\n", frame,
+                 total_statistics_.Mean() / (1024.0 * 1024.0), total_statistics_.Max() / (1024.0 * 1024.0));
+        text += line;
+        for (int issue = 0; issue < kTrafficIssueCount; ++issue) {
+            snprintf(line, sizeof(line), "  %-40s %10.3f MiB/frame mean %10.3f MiB max\n", issue_names[issue],
+                     frame_statistics_[issue].Mean() / (1024.0 * 1024.0), frame_statistics_[issue].Max() / (1024.0 * 1024.0));
+            text += line;
+        }
+        snprintf(line, sizeof(line), "  %-40s %10" PRIu64 " images\n", "Attachments missing TRANSIENT usage",
+                 transient_candidates_.load(std::memory_order_relaxed));
+        text += line;
+        Print(text);
+        for (auto &statistics : frame_statistics_) statistics.Reset();
+        total_statistics_.Reset();
+    }
+
+    // Settings
+    std::atomic<uint64_t> report_frames_;
+
+    vlf::ConcurrentHandleMap<VkImage, ImageInfo> images_;
+    vlf::ConcurrentHandleMap<VkImageView, ViewInfo> views_;
+    vlf::ConcurrentHandleMap<VkFramebuffer, std::shared_ptr<const FramebufferInfo>> framebuffers_;
+    vlf::ConcurrentHandleMap<VkRenderPass, std::shared_ptr<const RenderPassInfo>> render_passes_;
+    // Images some render pass has loaded, whose stored contents are therefore read
+    vlf::ConcurrentHandleMap<VkImage, bool> loaded_images_;
+    // Issues already warned about, kTrafficIssueCount entries per attachment
+    vlf::ConcurrentHandleMap<VkRenderPass, std::vector<bool>> warned_render_passes_;
+    vlf::ConcurrentHandleMap<VkImage, uint32_t> warned_images_;
+
+    std::atomic<uint64_t> frame_;
+    std::atomic<uint64_t> transient_candidates_;
+    vlf::PerThreadCounter<> frame_bytes_[kTrafficIssueCount];
+    vlf::StatisticsAccumulator frame_statistics_[kTrafficIssueCount];
+    vlf::StatisticsAccumulator total_statistics_;
+};
+
+RenderPassBandwidth render_pass_bandwidth;
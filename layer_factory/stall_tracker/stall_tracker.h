@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+#include "vlf_backtrace.h"
+#include "vlf_concurrency.h"
+#include "vlf_histogram.h"
+#include "vlf_settings.h"
+
+// Measures the time application threads spend blocked in Vulkan calls that wait for the GPU or the presentation engine:
+// vkWaitForFences, vkWaitSemaphores, vkQueueWaitIdle, vkDeviceWaitIdle, vkGetQueryPoolResults with
+// VK_QUERY_RESULT_WAIT_BIT and vkAcquireNextImageKHR. Every stall is attributed to the application call stack it came
+// from; stacks are captured as raw addresses and identical stacks share one entry, so symbols are only looked up when
+// reporting. vkQueueWaitIdle and vkDeviceWaitIdle after the first present get one performance warning per call stack,
+// as idling the GPU in the middle of rendering is rarely intended.
+//
+// Settings:
+//   lunarg_stall_tracker.report_frames  Print a summary every N presents, 0 for vkDestroyInstance only (default 600)
+//   lunarg_stall_tracker.top_count      Number of call stacks listed in the summary (default 10)
+//   lunarg_stall_tracker.stack_depth    Frames printed per call stack (default 8)
+class StallTracker : public layer_factory {
+   public:
+    StallTracker() : layer_factory(this, kLayerIdentifier), report_frames_(600), top_count_(10), stack_depth_(8), frame_(0){};
+
+    VkResult PostCallCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                    VkInstance *pInstance, VkResult result) {
+        report_frames_ = vlf::GetLayerSettingUint(kLayerIdentifier, "report_frames", report_frames_);
+        top_count_ = vlf::GetLayerSettingUint(kLayerIdentifier, "top_count", top_count_);
+        stack_depth_ = vlf::GetLayerSettingUint(kLayerIdentifier, "stack_depth", stack_depth_);
+        return VK_SUCCESS;
+    }
+
+    void PreCallDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+        Report(frame_.load(std::memory_order_relaxed));
+    }
+
+    VkResult PreCallWaitForFences(VkDevice device, uint32_t fenceCount, const VkFence *pFences, VkBool32 waitAll,
+                                  uint64_t timeout) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallWaitForFences(VkDevice device, uint32_t fenceCount, const VkFence *pFences, VkBool32 waitAll,
+                                   uint64_t timeout, VkResult result) {
+        RecordStall(kWaitForFences);
+        return VK_SUCCESS;
+    }
+
+    VkResult PreCallWaitSemaphores(VkDevice device, const VkSemaphoreWaitInfo *pWaitInfo, uint64_t timeout) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallWaitSemaphores(VkDevice device, const VkSemaphoreWaitInfo *pWaitInfo, uint64_t timeout, VkResult result) {
+        RecordStall(kWaitSemaphores);
+        return VK_SUCCESS;
+    }
+    VkResult PreCallWaitSemaphoresKHR(VkDevice device, const VkSemaphoreWaitInfo *pWaitInfo, uint64_t timeout) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallWaitSemaphoresKHR(VkDevice device, const VkSemaphoreWaitInfo *pWaitInfo, uint64_t timeout,
+                                       VkResult result) {
+        RecordStall(kWaitSemaphores);
+        return VK_SUCCESS;
+    }
+
+    VkResult PreCallQueueWaitIdle(VkQueue queue) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallQueueWaitIdle(VkQueue queue, VkResult result) {
+        RecordStall(kQueueWaitIdle);
+        return VK_SUCCESS;
+    }
+
+    VkResult PreCallDeviceWaitIdle(VkDevice device) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallDeviceWaitIdle(VkDevice device, VkResult result) {
+        RecordStall(kDeviceWaitIdle);
+        return VK_SUCCESS;
+    }
+
+    // Without VK_QUERY_RESULT_WAIT_BIT the call returns VK_NOT_READY instead of blocking
+    VkResult PreCallGetQueryPoolResults(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount,
+                                        size_t dataSize, void *pData, VkDeviceSize stride, VkQueryResultFlags flags) {
+        if (flags & VK_QUERY_RESULT_WAIT_BIT) StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallGetQueryPoolResults(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount,
+                                         size_t dataSize, void *pData, VkDeviceSize stride, VkQueryResultFlags flags,
+                                         VkResult result) {
+        if (flags & VK_QUERY_RESULT_WAIT_BIT) RecordStall(kGetQueryPoolResults);
+        return VK_SUCCESS;
+    }
+
+    VkResult PreCallAcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore,
+                                        VkFence fence, uint32_t *pImageIndex) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallAcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore,
+                                         VkFence fence, uint32_t *pImageIndex, VkResult result) {
+        RecordStall(kAcquireNextImage);
+        return VK_SUCCESS;
+    }
+    VkResult PreCallAcquireNextImage2KHR(VkDevice device, const VkAcquireNextImageInfoKHR *pAcquireInfo, uint32_t *pImageIndex) {
+        StartTimer();
+        return VK_SUCCESS;
+    }
+    VkResult PostCallAcquireNextImage2KHR(VkDevice device, const VkAcquireNextImageInfoKHR *pAcquireInfo, uint32_t *pImageIndex,
+                                          VkResult result) {
+        RecordStall(kAcquireNextImage);
+        return VK_SUCCESS;
+    }
+
+    VkResult PostCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkResult result) {
+        uint64_t frame = frame_.fetch_add(1, std::memory_order_relaxed) + 1;
+        frame_statistics_.Record(static_cast<uint64_t>(frame_stall_time_.Exchange()));
+        uint64_t report_frames = report_frames_.load(std::memory_order_relaxed);
+        if (report_frames != 0 && frame % report_frames == 0) Report(frame);
+        return VK_SUCCESS;
+    }
+
+   private:
+    static constexpr const char *kLayerIdentifier = "lunarg_stall_tracker";
+    static const uint32_t kMaxFrames = 32;
+
+    enum Call {
+        kWaitForFences,
+        kWaitSemaphores,
+        kQueueWaitIdle,
+        kDeviceWaitIdle,
+        kGetQueryPoolResults,
+        kAcquireNextImage,
+        kCallCount
+    };
+
+    // Stalls from one call stack; the entrypoint is part of the key
+    struct Stack {
+        Call call = kWaitForFences;
+        std::vector<uintptr_t> frames;
+        uint64_t count = 0;
+        uint64_t total_time = 0;
+        uint64_t max_time = 0;
+    };
+
+    static const char *CallName(Call call) {
+        static const char *const names[] = {"vkWaitForFences",       "vkWaitSemaphores",      "vkQueueWaitIdle",
+                                            "vkDeviceWaitIdle",      "vkGetQueryPoolResults", "vkAcquireNextImageKHR"};
+        return names[call];
+    }
+
+    static uint64_t &StartTime() {
+        static thread_local uint64_t start_time = 0;
+        return start_time;
+    }
+    void StartTimer() { StartTime() = vlf::NowNanoseconds(); }
+
+    void RecordStall(Call call) {
+        uint64_t end_time = vlf::NowNanoseconds();
+        uint64_t start_time = StartTime();
+        if (start_time == 0) return;
+        StartTime() = 0;
+        uint64_t stall_time = end_time - start_time;
+        call_counts_[call].Increment();
+        call_times_[call].Add(static_cast<int64_t>(stall_time));
+        frame_stall_time_.Add(static_cast<int64_t>(stall_time));
+
+        // Captured after the call returns so the capture is not part of the measured stall
+        uintptr_t frames[kMaxFrames];
+        uint32_t frame_count = vlf::CaptureBacktrace(frames, kMaxFrames);
+        uint64_t key = vlf::HashBacktrace(frames, frame_count) ^ (static_cast<uint64_t>(call) << 56);
+        bool first = false;
+        stacks_.Update(key, [&](Stack &stack) {
+            if (stack.count == 0) {
+                first = true;
+                stack.call = call;
+                stack.frames.assign(frames, frames + frame_count);
+            }
+            ++stack.count;
+            stack.total_time += stall_time;
+            stack.max_time = std::max(stack.max_time, stall_time);
+        });
+
+        if (first && (call == kQueueWaitIdle || call == kDeviceWaitIdle) && frame_.load(std::memory_order_relaxed) != 0) {
+            std::string message = std::string(CallName(call)) + " called while rendering, stalling the GPU pipeline, from:";
+            std::vector<uintptr_t> application_frames = ApplicationFrames(frames, frame_count, 4);
+            for (uintptr_t address : application_frames) message += "\n    " + vlf::SymbolizeAddress(address);
+            PerformanceWarning(message);
+        }
+    }
+
+    // The frames of a stack outside the layer, up to max_frames of them
+    static std::vector<uintptr_t> ApplicationFrames(const uintptr_t *frames, uint32_t frame_count, uint64_t max_frames) {
+        std::vector<uintptr_t> application_frames;
+        uint32_t first = 0;
+        while (first < frame_count && vlf::IsLayerAddress(frames[first])) ++first;
+        for (uint32_t i = first; i < frame_count && application_frames.size() < max_frames; ++i) {
+            application_frames.push_back(frames[i]);
+        }
+        return application_frames;
+    }
+
+    void Report(uint64_t frame) {
+        std::string text;
+        char line[256];
+        snprintf(line, sizeof(line), "CPU stalls after %" PRIu64 " frames: %.3f ms/frame mean, %.3f ms max\n", frame,
+                 frame_statistics_.Mean() / 1e6, frame_statistics_.Max() / 1e6);
+        text += line;
+        for (int call = 0; call < kCallCount; ++call) {
+            int64_t count = call_counts_[call].Sum();
+            if (count == 0) continue;
+            double total_time = static_cast<double>(call_times_[call].Sum());
+            snprintf(line, sizeof(line), "  %-24s %10" PRId64 " calls %12.3f ms total %10.3f us mean\n",
+                     CallName(static_cast<Call>(call)), count, total_time / 1e6, total_time / count / 1e3);
+            text += line;
+        }
+
+        std::vector<Stack> stacks;
+        stacks_.ForEach([&stacks](uint64_t, const Stack &stack) { stacks.push_back(stack); });
+        size_t count = std::min<size_t>(stacks.size(), top_count_.load(std::memory_order_relaxed));
+        std::partial_sort(stacks.begin(), stacks.begin() + count, stacks.end(),
+                          [](const Stack &a, const Stack &b) { return a.total_time > b.total_time; });
+        if (count) text += "  Call stacks with the most stall time:\n";
+        for (size_t i = 0; i < count; ++i) {
+            const Stack &stack = stacks[i];
+            snprintf(line, sizeof(line), "  %s: %" PRIu64 " calls, %.3f ms total, %.3f ms max\n", CallName(stack.call),
+                     stack.count, stack.total_time / 1e6, stack.max_time / 1e6);
+            text += line;
+            std::vector<uintptr_t> application_frames = ApplicationFrames(
+                stack.frames.data(), static_cast<uint32_t>(stack.frames.size()), stack_depth_.load(std::memory_order_relaxed));
+            for (uintptr_t address : application_frames) text += "      " + vlf::SymbolizeAddress(address) + "\n";
+        }
+        Print(text);
+        frame_statistics_.Reset();
+    }
+
+    // Settings
+    std::atomic<uint64_t> report_frames_;
+    std::atomic<uint64_t> top_count_;
+    std::atomic<uint64_t> stack_depth_;
+
+    std::atomic<uint64_t> frame_;
+    vlf::PerThreadCounter<> call_counts_[kCallCount];
+    vlf::PerThreadCounter<> call_times_[kCallCount];
+    vlf::PerThreadCounter<> frame_stall_time_;
+    vlf::StatisticsAccumulator frame_statistics_;
+    vlf::ConcurrentHandleMap<uint64_t, Stack> stacks_;
+};
+
+StallTracker stall_tracker;
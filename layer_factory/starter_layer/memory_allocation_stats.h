@@ -19,41 +19,41 @@
 
 #pragma once
 
+#include <atomic>
 #include <sstream>
-#include <unordered_map>
+#include "vlf_concurrency.h"
 
 static uint32_t display_rate = 60;
 
 class MemAllocLevel : public layer_factory {
    public:
     // Constructor for interceptor
-    MemAllocLevel() : number_mem_objects_(0), total_memory_(0), present_count_(0){};
+    MemAllocLevel() : layer_factory(this), present_count_(0){};
 
     // Intercept the memory allocation calls and increment the counter
     VkResult PostCallAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
                                     const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory, VkResult result) {
-        number_mem_objects_++;
-        total_memory_ += pAllocateInfo->allocationSize;
-        mem_size_map_[*pMemory] = pAllocateInfo->allocationSize;
+        if (result != VK_SUCCESS) return VK_SUCCESS;
+        number_mem_objects_.Increment();
+        total_memory_.Add(pAllocateInfo->allocationSize);
+        mem_size_map_.Insert(*pMemory, pAllocateInfo->allocationSize);
         return VK_SUCCESS;
     };
 
     // Intercept the free memory calls and update totals
     void PreCallFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *pAllocator) {
-        if (memory != VK_NULL_HANDLE) {
-            number_mem_objects_--;
-            VkDeviceSize this_alloc = mem_size_map_[memory];
-            total_memory_ -= this_alloc;
+        VkDeviceSize this_alloc = 0;
+        if (memory != VK_NULL_HANDLE && mem_size_map_.Erase(memory, &this_alloc)) {
+            number_mem_objects_.Decrement();
+            total_memory_.Add(-static_cast<int64_t>(this_alloc));
         }
     }
 
     VkResult PreCallQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
-        present_count_++;
-        if (present_count_ >= display_rate) {
-            present_count_ = 0;
+        if (++present_count_ % display_rate == 0) {
             std::stringstream message;
-            message << "Memory Allocation Count: " << number_mem_objects_ << "\n";
-            message << "Total Memory Allocation Size: " << total_memory_ << "\n\n";
+            message << "Memory Allocation Count: " << number_mem_objects_.Sum() << "\n";
+            message << "Total Memory Allocation Size: " << total_memory_.Sum() << "\n\n";
             Information(message.str());
         }
         return VK_SUCCESS;
@@ -61,10 +61,10 @@ class MemAllocLevel : public layer_factory {
 
    private:
     // Counter for the number of currently active memory allocations
-    uint32_t number_mem_objects_;
-    VkDeviceSize total_memory_;
-    uint32_t present_count_;
-    std::unordered_map<VkDeviceMemory, VkDeviceSize> mem_size_map_;
+    vlf::PerThreadCounter<> number_mem_objects_;
+    vlf::PerThreadCounter<> total_memory_;
+    std::atomic<uint32_t> present_count_;
+    vlf::ConcurrentHandleMap<VkDeviceMemory, VkDeviceSize> mem_size_map_;
 };
 
 MemAllocLevel memory_allocation_stats;
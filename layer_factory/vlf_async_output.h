@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Asynchronous backend for the factory's output helpers. When enabled, Information(), Warning() and the other helpers
+// append the message to a buffer owned by the calling thread and return; a writer thread collects the buffers and
+// hands the messages, in submission order, to the layer's sink. Pending messages are written out at vkDestroyInstance.
+// A copy of the most recent messages is also kept in a preallocated ring, already formatted, so that a fatal signal
+// handler can write the ones not yet delivered to stderr without allocating or taking locks.
+
+#pragma once
+
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace vlf {
+
+// A queued message. context is the debug_report_data the message is reported through, or null for plain text output.
+struct OutputRecord {
+    uint64_t sequence;
+    const void *context;
+    uint32_t flags;
+    std::string tag;
+    std::string text;
+};
+
+typedef void (*OutputSink)(const OutputRecord &record);
+
+class AsyncOutput {
+   public:
+    static AsyncOutput &Get() {
+        static AsyncOutput async_output;
+        return async_output;
+    }
+
+    bool Enabled() const { return sink_.load(std::memory_order_acquire) != nullptr; }
+
+    // Starts the writer thread, which passes every record to sink. Calling Start() again while running has no effect.
+    void Start(OutputSink sink) {
+        std::lock_guard<std::mutex> lock(control_lock_);
+        if (writer_.joinable()) return;
+        sink_.store(sink, std::memory_order_release);
+        stop_ = false;
+        writer_ = std::thread(&AsyncOutput::WriterLoop, this);
+        InstallSignalHandlers();
+    }
+
+    // Writes out everything queued so far, stops the writer thread and puts back the previous signal handlers. Later
+    // messages are written synchronously.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(control_lock_);
+            if (!writer_.joinable()) return;
+            RestoreSignalHandlers();
+            {
+                std::lock_guard<std::mutex> wake_lock(wake_lock_);
+                stop_ = true;
+            }
+            wake_.notify_one();
+            writer_.join();
+        }
+        Flush();
+        sink_.store(nullptr, std::memory_order_release);
+    }
+
+    void Submit(const void *context, uint32_t flags, const std::string &tag, const std::string &text) {
+        ThreadBuffer &buffer = GetThreadBuffer();
+        size_t pending;
+        {
+            std::lock_guard<std::mutex> lock(buffer.lock);
+            uint64_t sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+            RememberForCrash(sequence, tag, text);
+            buffer.records.push_back({sequence, context, flags, tag, text});
+            pending = buffer.records.size();
+        }
+        if (pending == kWakeThreshold) wake_.notify_one();
+    }
+
+    // Writes out every record submitted before the call, on the calling thread, before returning
+    void Flush() {
+        std::lock_guard<std::mutex> lock(drain_lock_);
+        Drain();
+    }
+
+    ~AsyncOutput() {
+#if defined(_WIN32)
+        // Other threads are already gone when a DLL's static destructors run at process exit, so joining could hang
+        if (writer_.joinable()) writer_.detach();
+#else
+        Stop();
+#endif
+    }
+
+   private:
+    // Records a thread may queue before the writer is woken early
+    static const size_t kWakeThreshold = 256;
+    static const int kMaxSignalNumber = 64;
+    // Size of the ring of formatted messages written out on a fatal signal. Longer messages are truncated.
+    static const size_t kCrashSlotCount = 128;
+    static const size_t kCrashSlotSize = 512;
+
+    struct ThreadBuffer {
+        std::mutex lock;
+        std::vector<OutputRecord> records;
+    };
+
+    // sequence is the record's sequence plus one while the record is undelivered, and zero otherwise. busy is held
+    // while a submitting thread formats into the slot.
+    struct CrashSlot {
+        std::atomic<bool> busy;
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint32_t> length;
+        char text[kCrashSlotSize];
+    };
+
+#if defined(_WIN32)
+    typedef void (*SignalAction)(int signal_number);
+#else
+    typedef struct sigaction SignalAction;
+#endif
+
+    AsyncOutput() : sink_(nullptr), next_sequence_(0), stop_(false), signal_handlers_installed_(false) {
+        for (auto &slot : crash_slots_) {
+            slot.busy.store(false, std::memory_order_relaxed);
+            slot.sequence.store(0, std::memory_order_relaxed);
+            slot.length.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Buffers live for the rest of the process, so a thread that exits leaves an empty buffer behind
+    ThreadBuffer &GetThreadBuffer() {
+        static thread_local ThreadBuffer *thread_buffer = nullptr;
+        if (thread_buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(buffers_lock_);
+            buffers_.emplace_back(new ThreadBuffer);
+            thread_buffer = buffers_.back().get();
+        }
+        return *thread_buffer;
+    }
+
+    void WriterLoop() {
+        const std::chrono::milliseconds write_period(10);
+        std::unique_lock<std::mutex> lock(wake_lock_);
+        while (!stop_) {
+            wake_.wait_for(lock, write_period);
+            lock.unlock();
+            Flush();
+            lock.lock();
+        }
+    }
+
+    // Collects the records of every thread and writes them in submission order. A thread can take a sequence number
+    // after its buffer was visited while a later number is already in a buffer visited after it, so only the records
+    // numbered below next_sequence_ as read beforehand, which are all in their buffers by then, are written. The rest
+    // are held back for the next drain. Called with drain_lock_ held.
+    void Drain() {
+        OutputSink sink = sink_.load(std::memory_order_acquire);
+        if (sink == nullptr) return;
+        const uint64_t end = next_sequence_.load(std::memory_order_acquire);
+        std::vector<OutputRecord> batch;
+        batch.swap(held_back_);
+        {
+            std::lock_guard<std::mutex> lock(buffers_lock_);
+            for (auto &buffer : buffers_) {
+                std::lock_guard<std::mutex> buffer_lock(buffer->lock);
+                if (buffer->records.empty()) continue;
+                if (batch.empty()) {
+                    batch.swap(buffer->records);
+                } else {
+                    std::move(buffer->records.begin(), buffer->records.end(), std::back_inserter(batch));
+                    buffer->records.clear();
+                }
+            }
+        }
+        std::sort(batch.begin(), batch.end(),
+                  [](const OutputRecord &a, const OutputRecord &b) { return a.sequence < b.sequence; });
+        auto later = std::lower_bound(batch.begin(), batch.end(), end,
+                                      [](const OutputRecord &record, uint64_t sequence) { return record.sequence < sequence; });
+        for (auto record = batch.begin(); record != later; ++record) {
+            sink(*record);
+            ForgetForCrash(record->sequence);
+        }
+        held_back_.assign(std::make_move_iterator(later), std::make_move_iterator(batch.end()));
+    }
+
+    // Formats "tag: text" into the record's crash slot. When another thread is still writing the slot, which takes
+    // kCrashSlotCount messages in flight at once, the record is left out of the ring. A slot rewritten while a fatal
+    // signal is being handled may be written out torn, which is acceptable for a best-effort dump.
+    void RememberForCrash(uint64_t sequence, const std::string &tag, const std::string &text) {
+        CrashSlot &slot = crash_slots_[sequence % kCrashSlotCount];
+        if (slot.busy.exchange(true, std::memory_order_acquire)) return;
+        slot.sequence.store(0, std::memory_order_relaxed);
+        size_t length = 0;
+        auto append = [&slot, &length](const char *data, size_t size) {
+            size = std::min(size, kCrashSlotSize - 1 - length);
+            memcpy(slot.text + length, data, size);
+            length += size;
+        };
+        if (!tag.empty()) {
+            append(tag.data(), tag.size());
+            append(": ", 2);
+        }
+        append(text.data(), text.size());
+        if (length == 0 || slot.text[length - 1] != '\n') slot.text[length++] = '\n';
+        slot.length.store(static_cast<uint32_t>(length), std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_release);
+        slot.busy.store(false, std::memory_order_release);
+    }
+
+    void ForgetForCrash(uint64_t sequence) {
+        uint64_t expected = sequence + 1;
+        crash_slots_[sequence % kCrashSlotCount].sequence.compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+    }
+
+    static const int *FatalSignals(size_t *count) {
+        static const int fatal_signals[] = {
+            SIGSEGV, SIGABRT, SIGILL, SIGFPE,
+#if defined(SIGBUS)
+            SIGBUS,
+#endif
+        };
+        *count = sizeof(fatal_signals) / sizeof(fatal_signals[0]);
+        return fatal_signals;
+    }
+
+    static SignalAction &PreviousAction(int signal_number) {
+        static SignalAction previous_actions[kMaxSignalNumber] = {};
+        return previous_actions[signal_number % kMaxSignalNumber];
+    }
+
+    // Called with control_lock_ held
+    void InstallSignalHandlers() {
+        if (signal_handlers_installed_) return;
+        signal_handlers_installed_ = true;
+        size_t count;
+        const int *fatal_signals = FatalSignals(&count);
+        for (size_t i = 0; i < count; ++i) {
+#if defined(_WIN32)
+            SignalAction previous = signal(fatal_signals[i], &AsyncOutput::OnFatalSignal);
+            PreviousAction(fatal_signals[i]) = (previous == SIG_ERR) ? SIG_DFL : previous;
+#else
+            struct sigaction action = {};
+            action.sa_handler = &AsyncOutput::OnFatalSignal;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESETHAND;
+            if (sigaction(fatal_signals[i], &action, &PreviousAction(fatal_signals[i])) != 0) {
+                PreviousAction(fatal_signals[i]) = SignalAction{};
+                PreviousAction(fatal_signals[i]).sa_handler = SIG_DFL;
+            }
+#endif
+        }
+    }
+
+    // Called with control_lock_ held. The layer library may be unloaded after Stop(), so its handler must not stay
+    // installed.
+    void RestoreSignalHandlers() {
+        if (!signal_handlers_installed_) return;
+        signal_handlers_installed_ = false;
+        size_t count;
+        const int *fatal_signals = FatalSignals(&count);
+        for (size_t i = 0; i < count; ++i) RestorePreviousAction(fatal_signals[i]);
+    }
+
+    static void RestorePreviousAction(int signal_number) {
+#if defined(_WIN32)
+        signal(signal_number, PreviousAction(signal_number));
+#else
+        sigaction(signal_number, &PreviousAction(signal_number), nullptr);
+#endif
+    }
+
+    static void WriteToStderr(const char *text, size_t length) {
+#if defined(_WIN32)
+        _write(2, text, static_cast<unsigned int>(length));
+#else
+        while (length > 0) {
+            ssize_t written = write(STDERR_FILENO, text, length);
+            if (written <= 0) return;
+            text += written;
+            length -= static_cast<size_t>(written);
+        }
+#endif
+    }
+
+    // Writes the undelivered messages still in the crash ring to stderr, then lets the previous handler deal with the
+    // signal. Only atomics and write() are used here, which are async-signal-safe.
+    static void OnFatalSignal(int signal_number) {
+        AsyncOutput &output = Get();
+        uint64_t end = output.next_sequence_.load(std::memory_order_acquire);
+        uint64_t begin = (end > kCrashSlotCount) ? end - kCrashSlotCount : 0;
+        for (uint64_t sequence = begin; sequence < end; ++sequence) {
+            const CrashSlot &slot = output.crash_slots_[sequence % kCrashSlotCount];
+            if (slot.sequence.load(std::memory_order_acquire) != sequence + 1) continue;
+            WriteToStderr(slot.text, slot.length.load(std::memory_order_relaxed));
+        }
+        RestorePreviousAction(signal_number);
+        raise(signal_number);
+    }
+
+    std::atomic<OutputSink> sink_;
+    std::atomic<uint64_t> next_sequence_;
+
+    std::mutex buffers_lock_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+
+    std::mutex drain_lock_;
+    // Records collected by a drain but numbered after the ones it could write, in sequence order
+    std::vector<OutputRecord> held_back_;
+    std::mutex control_lock_;
+    std::mutex wake_lock_;
+    std::condition_variable wake_;
+    bool stop_;
+    std::thread writer_;
+
+    bool signal_handlers_installed_;
+    CrashSlot crash_slots_[kCrashSlotCount];
+};
+
+}  // namespace vlf
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <unwind.h>
+#endif
+#include "vlf_hash.h"
+
+namespace vlf {
+
+#if !defined(_WIN32)
+struct UnwindState {
+    uintptr_t *frames;
+    uint32_t count;
+    uint32_t max_frames;
+};
+
+inline _Unwind_Reason_Code UnwindCallback(struct _Unwind_Context *context, void *argument) {
+    UnwindState *state = static_cast<UnwindState *>(argument);
+    uintptr_t address = static_cast<uintptr_t>(_Unwind_GetIP(context));
+    if (address == 0) return _URC_NO_REASON;
+    if (state->count == state->max_frames) return _URC_END_OF_STACK;
+    state->frames[state->count++] = address;
+    return _URC_NO_REASON;
+}
+#endif
+
+// Stores the return addresses of the calling thread's stack, innermost first, and returns how many were stored. Only
+// addresses are captured, which takes a few microseconds; SymbolizeAddress() turns them into names when reporting.
+inline uint32_t CaptureBacktrace(uintptr_t *frames, uint32_t max_frames) {
+#if defined(_WIN32)
+    return RtlCaptureStackBackTrace(0, max_frames, reinterpret_cast<PVOID *>(frames), nullptr);
+#else
+    UnwindState state = {frames, 0, max_frames};
+    _Unwind_Backtrace(UnwindCallback, &state);
+    return state.count;
+#endif
+}
+
+// Hash of the addresses, so identical stacks can share one entry
+inline uint64_t HashBacktrace(const uintptr_t *frames, uint32_t count) {
+    uint64_t hash = kHashSeed;
+    for (uint32_t i = 0; i < count; ++i) hash = Hash(hash, frames[i]);
+    return hash;
+}
+
+// Returns true if the address lies in the module containing this code, that is, in the layer itself
+inline bool IsLayerAddress(uintptr_t address) {
+#if defined(_WIN32)
+    HMODULE module = nullptr, layer = nullptr;
+    DWORD flags = GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT;
+    GetModuleHandleExA(flags, reinterpret_cast<LPCSTR>(address), &module);
+    GetModuleHandleExA(flags, reinterpret_cast<LPCSTR>(&IsLayerAddress), &layer);
+    return module != nullptr && module == layer;
+#else
+    Dl_info info, layer;
+    if (!dladdr(reinterpret_cast<void *>(address), &info) || !dladdr(reinterpret_cast<void *>(&IsLayerAddress), &layer)) {
+        return false;
+    }
+    return info.dli_fbase == layer.dli_fbase;
+#endif
+}
+
+// Describes a captured return address as "function+offset (module)" when the function's symbol is exported, and as
+// "module+offset" otherwise. Symbols are read from the dynamic symbol table only, so no debug information is needed.
+inline std::string SymbolizeAddress(uintptr_t address) {
+    char text[512];
+    // Return addresses point after the call; look up the call instruction itself
+    uintptr_t lookup = address - 1;
+#if defined(_WIN32)
+    HMODULE module = nullptr;
+    char path[MAX_PATH] = "?";
+    if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           reinterpret_cast<LPCSTR>(lookup), &module)) {
+        GetModuleFileNameA(module, path, sizeof(path));
+    }
+    const char *name = strrchr(path, '\\');
+    name = name ? name + 1 : path;
+    snprintf(text, sizeof(text), "%s+0x%llx", name,
+             static_cast<unsigned long long>(address - reinterpret_cast<uintptr_t>(module)));
+    return text;
+#else
+    Dl_info info;
+    if (!dladdr(reinterpret_cast<void *>(lookup), &info)) {
+        snprintf(text, sizeof(text), "0x%llx", static_cast<unsigned long long>(address));
+        return text;
+    }
+    const char *module = info.dli_fname ? info.dli_fname : "?";
+    const char *slash = strrchr(module, '/');
+    if (slash) module = slash + 1;
+    if (!info.dli_sname) {
+        snprintf(text, sizeof(text), "%s+0x%llx", module,
+                 static_cast<unsigned long long>(address - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+        return text;
+    }
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    snprintf(text, sizeof(text), "%s+0x%llx (%s)", status == 0 && demangled ? demangled : info.dli_sname,
+             static_cast<unsigned long long>(address - reinterpret_cast<uintptr_t>(info.dli_saddr)), module);
+    free(demangled);
+    return text;
+#endif
+}
+
+}  // namespace vlf
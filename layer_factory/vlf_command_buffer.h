@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Per-command-buffer storage for interceptors. The layer creates a CommandBufferContext for every command buffer when it
+// is allocated, resets it at vkBeginCommandBuffer, vkResetCommandBuffer and vkResetCommandPool, and destroys it with the
+// command buffer. Vulkan requires the application to synchronize access to a command buffer, so an interceptor may use
+// the context from its vkCmd* hooks without locking.
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "vlf_concurrency.h"
+
+namespace vlf {
+
+// Bump allocator. Memory is released all at once by Reset(), which keeps the blocks for the next recording, so a
+// command buffer that is re-recorded every frame stops allocating after its first frame.
+class Arena {
+   public:
+    explicit Arena(size_t block_size = 4096) : block_size_(block_size), current_block_(0), offset_(0) {}
+    ~Arena() {
+        Reset();
+        for (auto &block : blocks_) free(block.data);
+    }
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        while (current_block_ < blocks_.size()) {
+            Block &block = blocks_[current_block_];
+            size_t offset = (offset_ + alignment - 1) & ~(alignment - 1);
+            if (offset + size <= block.size) {
+                offset_ = offset + size;
+                return block.data + offset;
+            }
+            ++current_block_;
+            offset_ = 0;
+        }
+        // Oversized requests get a block of their own; malloc alignment covers any fundamental alignment
+        Block block = {static_cast<char *>(malloc(std::max(size, block_size_))), std::max(size, block_size_)};
+        if (!block.data) throw std::bad_alloc();
+        blocks_.push_back(block);
+        current_block_ = blocks_.size() - 1;
+        offset_ = size;
+        return block.data;
+    }
+
+    // Constructs a T in the arena. Its destructor, if it has one, runs at Reset().
+    template <typename T, typename... Args>
+    T *New(Args &&... args) {
+        T *object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            destructors_.push_back({object, [](void *pointer) { static_cast<T *>(pointer)->~T(); }});
+        }
+        return object;
+    }
+
+    // Copies count elements into the arena, for keeping application-provided arrays beyond the call that passed them
+    template <typename T>
+    T *Copy(const T *source, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "Arena::Copy requires a trivially copyable type");
+        if (count == 0) return nullptr;
+        T *copy = static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));
+        std::copy(source, source + count, copy);
+        return copy;
+    }
+
+    void Reset() {
+        for (auto it = destructors_.rbegin(); it != destructors_.rend(); ++it) it->destroy(it->object);
+        destructors_.clear();
+        current_block_ = 0;
+        offset_ = 0;
+    }
+
+    // Bytes reserved from the system, including unused space at the end of blocks
+    size_t Capacity() const {
+        size_t capacity = 0;
+        for (const auto &block : blocks_) capacity += block.size;
+        return capacity;
+    }
+
+   private:
+    struct Block {
+        char *data;
+        size_t size;
+    };
+    struct Destructor {
+        void *object;
+        void (*destroy)(void *object);
+    };
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    size_t current_block_;
+    size_t offset_;
+    std::vector<Destructor> destructors_;
+};
+
+// An entry of a recorded command stream. Interceptors that need the parameters of a command keep them in their own
+// State(), indexed by the command's position in the stream.
+struct RecordedCommand {
+    const char *name;
+};
+
+class CommandBufferContext {
+   public:
+    CommandBufferContext(VkDevice device, VkCommandPool pool) : device_(device), pool_(pool), recording_count_(0) {}
+
+    VkDevice Device() const { return device_; }
+    VkCommandPool Pool() const { return pool_; }
+    Arena &GetArena() { return arena_; }
+
+    // The interceptor's own state for this recording, value-initialized in the arena on first use and destroyed when
+    // the command buffer is reset. owner is usually the interceptor's this pointer.
+    template <typename T>
+    T &State(const void *owner) {
+        for (const auto &state : states_) {
+            if (state.first == owner) return *static_cast<T *>(state.second);
+        }
+        T *state = arena_.New<T>();
+        states_.emplace_back(owner, state);
+        return *state;
+    }
+
+    // Commands recorded since the last reset, in order. Only filled in while some interceptor uses the batch hooks.
+    const std::vector<RecordedCommand> &Commands() const { return commands_; }
+    // Position the command currently being intercepted will have in Commands()
+    uint32_t CommandIndex() const { return static_cast<uint32_t>(commands_.size()); }
+    void RecordCommand(const char *name) { commands_.push_back({name}); }
+
+    // Number of times recording has begun on this command buffer
+    uint64_t RecordingCount() const { return recording_count_; }
+
+    void Reset() {
+        states_.clear();
+        commands_.clear();
+        arena_.Reset();
+    }
+
+    void Begin() {
+        Reset();
+        ++recording_count_;
+    }
+
+   private:
+    VkDevice device_;
+    VkCommandPool pool_;
+    uint64_t recording_count_;
+    Arena arena_;
+    std::vector<std::pair<const void *, void *>> states_;
+    std::vector<RecordedCommand> commands_;
+};
+
+// The layer's contexts for all command buffers. Lookups on the recording thread hit a per-thread cache of the last
+// command buffer used, so a run of vkCmd* calls does not touch the shared map.
+class CommandBufferContextMap {
+   public:
+    CommandBufferContextMap() : epoch_(0) {}
+    ~CommandBufferContextMap() {
+        contexts_.ForEach([](VkCommandBuffer, CommandBufferContext *const &context) { delete context; });
+    }
+
+    CommandBufferContext *Get(VkCommandBuffer command_buffer) {
+        struct CachedContext {
+            const CommandBufferContextMap *map;
+            VkCommandBuffer command_buffer;
+            uint64_t epoch;
+            CommandBufferContext *context;
+        };
+        static thread_local CachedContext cache = {nullptr, VK_NULL_HANDLE, 0, nullptr};
+        uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        if (cache.map == this && cache.command_buffer == command_buffer && cache.epoch == epoch) return cache.context;
+        CommandBufferContext *context = nullptr;
+        if (!contexts_.Find(command_buffer, &context)) return nullptr;
+        cache = {this, command_buffer, epoch, context};
+        return context;
+    }
+
+    void Allocate(VkDevice device, VkCommandPool pool, uint32_t count, const VkCommandBuffer *command_buffers) {
+        for (uint32_t i = 0; i < count; ++i) {
+            CommandBufferContext *previous = nullptr;
+            if (contexts_.Erase(command_buffers[i], &previous)) {
+                delete previous;
+                Invalidate();
+            }
+            contexts_.Insert(command_buffers[i], new CommandBufferContext(device, pool));
+        }
+    }
+
+    void Free(uint32_t count, const VkCommandBuffer *command_buffers) {
+        for (uint32_t i = 0; i < count; ++i) {
+            CommandBufferContext *context = nullptr;
+            if (command_buffers[i] != VK_NULL_HANDLE && contexts_.Erase(command_buffers[i], &context)) delete context;
+        }
+        Invalidate();
+    }
+
+    CommandBufferContext *Begin(VkCommandBuffer command_buffer) {
+        CommandBufferContext *context = Get(command_buffer);
+        if (context) context->Begin();
+        return context;
+    }
+
+    void Reset(VkCommandBuffer command_buffer) {
+        CommandBufferContext *context = Get(command_buffer);
+        if (context) context->Reset();
+    }
+
+    void ResetPool(VkCommandPool pool) {
+        contexts_.ForEach([pool](VkCommandBuffer, CommandBufferContext *const &context) {
+            if (context->Pool() == pool) context->Reset();
+        });
+    }
+
+    void DestroyPool(VkCommandPool pool) {
+        contexts_.EraseIf([pool](VkCommandBuffer, CommandBufferContext *const &context) {
+            if (context->Pool() != pool) return false;
+            delete context;
+            return true;
+        });
+        Invalidate();
+    }
+
+    void DestroyDevice(VkDevice device) {
+        contexts_.EraseIf([device](VkCommandBuffer, CommandBufferContext *const &context) {
+            if (context->Device() != device) return false;
+            delete context;
+            return true;
+        });
+        Invalidate();
+    }
+
+   private:
+    // Per-thread caches may hold a context that is about to be deleted or a handle value that will be reused
+    void Invalidate() { epoch_.fetch_add(1, std::memory_order_release); }
+
+    ConcurrentHandleMap<VkCommandBuffer, CommandBufferContext *> contexts_;
+    std::atomic<uint64_t> epoch_;
+};
+
+}  // namespace vlf
@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Thread-safe containers for interceptor state. Intercepted functions are called on whatever thread the application
+// uses, so interceptor members that are touched from Pre/PostCall hooks must tolerate concurrent access. The layer's
+// global_lock only serializes instance and device creation and destruction.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vlf {
+
+// Size used to keep independently updated data on separate cache lines
+static const size_t kCacheLineSize = 64;
+
+// Small per-thread index, assigned on first use. Used to spread threads over striped data.
+inline uint32_t CurrentThreadIndex() {
+    static std::atomic<uint32_t> next_thread_index(0);
+    static thread_local uint32_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+    return thread_index;
+}
+
+// Map from Vulkan handles (or any hashable key) to values, split into independently locked shards so that threads
+// working on different objects rarely contend.
+template <typename Key, typename Value, size_t ShardCount = 16>
+class ConcurrentHandleMap {
+   public:
+    // Inserts value for key, replacing any previous value
+    void Insert(const Key &key, const Value &value) {
+        Shard &shard = GetShard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        shard.map[key] = value;
+    }
+
+    // Copies the value for key into *value. Returns false if the key is not present.
+    bool Find(const Key &key, Value *value) const {
+        const Shard &shard = GetShard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        *value = it->second;
+        return true;
+    }
+
+    // Removes key, copying its value into *value if requested. Returns false if the key is not present.
+    bool Erase(const Key &key, Value *value = nullptr) {
+        Shard &shard = GetShard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        if (value) *value = it->second;
+        shard.map.erase(it);
+        return true;
+    }
+
+    // Calls update on the value for key while its shard is locked, default-constructing the value if it is missing
+    void Update(const Key &key, const std::function<void(Value &)> &update) {
+        Shard &shard = GetShard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        update(shard.map[key]);
+    }
+
+    // Calls update on the value for key while its shard is locked. Returns false if the key is not present.
+    bool UpdateExisting(const Key &key, const std::function<void(Value &)> &update) {
+        Shard &shard = GetShard(key);
+        std::lock_guard<std::mutex> lock(shard.lock);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        update(it->second);
+        return true;
+    }
+
+    // Visits every entry, locking one shard at a time. The callback must not access this map.
+    void ForEach(const std::function<void(const Key &, const Value &)> &visit) const {
+        for (const Shard &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            for (const auto &entry : shard.map) visit(entry.first, entry.second);
+        }
+    }
+
+    // Removes every entry for which remove returns true, locking one shard at a time
+    void EraseIf(const std::function<bool(const Key &, const Value &)> &remove) {
+        for (Shard &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            for (auto it = shard.map.begin(); it != shard.map.end();) {
+                if (remove(it->first, it->second)) {
+                    it = shard.map.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    size_t Size() const {
+        size_t size = 0;
+        for (const Shard &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            size += shard.map.size();
+        }
+        return size;
+    }
+
+    void Clear() {
+        for (Shard &shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            shard.map.clear();
+        }
+    }
+
+   private:
+    struct alignas(kCacheLineSize) Shard {
+        mutable std::mutex lock;
+        std::unordered_map<Key, Value> map;
+    };
+
+    Shard &GetShard(const Key &key) { return shards_[ShardIndex(key)]; }
+    const Shard &GetShard(const Key &key) const { return shards_[ShardIndex(key)]; }
+
+    static size_t ShardIndex(const Key &key) {
+        // Handles are often aligned pointers, so fold the high bits down before picking a shard
+        uint64_t hash = static_cast<uint64_t>(std::hash<Key>()(key));
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return static_cast<size_t>(hash % ShardCount);
+    }
+
+    Shard shards_[ShardCount];
+};
+
+// Insert-only map for values that never change once known, such as the results of idempotent queries. Lookups and
+// inserts are lock-free. Clear() frees the entries it removes once every lookup and insert that could still see them
+// has finished, so it waits for those but not for later ones. A key that cannot be placed within kMaxProbes slots is
+// not stored.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, size_t SlotCountLog2 = 12>
+class ConcurrentMemoTable {
+   public:
+    ConcurrentMemoTable() : epoch_(0) {
+        for (auto &slot : slots_) slot.store(nullptr, std::memory_order_relaxed);
+        for (auto &stripe : reader_stripes_) {
+            for (auto &count : stripe.count) count.store(0, std::memory_order_relaxed);
+        }
+    }
+    ~ConcurrentMemoTable() {
+        for (auto &slot : slots_) delete slot.load(std::memory_order_acquire);
+    }
+    ConcurrentMemoTable(const ConcurrentMemoTable &) = delete;
+    ConcurrentMemoTable &operator=(const ConcurrentMemoTable &) = delete;
+
+    // Copies the stored value for key into *value. Returns false if the key is not present.
+    bool Find(const Key &key, Value *value) const {
+        ReadGuard guard(*this);
+        size_t index = SlotIndex(key);
+        for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+            const Entry *entry = slots_[(index + probe) & kSlotMask].load(std::memory_order_acquire);
+            if (entry == nullptr) return false;
+            if (entry->key == key) {
+                *value = entry->value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Stores value for key unless the key is already present, in which case the first value stored is kept
+    void Insert(const Key &key, const Value &value) {
+        ReadGuard guard(*this);
+        Entry *new_entry = nullptr;
+        size_t index = SlotIndex(key);
+        for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+            std::atomic<Entry *> &slot = slots_[(index + probe) & kSlotMask];
+            Entry *entry = slot.load(std::memory_order_acquire);
+            if (entry == nullptr) {
+                if (new_entry == nullptr) new_entry = new Entry{key, value};
+                if (slot.compare_exchange_strong(entry, new_entry, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    return;
+                }
+            }
+            if (entry->key == key) break;
+        }
+        // The entry was never published, so no other thread can hold it
+        delete new_entry;
+    }
+
+    // Empties the table and frees its entries, after waiting for the lookups and inserts already running
+    void Clear() {
+        std::lock_guard<std::mutex> lock(clear_lock_);
+        std::vector<Entry *> removed;
+        for (auto &slot : slots_) {
+            Entry *entry = slot.exchange(nullptr, std::memory_order_seq_cst);
+            if (entry) removed.push_back(entry);
+        }
+        // Readers that start after the flip can only see the emptied slots. Those counted under the old epoch may still
+        // be using a removed entry.
+        const uint32_t old_epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) & 1;
+        while (ReaderCount(old_epoch) != 0) std::this_thread::yield();
+        for (Entry *entry : removed) delete entry;
+    }
+
+   private:
+    static const size_t kSlotCount = size_t(1) << SlotCountLog2;
+    static const size_t kSlotMask = kSlotCount - 1;
+    static const size_t kMaxProbes = 32;
+    static const size_t kReaderStripeCount = 16;
+
+    struct Entry {
+        Key key;
+        Value value;
+    };
+
+    // Number of lookups and inserts running in each of the last two epochs, striped by thread like PerThreadCounter
+    struct alignas(kCacheLineSize) ReaderStripe {
+        std::atomic<uint32_t> count[2];
+    };
+
+    // Counts a lookup or insert against the current epoch for as long as it runs. The epoch is checked again after
+    // counting, so a reader that raced with Clear() flipping it counts against the new epoch instead.
+    class ReadGuard {
+       public:
+        explicit ReadGuard(const ConcurrentMemoTable &table) {
+            ReaderStripe &stripe = table.reader_stripes_[CurrentThreadIndex() % kReaderStripeCount];
+            for (;;) {
+                uint32_t epoch = table.epoch_.load(std::memory_order_seq_cst);
+                count_ = &stripe.count[epoch & 1];
+                count_->fetch_add(1, std::memory_order_seq_cst);
+                if (table.epoch_.load(std::memory_order_seq_cst) == epoch) return;
+                count_->fetch_sub(1, std::memory_order_release);
+            }
+        }
+        ~ReadGuard() { count_->fetch_sub(1, std::memory_order_release); }
+
+       private:
+        std::atomic<uint32_t> *count_;
+    };
+
+    uint32_t ReaderCount(uint32_t epoch) const {
+        uint32_t count = 0;
+        for (const auto &stripe : reader_stripes_) count += stripe.count[epoch].load(std::memory_order_seq_cst);
+        return count;
+    }
+
+    static size_t SlotIndex(const Key &key) {
+        uint64_t hash = static_cast<uint64_t>(Hash()(key));
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return static_cast<size_t>(hash) & kSlotMask;
+    }
+
+    std::atomic<Entry *> slots_[kSlotCount];
+    std::atomic<uint32_t> epoch_;
+    mutable ReaderStripe reader_stripes_[kReaderStripeCount];
+    std::mutex clear_lock_;
+};
+
+// Counter that threads update without contention. Each thread adds into its own cache line; reading the total
+// aggregates all of them, so Sum() is more expensive than Add() and is meant for periodic reporting.
+template <size_t StripeCount = 16>
+class PerThreadCounter {
+   public:
+    PerThreadCounter() {
+        for (Stripe &stripe : stripes_) stripe.value.store(0, std::memory_order_relaxed);
+    }
+
+    void Add(int64_t delta) {
+        stripes_[CurrentThreadIndex() % StripeCount].value.fetch_add(delta, std::memory_order_relaxed);
+    }
+    void Increment() { Add(1); }
+    void Decrement() { Add(-1); }
+
+    int64_t Sum() const {
+        int64_t sum = 0;
+        for (const Stripe &stripe : stripes_) sum += stripe.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Returns the current total and resets the counter, for per-interval statistics
+    int64_t Exchange() {
+        int64_t sum = 0;
+        for (Stripe &stripe : stripes_) sum += stripe.value.exchange(0, std::memory_order_relaxed);
+        return sum;
+    }
+
+   private:
+    struct alignas(kCacheLineSize) Stripe {
+        std::atomic<int64_t> value;
+    };
+    Stripe stripes_[StripeCount];
+};
+
+// Lock-free count, sum, minimum and maximum of a series of samples, such as sizes or durations
+class StatisticsAccumulator {
+   public:
+    StatisticsAccumulator() { Reset(); }
+
+    void Record(uint64_t sample) {
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(sample, std::memory_order_relaxed);
+        uint64_t current = min_.load(std::memory_order_relaxed);
+        while (sample < current && !min_.compare_exchange_weak(current, sample, std::memory_order_relaxed)) {
+        }
+        current = max_.load(std::memory_order_relaxed);
+        while (sample > current && !max_.compare_exchange_weak(current, sample, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t Min() const { return Count() ? min_.load(std::memory_order_relaxed) : 0; }
+    uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+    double Mean() const {
+        uint64_t count = Count();
+        return count ? static_cast<double>(Sum()) / count : 0.0;
+    }
+
+    // Not atomic with respect to concurrent Record() calls; a sample racing with a reset may be partially counted
+    void Reset() {
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+   private:
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+// Running maximum of a value that goes up and down, such as bytes currently allocated
+class HighWaterMark {
+   public:
+    HighWaterMark() : current_(0), peak_(0) {}
+
+    void Add(int64_t delta) {
+        int64_t value = current_.fetch_add(delta, std::memory_order_relaxed) + delta;
+        int64_t peak = peak_.load(std::memory_order_relaxed);
+        while (value > peak && !peak_.compare_exchange_weak(peak, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    int64_t Current() const { return current_.load(std::memory_order_relaxed); }
+    int64_t Peak() const { return peak_.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<int64_t> current_;
+    std::atomic<int64_t> peak_;
+};
+
+}  // namespace vlf
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Hashing helpers for interceptors that identify call sites or state by value. The hashes are FNV-1a, so they are the
+// same in every run and can be compared between reports.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vlf {
+
+// FNV-1a offset basis, the starting value of every hash
+static const uint64_t kHashSeed = 14695981039346656037ull;
+
+// Mixes the eight bytes of value into hash
+inline uint64_t Hash(uint64_t hash, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Mixes several values into hash, in order
+template <typename... Values>
+inline uint64_t Hash(uint64_t hash, uint64_t value, uint64_t next, Values... values) {
+    return Hash(Hash(hash, value), next, values...);
+}
+
+inline uint64_t HashBytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Value of a dispatchable (pointer) or non-dispatchable (64-bit integer on 32-bit platforms) handle, for hashing and
+// printing
+template <typename T>
+inline uint64_t HandleValue(T *handle) {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+}
+inline uint64_t HandleValue(uint64_t handle) { return handle; }
+
+}  // namespace vlf
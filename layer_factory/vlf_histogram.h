@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace vlf {
+
+// Monotonic timestamp in nanoseconds, for measuring the duration of intercepted calls
+inline uint64_t NowNanoseconds() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Histogram with power-of-two buckets, each split into 8 linear sub-buckets, so any recorded value is known to within
+// 12.5%. Values above 2^41 (about 36 minutes in nanoseconds) land in the last bucket.
+//
+// Record() may be called by one thread while other threads read; readers see a consistent-enough snapshot for
+// reporting. Histograms that several threads record into need one instance per thread, combined with Merge().
+class LogLinearHistogram {
+   public:
+    static const uint32_t kSubBucketBits = 3;
+    static const uint32_t kSubBucketCount = 1 << kSubBucketBits;
+    static const uint32_t kMaxExponent = 40;
+    static const uint32_t kBucketCount = (kMaxExponent - kSubBucketBits + 2) * kSubBucketCount;
+
+    LogLinearHistogram() {
+        for (auto &bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    void Record(uint64_t value) {
+        Increment(buckets_[BucketIndex(value)], 1);
+        Increment(count_, 1);
+        Increment(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed)) max_.store(value, std::memory_order_relaxed);
+    }
+
+    // Adds the samples of other into this histogram. Only this histogram's writer may call Merge().
+    void Merge(const LogLinearHistogram &other) {
+        for (uint32_t i = 0; i < kBucketCount; ++i) Increment(buckets_[i], other.buckets_[i].load(std::memory_order_relaxed));
+        Increment(count_, other.Count());
+        Increment(sum_, other.Sum());
+        if (other.Max() > Max()) max_.store(other.Max(), std::memory_order_relaxed);
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+    double Mean() const { return Count() ? static_cast<double>(Sum()) / Count() : 0.0; }
+
+    // Approximate value below which the given fraction (0.0 - 1.0) of samples fall, reported as the bucket midpoint
+    uint64_t Percentile(double fraction) const {
+        uint64_t count = Count();
+        if (count == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(fraction * count);
+        if (rank >= count) rank = count - 1;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < kBucketCount; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen > rank) return BucketLowerBound(i) + BucketWidth(i) / 2;
+        }
+        return Max();
+    }
+
+    static uint32_t BucketIndex(uint64_t value) {
+        if (value < kSubBucketCount) return static_cast<uint32_t>(value);
+        const uint64_t max_value = (uint64_t(1) << (kMaxExponent + 1)) - 1;
+        if (value > max_value) value = max_value;
+        uint32_t exponent = HighestBit(value);
+        uint32_t shift = exponent - kSubBucketBits;
+        return (shift + 1) * kSubBucketCount + static_cast<uint32_t>((value >> shift) & (kSubBucketCount - 1));
+    }
+
+    static uint64_t BucketLowerBound(uint32_t index) {
+        uint32_t group = index / kSubBucketCount;
+        if (group == 0) return index;
+        return static_cast<uint64_t>(kSubBucketCount + index % kSubBucketCount) << (group - 1);
+    }
+
+    static uint64_t BucketWidth(uint32_t index) {
+        uint32_t group = index / kSubBucketCount;
+        return group == 0 ? 1 : uint64_t(1) << (group - 1);
+    }
+
+   private:
+    // Single-writer increment: a load and store is cheaper than an atomic read-modify-write
+    static void Increment(std::atomic<uint64_t> &value, uint64_t delta) {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static uint32_t HighestBit(uint64_t value) {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32))) return index + 32;
+        _BitScanReverse(&index, static_cast<unsigned long>(value));
+        return index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    std::atomic<uint64_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+}  // namespace vlf
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The interceptors each hook point dispatches to. Intercept functions read the current table with a single atomic load
+// and no lock, so enabling or disabling an interceptor at runtime costs the calls it is not enabled for nothing.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace vlf {
+
+// Immutable snapshot of the interceptors enabled for each of kHookCount hook points, kept in one array with per-hook
+// offsets so a dispatch touches one or two cache lines
+template <typename Interceptor, uint32_t kHookCount>
+class InterceptorTable {
+   public:
+    class Range {
+       public:
+        Range(Interceptor *const *begin, Interceptor *const *end) : begin_(begin), end_(end) {}
+        Interceptor *const *begin() const { return begin_; }
+        Interceptor *const *end() const { return end_; }
+
+       private:
+        Interceptor *const *begin_;
+        Interceptor *const *end_;
+    };
+
+    InterceptorTable() {
+        for (auto &offset : offsets_) offset = 0;
+    }
+
+    // Keeps the registered interceptors of each hook, in registration order, for which enabled() returns true
+    InterceptorTable(const std::vector<Interceptor *> (&registered)[kHookCount],
+                     const std::function<bool(const Interceptor *)> &enabled) {
+        for (uint32_t hook = 0; hook < kHookCount; ++hook) {
+            offsets_[hook] = static_cast<uint32_t>(interceptors_.size());
+            for (auto interceptor : registered[hook]) {
+                if (enabled(interceptor)) interceptors_.push_back(interceptor);
+            }
+        }
+        offsets_[kHookCount] = static_cast<uint32_t>(interceptors_.size());
+    }
+
+    Range operator[](uint32_t hook) const {
+        return Range(interceptors_.data() + offsets_[hook], interceptors_.data() + offsets_[hook + 1]);
+    }
+    bool Empty(uint32_t hook) const { return offsets_[hook] == offsets_[hook + 1]; }
+
+   private:
+    std::vector<Interceptor *> interceptors_;
+    uint32_t offsets_[kHookCount + 1];
+};
+
+// Holds the current table. Get() never blocks; Publish() replaces the table for calls that start afterwards. A call in
+// progress may still be using the table it loaded, so replaced tables are kept until the holder is destroyed. Tables
+// only change when an interceptor is enabled or disabled, which keeps what they hold to a few kilobytes per change.
+template <typename Table>
+class PublishedTable {
+   public:
+    PublishedTable() : current_(&empty_) {}
+    PublishedTable(const PublishedTable &) = delete;
+    PublishedTable &operator=(const PublishedTable &) = delete;
+
+    const Table &Get() const { return *current_.load(std::memory_order_acquire); }
+
+    void Publish(std::unique_ptr<Table> table) {
+        std::lock_guard<std::mutex> lock(lock_);
+        current_.store(table.get(), std::memory_order_release);
+        published_.push_back(std::move(table));
+    }
+
+   private:
+    const Table empty_;
+    std::atomic<const Table *> current_;
+    std::mutex lock_;
+    std::vector<std::unique_ptr<Table>> published_;
+};
+
+}  // namespace vlf
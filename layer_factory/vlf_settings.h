@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Settings lookup for factory layers. A setting "<layer identifier>.<name>" is read from vk_layer_settings.txt, and an
+// environment variable VK_<LAYER IDENTIFIER>_<NAME> in upper case takes priority, e.g. for the latency_profiler layer
+// "lunarg_latency_profiler.report_frames" and VK_LUNARG_LATENCY_PROFILER_REPORT_FRAMES.
+//
+// Interceptors are constructed during the layer library's static initialization, before the settings file can be
+// relied on, so factory layers read their settings from PostCallCreateInstance rather than from their constructors.
+
+#pragma once
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+#include "vk_layer_config.h"
+
+namespace vlf {
+
+inline std::string GetLayerSetting(const char *layer_identifier, const char *name, const std::string &default_value) {
+    std::string setting = std::string(layer_identifier) + "." + name;
+#if !defined(__ANDROID__)
+    std::string envar = std::string("VK_") + layer_identifier + "_" + name;
+    for (auto &c : envar) c = static_cast<char>(toupper(c));
+    const char *envar_value = getenv(envar.c_str());
+    if (envar_value && *envar_value) return envar_value;
+#endif
+    const char *value = getLayerOption(setting.c_str());
+    if (value && *value) return value;
+    return default_value;
+}
+
+inline uint64_t GetLayerSettingUint(const char *layer_identifier, const char *name, uint64_t default_value) {
+    std::string value = GetLayerSetting(layer_identifier, name, "");
+    if (value.empty()) return default_value;
+    return strtoull(value.c_str(), nullptr, 0);
+}
+
+inline bool ParseSettingBool(std::string value, bool default_value) {
+    if (value.empty()) return default_value;
+    for (auto &c : value) c = static_cast<char>(tolower(c));
+    return value == "true" || value == "1" || value == "on";
+}
+
+inline bool GetLayerSettingBool(const char *layer_identifier, const char *name, bool default_value) {
+    return ParseSettingBool(GetLayerSetting(layer_identifier, name, ""), default_value);
+}
+
+// Settings by full name, e.g. "lunarg_latency_profiler.report_frames"
+typedef std::map<std::string, std::string> SettingsMap;
+
+// Parses text in the vk_layer_settings.txt format: one "name = value" per line, '#' starting a comment
+inline SettingsMap ParseSettings(const std::string &text) {
+    static const char *const kSpace = " \t\r";
+    SettingsMap settings;
+    size_t line_start = 0;
+    while (line_start < text.size()) {
+        size_t line_end = text.find('\n', line_start);
+        if (line_end == std::string::npos) line_end = text.size();
+        std::string line = text.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+        line = line.substr(0, line.find('#'));
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) continue;
+        std::string name = line.substr(0, equals), value = line.substr(equals + 1);
+        name.erase(name.find_last_not_of(kSpace) + 1);
+        name.erase(0, name.find_first_not_of(kSpace));
+        value.erase(value.find_last_not_of(kSpace) + 1);
+        value.erase(0, value.find_first_not_of(kSpace));
+        if (!name.empty()) settings[name] = value;
+    }
+    return settings;
+}
+
+// Reads a whole file, returning false if it cannot be opened
+inline bool ReadFileText(const std::string &path, std::string *text) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    text->clear();
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) != 0) text->append(buffer, size);
+    fclose(file);
+    return true;
+}
+
+}  // namespace vlf
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2015-2020 Valve Corporation
+ * Copyright (c) 2015-2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Watches a settings file so layer behavior can be changed while the application runs. A background thread rereads the
+// file a few times a second and passes its settings to a callback whenever the contents change; the file is small, so
+// comparing contents is cheaper than relying on modification times, which some file systems only keep to the second.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "vlf_settings.h"
+
+namespace vlf {
+
+class SettingsWatcher {
+   public:
+    typedef std::function<void(const SettingsMap &settings)> Callback;
+
+    static SettingsWatcher &Get() {
+        static SettingsWatcher settings_watcher;
+        return settings_watcher;
+    }
+
+    // Reads path and calls callback before returning, then watches it from a background thread. A missing file has no
+    // settings. Calling Start() again while watching has no effect.
+    void Start(const std::string &path, const Callback &callback) {
+        std::lock_guard<std::mutex> lock(control_lock_);
+        if (watcher_.joinable()) return;
+        path_ = path;
+        callback_ = callback;
+        first_read_ = true;
+        stop_ = false;
+        Poll();
+        watcher_ = std::thread(&SettingsWatcher::WatchLoop, this);
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> lock(control_lock_);
+        if (!watcher_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> wake_lock(wake_lock_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        watcher_.join();
+    }
+
+    ~SettingsWatcher() {
+#if defined(_WIN32)
+        // Other threads are already gone when a DLL's static destructors run at process exit, so joining could hang
+        if (watcher_.joinable()) watcher_.detach();
+#else
+        Stop();
+#endif
+    }
+
+   private:
+    SettingsWatcher() : first_read_(true), stop_(false) {}
+
+    void WatchLoop() {
+        const std::chrono::milliseconds poll_period(250);
+        std::unique_lock<std::mutex> lock(wake_lock_);
+        while (!stop_) {
+            wake_.wait_for(lock, poll_period);
+            if (stop_) break;
+            lock.unlock();
+            Poll();
+            lock.lock();
+        }
+    }
+
+    // Only called from Start() before the thread exists, and from the thread
+    void Poll() {
+        std::string contents;
+        if (!ReadFileText(path_, &contents)) contents.clear();
+        if (!first_read_ && contents == contents_) return;
+        first_read_ = false;
+        contents_ = contents;
+        callback_(ParseSettings(contents_));
+    }
+
+    std::mutex control_lock_;
+    std::string path_;
+    Callback callback_;
+    std::string contents_;
+    bool first_read_;
+
+    std::thread watcher_;
+    std::mutex wake_lock_;
+    std::condition_variable wake_;
+    bool stop_;
+};
+
+}  // namespace vlf
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <mutex>
 #include <unordered_map>
 #include <vk_dispatch_table_helper.h>
 #include <vulkan/vk_layer.h>
@@ -44,6 +45,15 @@ struct layer_data {
     VkLayerInstanceDispatchTable *instance_dispatch_table;
 
     PFN_vkQueuePresentKHR pfnQueuePresentKHR;
+
+    VkPhysicalDevice gpu;
+    VkDevice device;
+
+    PFN_vkSetDeviceLoaderData pfn_dev_init;
+};
+
+// Window a surface was created for, captured at surface creation so each swapchain can title its own window
+struct surface_data {
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
     HWND hwnd;
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
@@ -52,11 +62,12 @@ struct layer_data {
     bool xcb_fps;
 #endif
     char base_title[TITLE_LENGTH];
+};
 
-    VkPhysicalDevice gpu;
+// Frame rate statistics, tracked separately for every swapchain so multi-window apps report each window on its own
+struct swapchain_data {
     VkDevice device;
-
-    PFN_vkSetDeviceLoaderData pfn_dev_init;
+    VkSurfaceKHR surface;
     int lastFrame;
     time_t lastTime;
     float fps;
@@ -77,6 +88,11 @@ static struct {
 
 static std::unordered_map<void *, layer_data *> layer_data_map;
 
+// Surfaces and swapchains may be created, destroyed and presented from any thread
+static std::mutex swapchain_lock;
+static std::unordered_map<VkSurfaceKHR, surface_data> surface_map;
+static std::unordered_map<VkSwapchainKHR, swapchain_data> swapchain_map;
+
 template layer_data *GetLayerDataPtr<layer_data>(void *data_key, std::unordered_map<void *, layer_data *> &data_map);
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice gpu, const VkDeviceCreateInfo *pCreateInfo,
@@ -115,10 +131,6 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice g
 
     my_device_data->gpu = gpu;
     my_device_data->device = *pDevice;
-    my_device_data->frame = 0;
-    my_device_data->lastFrame = 0;
-    my_device_data->fps = 0.0;
-    time(&my_device_data->lastTime);
 
     // Get our WSI hooks in
     VkLayerDispatchTable *pTable = my_device_data->device_dispatch_table;
@@ -135,6 +147,16 @@ VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, cons
     pTable->DestroyDevice(device, pAllocator);
     delete pTable;
     layer_data_map.erase(key);
+
+    // Drop statistics for any swapchains the application did not destroy before the device
+    std::lock_guard<std::mutex> lock(swapchain_lock);
+    for (auto it = swapchain_map.begin(); it != swapchain_map.end();) {
+        if (it->second.device == device) {
+            it = swapchain_map.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo *pCreateInfo,
@@ -194,34 +216,79 @@ VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance
     layer_data_map.erase(key);
 }
 
-VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *pCreateInfo,
+                                                                    const VkAllocationCallbacks *pAllocator,
+                                                                    VkSwapchainKHR *pSwapchain) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    VkResult result = my_data->device_dispatch_table->CreateSwapchainKHR(device, pCreateInfo, pAllocator, pSwapchain);
+    if (result != VK_SUCCESS) return result;
+
+    swapchain_data swapchain = {};
+    swapchain.device = device;
+    swapchain.surface = pCreateInfo->surface;
+    time(&swapchain.lastTime);
+
+    std::lock_guard<std::mutex> lock(swapchain_lock);
+    swapchain_map[*pSwapchain] = swapchain;
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain,
+                                                                 const VkAllocationCallbacks *pAllocator) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    {
+        std::lock_guard<std::mutex> lock(swapchain_lock);
+        swapchain_map.erase(swapchain);
+    }
+    my_data->device_dispatch_table->DestroySwapchainKHR(device, swapchain, pAllocator);
+}
 
+// Updates the frame counter of one swapchain and, every half second, writes its frame rate to the title of its window.
+// Must be called with swapchain_lock held.
+static void UpdateSwapchainFps(swapchain_data &swapchain) {
     time_t now;
     time(&now);
-    float seconds = (float)difftime(now, my_data->lastTime);
+    float seconds = (float)difftime(now, swapchain.lastTime);
 
     if (seconds > 0.5) {
-        char str[TITLE_LENGTH + FPS_LENGTH];
-        char fpsstr[FPS_LENGTH];
-        layer_data *my_instance_data = GetLayerDataPtr(get_dispatch_key(my_data->gpu), layer_data_map);
-        my_data->fps = (my_data->frame - my_data->lastFrame) / seconds;
-        my_data->lastFrame = my_data->frame;
-        my_data->lastTime = now;
-        sprintf(fpsstr, "   FPS = %.2f", my_data->fps);
-        strcpy(str, my_instance_data->base_title);
-        strcat(str, fpsstr);
+        swapchain.fps = (swapchain.frame - swapchain.lastFrame) / seconds;
+        swapchain.lastFrame = swapchain.frame;
+        swapchain.lastTime = now;
+
+        auto surface = surface_map.find(swapchain.surface);
+        if (surface != surface_map.end()) {
+            char str[TITLE_LENGTH + FPS_LENGTH];
+            char fpsstr[FPS_LENGTH];
+            surface_data &window = surface->second;
+            snprintf(fpsstr, FPS_LENGTH, "   FPS = %.2f", swapchain.fps);
+            strcpy(str, window.base_title);
+            strcat(str, fpsstr);
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
-        SetWindowText(my_instance_data->hwnd, str);
+            SetWindowText(window.hwnd, str);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-        if (xcb.xcbLib && my_instance_data->xcb_fps) {
-            xcb.change_property(my_instance_data->connection, XCB_PROP_MODE_REPLACE, my_instance_data->xcb_window, XCB_ATOM_WM_NAME,
-                                XCB_ATOM_STRING, 8, strlen(str), str);
-            xcb.flush(my_instance_data->connection);
-        }
+            if (xcb.xcbLib && window.xcb_fps) {
+                xcb.change_property(window.connection, XCB_PROP_MODE_REPLACE, window.xcb_window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING,
+                                    8, strlen(str), str);
+                xcb.flush(window.connection);
+            }
 #endif
+        }
+    }
+    swapchain.frame++;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+
+    {
+        std::lock_guard<std::mutex> lock(swapchain_lock);
+        for (uint32_t i = 0; i < pPresentInfo->swapchainCount; ++i) {
+            auto swapchain = swapchain_map.find(pPresentInfo->pSwapchains[i]);
+            if (swapchain != swapchain_map.end()) {
+                UpdateSwapchainFps(swapchain->second);
+            }
+        }
     }
-    my_data->frame++;
 
     VkResult result = my_data->pfnQueuePresentKHR(queue, pPresentInfo);
     return result;
@@ -258,16 +325,31 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceToolProperties
     return result;
 }
 
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroySurfaceKHR(VkInstance instance, VkSurfaceKHR surface,
+                                                               const VkAllocationCallbacks *pAllocator) {
+    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(instance), layer_data_map);
+    {
+        std::lock_guard<std::mutex> lock(swapchain_lock);
+        surface_map.erase(surface);
+    }
+    my_data->instance_dispatch_table->DestroySurfaceKHR(instance, surface, pAllocator);
+}
+
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateWin32SurfaceKHR(VkInstance instance,
                                                                        const VkWin32SurfaceCreateInfoKHR *pCreateInfo,
                                                                        const VkAllocationCallbacks *pAllocator,
                                                                        VkSurfaceKHR *pSurface) {
     layer_data *my_data = GetLayerDataPtr(get_dispatch_key(instance), layer_data_map);
-    my_data->hwnd = pCreateInfo->hwnd;
-    GetWindowText(my_data->hwnd, my_data->base_title, TITLE_LENGTH);
-
     VkResult result = my_data->instance_dispatch_table->CreateWin32SurfaceKHR(instance, pCreateInfo, pAllocator, pSurface);
+    if (result != VK_SUCCESS) return result;
+
+    surface_data window = {};
+    window.hwnd = pCreateInfo->hwnd;
+    GetWindowText(window.hwnd, window.base_title, TITLE_LENGTH);
+
+    std::lock_guard<std::mutex> lock(swapchain_lock);
+    surface_map[*pSurface] = window;
     return result;
 }
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
@@ -282,30 +364,37 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateXcbSurfaceKHR(VkInstance
     xcb_atom_t type = XCB_ATOM_STRING;
 
     layer_data *my_data = GetLayerDataPtr(get_dispatch_key(instance), layer_data_map);
+    VkResult result = my_data->instance_dispatch_table->CreateXcbSurfaceKHR(instance, pCreateInfo, pAllocator, pSurface);
+    if (result != VK_SUCCESS) return result;
 
     if (!xcb.xcbLib and !xcbErrorPrinted) {
         fprintf(stderr, "Monitor layer libxcb.so load failure, will not be able to display frame rate\n");
         xcbErrorPrinted = true;
     }
+
+    surface_data window = {};
     if (xcb.xcbLib) {
-        my_data->xcb_window = pCreateInfo->window;
-        my_data->connection = pCreateInfo->connection;
-        cookie = xcb.get_property(my_data->connection, 0, my_data->xcb_window, property, type, 0, 0);
-        if ((reply = xcb.get_property_reply(my_data->connection, cookie, NULL))) {
-            my_data->xcb_fps = true;
+        window.xcb_window = pCreateInfo->window;
+        window.connection = pCreateInfo->connection;
+        cookie = xcb.get_property(window.connection, 0, window.xcb_window, property, type, 0, 0);
+        if ((reply = xcb.get_property_reply(window.connection, cookie, NULL))) {
+            window.xcb_fps = true;
             int len = xcb.get_property_value_length(reply);
-            if (len > TITLE_LENGTH) {
-                my_data->xcb_fps = false;
+            if (len >= TITLE_LENGTH) {
+                window.xcb_fps = false;
             } else if (len > 0) {
-                strcpy(my_data->base_title, (char *)xcb.get_property_value(reply));
+                memcpy(window.base_title, xcb.get_property_value(reply), len);
+                window.base_title[len] = 0;
             } else {
                 // No window title - make base title null string
-                my_data->base_title[0] = 0;
+                window.base_title[0] = 0;
             }
+            free(reply);
         }
     }
 
-    VkResult result = my_data->instance_dispatch_table->CreateXcbSurfaceKHR(instance, pCreateInfo, pAllocator, pSurface);
+    std::lock_guard<std::mutex> lock(swapchain_lock);
+    surface_map[*pSurface] = window;
     return result;
 }
 #endif
@@ -316,6 +405,8 @@ VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkD
 
     ADD_HOOK(vkGetDeviceProcAddr);
     ADD_HOOK(vkDestroyDevice);
+    ADD_HOOK(vkCreateSwapchainKHR);
+    ADD_HOOK(vkDestroySwapchainKHR);
     ADD_HOOK(vkQueuePresentKHR);
 #undef ADD_HOOK
 
@@ -338,6 +429,7 @@ VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(V
     ADD_HOOK(vkDestroyInstance);
     ADD_HOOK(vkGetInstanceProcAddr);
     ADD_HOOK(vkGetPhysicalDeviceToolPropertiesEXT);
+    ADD_HOOK(vkDestroySurfaceKHR);
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
     ADD_HOOK(vkCreateWin32SurfaceKHR);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
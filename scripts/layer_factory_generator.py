@@ -165,6 +165,7 @@ class LayerFactoryOutputGenerator(OutputGenerator):
  */
 
 #include <string.h>
+#include <atomic>
 #include <mutex>
 
 #define VALIDATION_ERROR_MAP_IMPL
@@ -176,6 +177,8 @@ class LayerFactoryOutputGenerator(OutputGenerator):
 #include "vk_layer_logging.h"
 #include "vk_extension_helper.h"
 #include "vk_layer_utils.h"
+#include "vlf_settings.h"
+#include "vlf_settings_watcher.h"
 
 class layer_factory;
 std::vector<layer_factory *> global_interceptor_list;
@@ -183,6 +186,34 @@ debug_report_data *vlf_report_data = VK_NULL_HANDLE;
 
 #include "layer_factory.h"
 
+// Interceptors registered for each hook point. An interceptor only appears in the list of the hooks it overrides.
+std::vector<layer_factory *> global_hook_interceptors[kInterceptorHookCount];
+
+// The registered interceptors that are enabled, which are the ones intercept functions call. A call loads the table once,
+// so an interceptor enabled or disabled while the call runs gets either both or neither of its Pre and PostCall hooks.
+vlf::PublishedTable<InterceptorTable> enabled_interceptors;
+
+// Per-command-buffer contexts, kept for every command buffer allocated while the layer is active
+vlf::CommandBufferContextMap command_buffer_contexts;
+
+// An entrypoint implemented by this layer and the hook points that make it worth intercepting. Entrypoints the layer
+// needs for its own bookkeeping use kInterceptorHookCount for both hooks and are always intercepted. Command stream
+// entrypoints are also intercepted while an interceptor uses the command buffer batch hooks.
+struct InterceptedEntrypoint {
+    void *funcptr;
+    InterceptorHook pre_hook;
+    InterceptorHook post_hook;
+    bool command_stream;
+};
+
+// True if some interceptor registered for hook, whether enabled or not
+static inline bool HookRegistered(InterceptorHook hook) { return !global_hook_interceptors[hook].empty(); }
+
+// True if some interceptor in the table wants the recorded command stream of each command buffer
+static inline bool CommandStreamRecording(const InterceptorTable &interceptors) {
+    return !interceptors.Empty(kRecordedCommandBuffer) || !interceptors.Empty(kSubmittedCommandBuffer);
+}
+
 struct instance_layer_data {
     VkLayerInstanceDispatchTable dispatch_table;
     VkInstance instance = VK_NULL_HANDLE;
@@ -201,8 +232,135 @@ struct device_layer_data {
     instance_layer_data *instance_data = nullptr;
 };
 
-static std::unordered_map<void *, device_layer_data *> device_layer_data_map;
-static std::unordered_map<void *, instance_layer_data *> instance_layer_data_map;
+// Layer data for instances and devices, found from the loader dispatch table pointer at the start of every dispatchable
+// handle. Applications create few instances and devices, so entries sit in a small open-addressed table that intercepts
+// read without locking. Entries only change when an instance or device is created or destroyed, which Vulkan does not
+// allow to race with other calls on the same object; writers are serialized by the table's own lock.
+template <typename DATA_T, uint32_t kSlotCountLog2 = 6>
+class DispatchKeyTable {
+   public:
+    DispatchKeyTable() : overflow_count_(0), size_(0) {
+        for (auto &slot : slots_) {
+            slot.key.store(nullptr, std::memory_order_relaxed);
+            slot.data.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns the data for key, or nullptr if there is none
+    DATA_T *Find(void *key) const {
+        uint32_t index = SlotIndex(key);
+        for (uint32_t probe = 0; probe < kSlotCount; ++probe) {
+            const Slot &slot = slots_[(index + probe) & (kSlotCount - 1)];
+            void *slot_key = slot.key.load(std::memory_order_acquire);
+            if (slot_key == key) return slot.data.load(std::memory_order_relaxed);
+            if (slot_key == nullptr) return nullptr;
+        }
+        // Only reached with more live objects than slots
+        if (overflow_count_.load(std::memory_order_acquire) == 0) return nullptr;
+        std::lock_guard<std::mutex> lock(write_lock_);
+        auto it = overflow_.find(key);
+        return it != overflow_.end() ? it->second : nullptr;
+    }
+
+    // Returns the data for key, creating it if there is none
+    DATA_T *FindOrCreate(void *key) {
+        std::lock_guard<std::mutex> lock(write_lock_);
+        uint32_t index = SlotIndex(key);
+        Slot *free_slot = nullptr;
+        for (uint32_t probe = 0; probe < kSlotCount; ++probe) {
+            Slot &slot = slots_[(index + probe) & (kSlotCount - 1)];
+            void *slot_key = slot.key.load(std::memory_order_relaxed);
+            if (slot_key == key) return slot.data.load(std::memory_order_relaxed);
+            if (slot_key == Tombstone() && !free_slot) free_slot = &slot;
+            if (slot_key == nullptr) {
+                if (!free_slot) free_slot = &slot;
+                break;
+            }
+        }
+        auto it = overflow_.find(key);
+        if (it != overflow_.end()) return it->second;
+
+        DATA_T *data = new DATA_T;
+        if (free_slot) {
+            // Publish the data before the key so that lock-free readers never see a key without its data
+            free_slot->data.store(data, std::memory_order_relaxed);
+            free_slot->key.store(key, std::memory_order_release);
+        } else {
+            overflow_[key] = data;
+            overflow_count_.fetch_add(1, std::memory_order_release);
+        }
+        ++size_;
+        return data;
+    }
+
+    void Erase(void *key) {
+        std::lock_guard<std::mutex> lock(write_lock_);
+        uint32_t index = SlotIndex(key);
+        for (uint32_t probe = 0; probe < kSlotCount; ++probe) {
+            Slot &slot = slots_[(index + probe) & (kSlotCount - 1)];
+            void *slot_key = slot.key.load(std::memory_order_relaxed);
+            if (slot_key == nullptr) break;
+            if (slot_key == key) {
+                // A tombstone rather than an empty slot keeps later entries of the probe sequence reachable
+                slot.key.store(Tombstone(), std::memory_order_release);
+                delete slot.data.load(std::memory_order_relaxed);
+                slot.data.store(nullptr, std::memory_order_relaxed);
+                --size_;
+                return;
+            }
+        }
+        auto it = overflow_.find(key);
+        if (it == overflow_.end()) return;
+        delete it->second;
+        overflow_.erase(it);
+        overflow_count_.fetch_sub(1, std::memory_order_release);
+        --size_;
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lock(write_lock_);
+        return size_ == 0;
+    }
+
+   private:
+    static const uint32_t kSlotCount = 1u << kSlotCountLog2;
+
+    struct Slot {
+        std::atomic<void *> key;
+        std::atomic<DATA_T *> data;
+    };
+
+    static void *Tombstone() { return reinterpret_cast<void *>(uintptr_t(1)); }
+
+    // Dispatch table pointers are heap addresses, so mix the bits before taking the top ones as the slot index
+    static uint32_t SlotIndex(void *key) {
+        uint64_t value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+        value ^= value >> 17;
+        value *= 0x9e3779b97f4a7c15ull;
+        return static_cast<uint32_t>(value >> (64 - kSlotCountLog2));
+    }
+
+    Slot slots_[kSlotCount];
+    std::atomic<uint32_t> overflow_count_;
+    std::unordered_map<void *, DATA_T *> overflow_;
+    size_t size_;
+    mutable std::mutex write_lock_;
+};
+
+// These overloads take precedence over the unordered_map versions from vk_layer_data.h
+template <typename DATA_T, uint32_t kSlotCountLog2>
+DATA_T *GetLayerDataPtr(void *data_key, DispatchKeyTable<DATA_T, kSlotCountLog2> &layer_data_map) {
+    DATA_T *data = layer_data_map.Find(data_key);
+    return data ? data : layer_data_map.FindOrCreate(data_key);
+}
+
+template <typename DATA_T, uint32_t kSlotCountLog2>
+void FreeLayerDataPtr(void *data_key, DispatchKeyTable<DATA_T, kSlotCountLog2> &layer_data_map) {
+    layer_data_map.Erase(data_key);
+}
+
+static DispatchKeyTable<device_layer_data> device_layer_data_map;
+static DispatchKeyTable<instance_layer_data> instance_layer_data_map;
 
 #include "interceptor_objects.h"
 
@@ -216,24 +374,101 @@ using std::unordered_map;
 
 static mutex_t global_lock;
 
+// Writes a message queued by the asynchronous output backend
+static void DeliverOutputRecord(const vlf::OutputRecord &record) {
+    if (record.context == nullptr) {
+        fputs(record.text.c_str(), stdout);
+        fflush(stdout);
+        return;
+    }
+    VulkanTypedHandle null_handle{};
+    LogObjectList objlist(null_handle);
+    // LogMsgLocked takes ownership of the string, which must be malloc'd
+    char *str = strdup(record.text.c_str());
+    LogMsgLocked(static_cast<const debug_report_data *>(record.context), record.flags, objlist, record.tag, str);
+}
+
+// Enables each interceptor that has an identifier unless its "<identifier>.enabled" setting is false. Settings from the
+// control file take priority over the layer settings. Interceptors without an identifier are always enabled.
+static void PublishEnabledInterceptors(const vlf::SettingsMap &control) {
+    auto enabled = [&control](const layer_factory *interceptor) -> bool {
+        const char *identifier = interceptor->interceptor_identifier;
+        if (!identifier) return true;
+        auto setting = control.find(std::string(identifier) + ".enabled");
+        if (setting != control.end()) return vlf::ParseSettingBool(setting->second, true);
+        return vlf::GetLayerSettingBool(identifier, "enabled", true);
+    };
+    enabled_interceptors.Publish(std::unique_ptr<InterceptorTable>(new InterceptorTable(global_hook_interceptors, enabled)));
+}
+
+// Publishes the enabled interceptors. With "lunarg_layer_factory.control_file" set, that file is also watched for changes
+// to the "enabled" settings until the last instance is destroyed.
+static void StartInterceptorControl() {
+    std::string control_file = vlf::GetLayerSetting("lunarg_layer_factory", "control_file", "");
+    if (control_file.empty()) {
+        PublishEnabledInterceptors(vlf::SettingsMap());
+    } else {
+        vlf::SettingsWatcher::Get().Start(control_file, PublishEnabledInterceptors);
+    }
+}
+
 static const VkLayerProperties global_layer = {
     "VK_LAYER_LUNARG_layer_factory", VK_LAYER_API_VERSION, 1, "LunarG Layer Factory Layer",
 };
 
 static const VkExtensionProperties instance_extensions[] = {{VK_EXT_DEBUG_REPORT_EXTENSION_NAME, VK_EXT_DEBUG_REPORT_SPEC_VERSION}};
 
-extern const std::unordered_map<std::string, void*> name_to_funcptr_map;
+// A slot of the generated perfect hash table of entrypoint names. Entrypoints compiled out for this platform keep their
+// slot with a null funcptr so the table layout does not depend on platform defines.
+struct EntrypointSlot {
+    const char *name;
+    InterceptedEntrypoint entrypoint;
+};
+
+static const InterceptedEntrypoint *FindEntrypoint(const char *funcName);
+
+// FNV-1a hash of an entrypoint name, the first step of the perfect hash lookup
+static inline uint32_t HashEntrypointName(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= static_cast<uint8_t>(*name++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Scrambles a name hash combined with its bucket's displacement into a table slot index
+static inline uint32_t MixEntrypointHash(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
 
 
 // Manually written functions
 
+// Returns this layer's implementation of funcName, or nullptr if no interceptor hooks it and the call should go straight
+// to the next layer. Applications keep the pointers they are given, so disabled interceptors count as well; a function
+// returned here calls whichever of its interceptors are enabled at the time.
+static PFN_vkVoidFunction GetInterceptedFunction(const char *funcName) {
+    const InterceptedEntrypoint *entrypoint = FindEntrypoint(funcName);
+    if (!entrypoint) return nullptr;
+    const bool command_stream = HookRegistered(kRecordedCommandBuffer) || HookRegistered(kSubmittedCommandBuffer);
+    if (entrypoint->pre_hook != kInterceptorHookCount && !HookRegistered(entrypoint->pre_hook) &&
+        !HookRegistered(entrypoint->post_hook) && !(entrypoint->command_stream && command_stream)) {
+        return nullptr;
+    }
+    return reinterpret_cast<PFN_vkVoidFunction>(entrypoint->funcptr);
+}
+
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, const char *funcName) {
     assert(device);
     device_layer_data *device_data = GetLayerDataPtr(get_dispatch_key(device), device_layer_data_map);
-    const auto &item = name_to_funcptr_map.find(funcName);
-    if (item != name_to_funcptr_map.end()) {
-        return reinterpret_cast<PFN_vkVoidFunction>(item->second);
-    }
+    PFN_vkVoidFunction intercepted = GetInterceptedFunction(funcName);
+    if (intercepted) return intercepted;
     auto &table = device_data->dispatch_table;
     if (!table.GetDeviceProcAddr) return nullptr;
     return table.GetDeviceProcAddr(device, funcName);
@@ -241,10 +476,8 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, cons
 
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(VkInstance instance, const char *funcName) {
     instance_layer_data *instance_data;
-    const auto &item = name_to_funcptr_map.find(funcName);
-    if (item != name_to_funcptr_map.end()) {
-        return reinterpret_cast<PFN_vkVoidFunction>(item->second);
-    }
+    PFN_vkVoidFunction intercepted = GetInterceptedFunction(funcName);
+    if (intercepted) return intercepted;
     instance_data = GetLayerDataPtr(get_dispatch_key(instance), instance_layer_data_map);
     auto &table = instance_data->dispatch_table;
     if (!table.GetInstanceProcAddr) return nullptr;
@@ -295,10 +528,15 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
     if (fpCreateInstance == NULL) return VK_ERROR_INITIALIZATION_FAILED;
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
 
+    if (instance_layer_data_map.empty()) StartInterceptorControl();
+    const InterceptorTable &interceptors = enabled_interceptors.Get();
+
     // Init dispatch array and call registration functions
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : interceptors[kPreCallCreateInstance]) {
         intercept->PreCallCreateInstance(pCreateInfo, pAllocator, pInstance);
     }
+    // The layer's own bookkeeping depends on these calls, so requests to skip them are dropped
+    layer_factory::TakeSkipCall(nullptr);
 
     VkResult result = fpCreateInstance(pCreateInfo, pAllocator, pInstance);
 
@@ -310,8 +548,11 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
     layer_debug_report_actions(instance_data->report_data, pAllocator, "lunarg_layer_factory");
     layer_debug_messenger_actions(instance_data->report_data, pAllocator, "lunarg_layer_factory");
     vlf_report_data = instance_data->report_data;
+    if (vlf::GetLayerSettingBool("lunarg_layer_factory", "async_output", false)) {
+        vlf::AsyncOutput::Get().Start(DeliverOutputRecord);
+    }
 
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : interceptors[kPostCallCreateInstance]) {
         intercept->PostCallCreateInstance(pCreateInfo, pAllocator, pInstance, result);
     }
 
@@ -321,16 +562,20 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
 VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
     dispatch_key key = get_dispatch_key(instance);
     instance_layer_data *instance_data = GetLayerDataPtr(key, instance_layer_data_map);
-    for (auto intercept : global_interceptor_list) {
+    const InterceptorTable &interceptors = enabled_interceptors.Get();
+    for (auto intercept : interceptors[kPreCallDestroyInstance]) {
         intercept->PreCallDestroyInstance(instance, pAllocator);
     }
+    layer_factory::TakeSkipCall(nullptr);
 
     instance_data->dispatch_table.DestroyInstance(instance, pAllocator);
 
     lock_guard_t lock(global_lock);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : interceptors[kPostCallDestroyInstance]) {
         intercept->PostCallDestroyInstance(instance, pAllocator);
     }
+    // Queued messages may go to this instance's callbacks, so write them out before the callbacks are destroyed
+    vlf::AsyncOutput::Get().Flush();
     // Clean up logging callback, if any
     while (instance_data->logging_messenger.size() > 0) {
         VkDebugUtilsMessengerEXT messenger = instance_data->logging_messenger.back();
@@ -344,6 +589,10 @@ VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocati
     }
     layer_debug_utils_destroy_instance(instance_data->report_data);
     FreeLayerDataPtr(key, instance_layer_data_map);
+    if (instance_layer_data_map.empty()) {
+        vlf::AsyncOutput::Get().Stop();
+        vlf::SettingsWatcher::Get().Stop();
+    }
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDeviceCreateInfo *pCreateInfo,
@@ -357,15 +606,17 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDevice
     PFN_vkCreateDevice fpCreateDevice = (PFN_vkCreateDevice)fpGetInstanceProcAddr(instance_data->instance, "vkCreateDevice");
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
 
-    for (auto intercept : global_interceptor_list) {
+    const InterceptorTable &interceptors = enabled_interceptors.Get();
+    for (auto intercept : interceptors[kPreCallCreateDevice]) {
         intercept->PreCallCreateDevice(gpu, pCreateInfo, pAllocator, pDevice);
     }
+    layer_factory::TakeSkipCall(nullptr);
     lock.unlock();
 
     VkResult result = fpCreateDevice(gpu, pCreateInfo, pAllocator, pDevice);
 
     lock.lock();
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : interceptors[kPostCallCreateDevice]) {
         intercept->PostCallCreateDevice(gpu, pCreateInfo, pAllocator, pDevice, result);
     }
     device_layer_data *device_data = GetLayerDataPtr(get_dispatch_key(*pDevice), device_layer_data_map);
@@ -386,19 +637,22 @@ VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCall
     dispatch_key key = get_dispatch_key(device);
     device_layer_data *device_data = GetLayerDataPtr(key, device_layer_data_map);
 
+    const InterceptorTable &interceptors = enabled_interceptors.Get();
     unique_lock_t lock(global_lock);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : interceptors[kPreCallDestroyDevice]) {
         intercept->PreCallDestroyDevice(device, pAllocator);
     }
+    layer_factory::TakeSkipCall(nullptr);
     lock.unlock();
 
     device_data->dispatch_table.DestroyDevice(device, pAllocator);
 
     lock.lock();
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : interceptors[kPostCallDestroyDevice]) {
         intercept->PostCallDestroyDevice(device, pAllocator);
     }
 
+    command_buffer_contexts.DestroyDevice(device);
     FreeLayerDataPtr(key, device_layer_data_map);
 }
 
@@ -407,12 +661,14 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDebugReportCallbackEXT(VkInstance instance,
                                                             const VkAllocationCallbacks *pAllocator,
                                                             VkDebugReportCallbackEXT *pCallback) {
     instance_layer_data *instance_data = GetLayerDataPtr(get_dispatch_key(instance), instance_layer_data_map);
-    for (auto intercept : global_interceptor_list) {
+    const InterceptorTable &interceptors = enabled_interceptors.Get();
+    for (auto intercept : interceptors[kPreCallCreateDebugReportCallbackEXT]) {
         intercept->PreCallCreateDebugReportCallbackEXT(instance, pCreateInfo, pAllocator, pCallback);
     }
+    layer_factory::TakeSkipCall(nullptr);
     VkResult result = instance_data->dispatch_table.CreateDebugReportCallbackEXT(instance, pCreateInfo, pAllocator, pCallback);
     result = layer_create_report_callback(instance_data->report_data, false, pCreateInfo, pAllocator, pCallback);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : interceptors[kPostCallCreateDebugReportCallbackEXT]) {
         intercept->PostCallCreateDebugReportCallbackEXT(instance, pCreateInfo, pAllocator, pCallback, result);
     }
     return result;
@@ -421,12 +677,14 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateDebugReportCallbackEXT(VkInstance instance,
 VKAPI_ATTR void VKAPI_CALL DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback,
                                                          const VkAllocationCallbacks *pAllocator) {
     instance_layer_data *instance_data = GetLayerDataPtr(get_dispatch_key(instance), instance_layer_data_map);
-    for (auto intercept : global_interceptor_list) {
+    const InterceptorTable &interceptors = enabled_interceptors.Get();
+    for (auto intercept : interceptors[kPreCallDestroyDebugReportCallbackEXT]) {
         intercept->PreCallDestroyDebugReportCallbackEXT(instance, callback, pAllocator);
     }
+    layer_factory::TakeSkipCall(nullptr);
     instance_data->dispatch_table.DestroyDebugReportCallbackEXT(instance, callback, pAllocator);
     layer_destroy_callback(instance_data->report_data, callback, pAllocator);
-    for (auto intercept : global_interceptor_list) {
+    for (auto intercept : interceptors[kPostCallDestroyDebugReportCallbackEXT]) {
         intercept->PostCallDestroyDebugReportCallbackEXT(instance, callback, pAllocator);
     }
 }
@@ -498,8 +756,19 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         OutputGenerator.__init__(self, errFile, warnFile, diagFile)
         # Internal state - accumulators for different inner block text
         self.sections = dict([(section, []) for section in self.ALL_SECTIONS])
-        self.intercepts = []
+        self.intercepts = []                        # (name, platform protect, InterceptedEntrypoint initializer) per entrypoint
         self.layer_factory = ''                     # String containing base layer factory class definition
+        self.hook_enum = []                         # Hook point identifiers, two per intercepted command
+        self.hook_registration = ''                 # Body of the override-detecting layer_factory constructor
+        # Commands that create, reset or destroy command buffers and so maintain the per-command-buffer contexts
+        self.command_buffer_lifecycle = ['vkAllocateCommandBuffers', 'vkFreeCommandBuffers', 'vkBeginCommandBuffer',
+                                         'vkResetCommandBuffer', 'vkResetCommandPool', 'vkDestroyCommandPool']
+        # Queue submissions that call SubmittedCommandBuffer, with the count and the command buffer of a submit info
+        self.queue_submits = {
+            'vkQueueSubmit': ('commandBufferCount', 'pCommandBuffers[j]'),
+            'vkQueueSubmit2': ('commandBufferInfoCount', 'pCommandBufferInfos[j].commandBuffer'),
+            'vkQueueSubmit2KHR': ('commandBufferInfoCount', 'pCommandBufferInfos[j].commandBuffer'),
+        }
 
     # Check if the parameter passed in is a pointer to an array
     def paramIsArray(self, param):
@@ -543,10 +812,15 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
                 for s in genOpts.prefixText:
                     write(s, file=self.outFile)
             write('#include "vulkan/vk_layer.h"', file=self.outFile)
-            write('#include <unordered_map>\n', file=self.outFile)
+            write('#include <type_traits>', file=self.outFile)
+            write('#include <unordered_map>', file=self.outFile)
+            write('#include "vlf_async_output.h"', file=self.outFile)
+            write('#include "vlf_command_buffer.h"', file=self.outFile)
+            write('#include "vlf_interceptor_table.h"\n', file=self.outFile)
             write('class layer_factory;', file=self.outFile)
             write('extern std::vector<layer_factory *> global_interceptor_list;', file=self.outFile)
-            write('extern debug_report_data *vlf_report_data;\n', file=self.outFile)
+            write('extern debug_report_data *vlf_report_data;', file=self.outFile)
+            write('extern vlf::CommandBufferContextMap command_buffer_contexts;\n', file=self.outFile)
             write('namespace vulkan_layer_factory {\n', file=self.outFile)
         else:
             write(self.inline_custom_source_preamble, file=self.outFile)
@@ -555,22 +829,51 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         self.layer_factory += '// Layer Factory base class definition\n'
         self.layer_factory += 'class layer_factory {\n'
         self.layer_factory += '    public:\n'
+        self.layer_factory += '        // Interceptors constructed without their own type are called for every hook point\n'
         self.layer_factory += '        layer_factory() {\n'
         self.layer_factory += '            global_interceptor_list.emplace_back(this);\n'
+        self.layer_factory += '            for (auto &interceptors : global_hook_interceptors) interceptors.emplace_back(this);\n'
         self.layer_factory += '        };\n'
         self.layer_factory += '\n'
+        self.layer_factory += '        // Interceptors that pass \'this\' are only called for the hook points their class overrides\n'
+        self.layer_factory += '        template <typename T>\n'
+        self.layer_factory += '        explicit layer_factory(T *interceptor);\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        // Interceptors that also pass an identifier, normally their settings prefix, can be enabled and disabled\n'
+        self.layer_factory += '        // through the "<identifier>.enabled" setting, also while running when a control file is set\n'
+        self.layer_factory += '        template <typename T>\n'
+        self.layer_factory += '        layer_factory(T *interceptor, const char *identifier) : layer_factory(interceptor) {\n'
+        self.layer_factory += '            interceptor_identifier = identifier;\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        // A member function pointer names the class that declared it, so hooks that a class derived from\n'
+        self.layer_factory += '        // layer_factory does not declare resolve to the base class default\n'
+        self.layer_factory += '        template <typename C, typename R, typename... Args>\n'
+        self.layer_factory += '        static constexpr bool IsHookOverridden(R (C::*)(Args...)) {\n'
+        self.layer_factory += '            return !std::is_same<C, layer_factory>::value;\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        // The global API hooks are overloaded, so the signature selects the overload to check\n'
+        self.layer_factory += '        template <typename Signature, typename C>\n'
+        self.layer_factory += '        static constexpr bool IsApiHookOverridden(Signature C::*) {\n'
+        self.layer_factory += '            return !std::is_same<C, layer_factory>::value;\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '        // Reached when the class declares only the other overload, which hides this one\n'
+        self.layer_factory += '        template <typename Signature>\n'
+        self.layer_factory += '        static constexpr bool IsApiHookOverridden(...) {\n'
+        self.layer_factory += '            return true;\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        void RegisterHook(InterceptorHook hook, bool overridden) {\n'
+        self.layer_factory += '            if (overridden) global_hook_interceptors[hook].emplace_back(this);\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '\n'
         self.layer_factory += '        std::string layer_name = "VLF";\n'
+        self.layer_factory += '        const char *interceptor_identifier = nullptr;\n'
         self.layer_factory += '\n'
         self.layer_factory += '        bool log_msg(const debug_report_data *debug_data, VkFlags msg_flags, VkObjectType object_type,\n'
         self.layer_factory += '                                   uint64_t src_object, const std::string &vuid_text, const char *format, ...) {\n'
-        self.layer_factory += '            if (!debug_data) return false;\n'
-        self.layer_factory += '            VkFlags local_severity = 0;\n'
-        self.layer_factory += '            VkFlags local_type = 0;\n'
-        self.layer_factory += '            DebugReportFlagsToAnnotFlags(msg_flags, true, &local_severity, &local_type);\n'
-        self.layer_factory += '            if (!debug_data || !(debug_data->active_severities & local_severity) || !(debug_data->active_types & local_type)) {\n'
-        self.layer_factory += '                // Message is not wanted\n'
-        self.layer_factory += '                return false;\n'
-        self.layer_factory += '            }\n'
+        self.layer_factory += '            if (!MessageWanted(debug_data, msg_flags)) return false;\n'
         self.layer_factory += '        \n'
         self.layer_factory += '            va_list argptr;\n'
         self.layer_factory += '            va_start(argptr, format);\n'
@@ -587,25 +890,43 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         self.layer_factory += '            return LogMsgLocked(debug_data, msg_flags, objlist, vuid_text, str);\n'
         self.layer_factory += '        }\n'
         self.layer_factory += '\n'
-        self.layer_factory += '        // Pre/post hook point declarations\n'
-        self.layer_factory += '        bool Information(const std::string &message) {\n'
-        self.layer_factory += '            return log_msg(vlf_report_data, kInformationBit, VK_OBJECT_TYPE_UNKNOWN, 0,\n'
-        self.layer_factory += '                           layer_name.c_str(), "%s", message.c_str());\n'
+        self.layer_factory += '        static bool MessageWanted(const debug_report_data *debug_data, VkFlags msg_flags) {\n'
+        self.layer_factory += '            if (!debug_data) return false;\n'
+        self.layer_factory += '            VkFlags local_severity = 0;\n'
+        self.layer_factory += '            VkFlags local_type = 0;\n'
+        self.layer_factory += '            DebugReportFlagsToAnnotFlags(msg_flags, true, &local_severity, &local_type);\n'
+        self.layer_factory += '            return (debug_data->active_severities & local_severity) && (debug_data->active_types & local_type);\n'
         self.layer_factory += '        }\n'
         self.layer_factory += '\n'
-        self.layer_factory += '        bool PerformanceWarning(const std::string &message) {\n'
-        self.layer_factory += '            return log_msg(vlf_report_data, kPerformanceWarningBit, VK_OBJECT_TYPE_UNKNOWN,\n'
-        self.layer_factory += '                           0, layer_name.c_str(), "%s", message.c_str());\n'
+        self.layer_factory += '        // With asynchronous output enabled the message is queued for the writer thread, and the return value is always\n'
+        self.layer_factory += '        // false because the application callback has not run yet\n'
+        self.layer_factory += '        bool OutputMessage(VkFlags msg_flags, const std::string &message) {\n'
+        self.layer_factory += '            if (!vlf::AsyncOutput::Get().Enabled()) {\n'
+        self.layer_factory += '                return log_msg(vlf_report_data, msg_flags, VK_OBJECT_TYPE_UNKNOWN, 0, layer_name.c_str(), "%s",\n'
+        self.layer_factory += '                               message.c_str());\n'
+        self.layer_factory += '            }\n'
+        self.layer_factory += '            if (MessageWanted(vlf_report_data, msg_flags)) {\n'
+        self.layer_factory += '                vlf::AsyncOutput::Get().Submit(vlf_report_data, msg_flags, layer_name, message);\n'
+        self.layer_factory += '            }\n'
+        self.layer_factory += '            return false;\n'
         self.layer_factory += '        }\n'
         self.layer_factory += '\n'
-        self.layer_factory += '        bool Warning(const std::string &message) {\n'
-        self.layer_factory += '            return log_msg(vlf_report_data, kWarningBit, VK_OBJECT_TYPE_UNKNOWN, 0,\n'
-        self.layer_factory += '                           layer_name.c_str(), "%s", message.c_str());\n'
-        self.layer_factory += '        }\n'
+        self.layer_factory += '        // Pre/post hook point declarations\n'
+        self.layer_factory += '        bool Information(const std::string &message) { return OutputMessage(kInformationBit, message); }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        bool PerformanceWarning(const std::string &message) { return OutputMessage(kPerformanceWarningBit, message); }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        bool Warning(const std::string &message) { return OutputMessage(kWarningBit, message); }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        bool Error(const std::string &message) { return OutputMessage(kDebugBit, message); }\n'
         self.layer_factory += '\n'
-        self.layer_factory += '        bool Error(const std::string &message) {\n'
-        self.layer_factory += '            return log_msg(vlf_report_data, kDebugBit, VK_OBJECT_TYPE_UNKNOWN, 0,\n'
-        self.layer_factory += '                           layer_name.c_str(), "%s", message.c_str());\n'
+        self.layer_factory += '        // Writes text to stdout, through the writer thread when asynchronous output is enabled\n'
+        self.layer_factory += '        void Print(const std::string &text) {\n'
+        self.layer_factory += '            if (vlf::AsyncOutput::Get().Enabled()) {\n'
+        self.layer_factory += '                vlf::AsyncOutput::Get().Submit(nullptr, 0, layer_name, text);\n'
+        self.layer_factory += '            } else {\n'
+        self.layer_factory += '                fputs(text.c_str(), stdout);\n'
+        self.layer_factory += '            }\n'
         self.layer_factory += '        }\n'
         self.layer_factory += '\n'
         self.layer_factory += '        void Breakpoint(void) {\n'
@@ -621,6 +942,38 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         self.layer_factory += '        virtual void PreCallApiFunction(const char *api_name, VkResult result) {};\n'
         self.layer_factory += '        virtual void PostCallApiFunction(const char *api_name, VkResult result) {};\n'
         self.layer_factory += '\n'
+        self.layer_factory += '        // Called from a PreCall hook to keep the current call from reaching later layers and the driver. The PostCall\n'
+        self.layer_factory += '        // hooks still run, and a VkResult-returning call returns result. The interceptor must fill in any output\n'
+        self.layer_factory += '        // parameters itself. Calls returning other values, and instance and device creation and destruction, are\n'
+        self.layer_factory += '        // never skipped.\n'
+        self.layer_factory += '        static void SkipCall(VkResult result = VK_SUCCESS) {\n'
+        self.layer_factory += '            CallSkip &skip = CurrentCallSkip();\n'
+        self.layer_factory += '            skip.requested = true;\n'
+        self.layer_factory += '            skip.result = result;\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        // Returns true if a PreCall hook skipped the current call, copying the result it asked for into *result if\n'
+        self.layer_factory += '        // requested, and clears the request\n'
+        self.layer_factory += '        static bool TakeSkipCall(VkResult *result) {\n'
+        self.layer_factory += '            CallSkip &skip = CurrentCallSkip();\n'
+        self.layer_factory += '            if (!skip.requested) return false;\n'
+        self.layer_factory += '            skip.requested = false;\n'
+        self.layer_factory += '            if (result) *result = skip.result;\n'
+        self.layer_factory += '            return true;\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        // Per-command-buffer storage, or nullptr for a command buffer the layer has not seen allocated\n'
+        self.layer_factory += '        vlf::CommandBufferContext *GetCommandBufferContext(VkCommandBuffer command_buffer) {\n'
+        self.layer_factory += '            return command_buffer_contexts.Get(command_buffer);\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        // Batch hooks, called with the recorded command stream of a command buffer at vkEndCommandBuffer and for\n'
+        self.layer_factory += '        // each command buffer of a vkQueueSubmit or vkQueueSubmit2. Secondary command buffers are only reported\n'
+        self.layer_factory += '        // at their own vkEndCommandBuffer, not again when a submitted primary executes them. Overriding either\n'
+        self.layer_factory += '        // hook turns on command stream recording.\n'
+        self.layer_factory += '        virtual void RecordedCommandBuffer(VkCommandBuffer command_buffer, vlf::CommandBufferContext &context) {};\n'
+        self.layer_factory += '        virtual void SubmittedCommandBuffer(VkQueue queue, VkCommandBuffer command_buffer, vlf::CommandBufferContext &context) {};\n'
+        self.layer_factory += '\n'
         self.layer_factory += '        // Pre/post hook point declarations\n'
     #
     def endFile(self):
@@ -628,21 +981,122 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         self.newline()
         if not self.header:
             # Record intercepted procedures
-            write('// Map of all APIs to be intercepted by this layer', file=self.outFile)
-            write('const std::unordered_map<std::string, void*> name_to_funcptr_map = {', file=self.outFile)
-            write('\n'.join(self.intercepts), file=self.outFile)
-            write('};\n', file=self.outFile)
-            self.newline()
+            self.writeEntrypointTable()
         write('} // namespace vulkan_layer_factory', file=self.outFile)
         if self.header:
             self.newline()
+            # Output the hook point identifiers used to dispatch only to interceptors that override a hook
+            write('enum InterceptorHook {', file=self.outFile)
+            write('\n'.join(self.hook_enum), file=self.outFile)
+            write('    kRecordedCommandBuffer,', file=self.outFile)
+            write('    kSubmittedCommandBuffer,', file=self.outFile)
+            write('    kInterceptorHookCount', file=self.outFile)
+            write('};\n', file=self.outFile)
+            write('extern std::vector<layer_factory *> global_hook_interceptors[kInterceptorHookCount];', file=self.outFile)
+            write('typedef vlf::InterceptorTable<layer_factory, kInterceptorHookCount> InterceptorTable;', file=self.outFile)
+            write('extern vlf::PublishedTable<InterceptorTable> enabled_interceptors;\n', file=self.outFile)
             # Output Layer Factory Class Definitions
+            self.layer_factory += '\n'
+            self.layer_factory += '    private:\n'
+            self.layer_factory += '        struct CallSkip {\n'
+            self.layer_factory += '            bool requested;\n'
+            self.layer_factory += '            VkResult result;\n'
+            self.layer_factory += '        };\n'
+            self.layer_factory += '        static CallSkip &CurrentCallSkip() {\n'
+            self.layer_factory += '            static thread_local CallSkip skip = {false, VK_SUCCESS};\n'
+            self.layer_factory += '            return skip;\n'
+            self.layer_factory += '        }\n'
             self.layer_factory += '};\n'
             write(self.layer_factory, file=self.outFile)
+            # Output the constructor that registers an interceptor for the hooks its class overrides. The default Pre/PostCall
+            # hooks forward to the global API hooks, so overriding one of those registers the interceptor for every hook.
+            write('template <typename T>', file=self.outFile)
+            write('layer_factory::layer_factory(T *interceptor) {', file=self.outFile)
+            write('    global_interceptor_list.emplace_back(this);', file=self.outFile)
+            write('    const bool pre_api = IsApiHookOverridden<void(const char *)>(&T::PreCallApiFunction);', file=self.outFile)
+            write('    const bool post_api = IsApiHookOverridden<void(const char *)>(&T::PostCallApiFunction);', file=self.outFile)
+            write('    const bool post_api_result = IsApiHookOverridden<void(const char *, VkResult)>(&T::PostCallApiFunction);', file=self.outFile)
+            write(self.hook_registration, end='', file=self.outFile)
+            write('    RegisterHook(kRecordedCommandBuffer, IsHookOverridden(&T::RecordedCommandBuffer));', file=self.outFile)
+            write('    RegisterHook(kSubmittedCommandBuffer, IsHookOverridden(&T::SubmittedCommandBuffer));', file=self.outFile)
+            write('}', file=self.outFile)
         else:
             write(self.inline_custom_source_postamble, file=self.outFile)
         # Finish processing in superclass
         OutputGenerator.endFile(self)
+    #
+    # FNV-1a hash of an entrypoint name, matching HashEntrypointName() in the generated layer
+    def hashEntrypointName(self, name):
+        hash = 2166136261
+        for c in name.encode():
+            hash = ((hash ^ c) * 16777619) & 0xffffffff
+        return hash
+    #
+    # Murmur3 finalizer, matching MixEntrypointHash() in the generated layer
+    def mixEntrypointHash(self, hash):
+        hash ^= hash >> 16
+        hash = (hash * 0x85ebca6b) & 0xffffffff
+        hash ^= hash >> 13
+        hash = (hash * 0xc2b2ae35) & 0xffffffff
+        hash ^= hash >> 16
+        return hash
+    #
+    # Emit the intercepted entrypoints as a constant hash-and-displace perfect hash table. Names are hashed once; the hash
+    # selects a bucket whose displacement, xor-ed into the hash and mixed, selects a unique slot. Lookups cost one pass
+    # over the name, one strcmp and no allocation, and the tables need no static initialization.
+    def writeEntrypointTable(self):
+        table_size = 1
+        while table_size < len(self.intercepts):
+            table_size *= 2
+        bucket_count = max(1, table_size // 4)
+        buckets = [[] for _ in range(bucket_count)]
+        for intercept in self.intercepts:
+            hash = self.hashEntrypointName(intercept[0])
+            buckets[hash & (bucket_count - 1)].append((hash, intercept))
+        displacements = [0] * bucket_count
+        slots = [None] * table_size
+        for bucket_index in sorted(range(bucket_count), key=lambda index: -len(buckets[index])):
+            bucket = buckets[bucket_index]
+            if not bucket:
+                continue
+            displacement = 1
+            while True:
+                candidates = [self.mixEntrypointHash(hash ^ displacement) & (table_size - 1) for hash, _ in bucket]
+                if len(set(candidates)) == len(candidates) and all(slots[slot] is None for slot in candidates):
+                    break
+                displacement += 1
+            displacements[bucket_index] = displacement
+            for slot, (_, intercept) in zip(candidates, bucket):
+                slots[slot] = intercept
+
+        write('// Perfect hash table of all APIs to be intercepted by this layer', file=self.outFile)
+        write('static const uint32_t kEntrypointBucketCount = %d;' % bucket_count, file=self.outFile)
+        write('static const uint32_t kEntrypointTableSize = %d;\n' % table_size, file=self.outFile)
+        write('static const uint32_t entrypoint_displacements[kEntrypointBucketCount] = {', file=self.outFile)
+        for index in range(0, bucket_count, 8):
+            write('    ' + ' '.join('%d,' % value for value in displacements[index:index + 8]), file=self.outFile)
+        write('};\n', file=self.outFile)
+        write('static const EntrypointSlot name_to_funcptr_table[kEntrypointTableSize] = {', file=self.outFile)
+        for slot in slots:
+            if slot is None:
+                write('    {nullptr, {nullptr, kInterceptorHookCount, kInterceptorHookCount}},', file=self.outFile)
+                continue
+            name, protect, entry = slot
+            if protect is not None:
+                write('#ifdef %s' % protect, file=self.outFile)
+            write('    {"%s", {%s}},' % (name, entry), file=self.outFile)
+            if protect is not None:
+                write('#else', file=self.outFile)
+                write('    {"%s", {nullptr, kInterceptorHookCount, kInterceptorHookCount}},' % name, file=self.outFile)
+                write('#endif', file=self.outFile)
+        write('};\n', file=self.outFile)
+        write('static const InterceptedEntrypoint *FindEntrypoint(const char *funcName) {', file=self.outFile)
+        write('    uint32_t hash = HashEntrypointName(funcName);', file=self.outFile)
+        write('    uint32_t displacement = entrypoint_displacements[hash & (kEntrypointBucketCount - 1)];', file=self.outFile)
+        write('    const EntrypointSlot &slot = name_to_funcptr_table[MixEntrypointHash(hash ^ displacement) & (kEntrypointTableSize - 1)];', file=self.outFile)
+        write('    if (!slot.name || strcmp(slot.name, funcName) != 0) return nullptr;', file=self.outFile)
+        write('    return &slot.entrypoint;', file=self.outFile)
+        write('}\n', file=self.outFile)
 
     def beginFeature(self, interface, emit):
         # Start processing in superclass
@@ -748,14 +1202,20 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
             self.appendSection('command', '')
             self.appendSection('command', self.makeCDecls(cmdinfo.elem)[0])
             if (self.featureExtraProtect is not None):
-                self.intercepts += [ '#ifdef %s' % self.featureExtraProtect ]
+                self.hook_enum += [ '#ifdef %s' % self.featureExtraProtect ]
+                self.hook_registration += '#ifdef %s\n' % self.featureExtraProtect
                 self.layer_factory += '#ifdef %s\n' % self.featureExtraProtect
             # Update base class with virtual function declarations
             self.layer_factory += self.BaseClassCdecl(cmdinfo.elem, name)
-            # Update function intercepts
-            self.intercepts += [ '    {"%s", (void*)%s},' % (name,name[2:]) ]
+            # Update hook point identifiers and their registration
+            resulttype = cmdinfo.elem.find('proto/type')
+            post_api = 'post_api_result' if resulttype is not None and resulttype.text == 'VkResult' else 'post_api'
+            self.hook_enum += [ '    kPreCall%s,' % name[2:], '    kPostCall%s,' % name[2:] ]
+            self.hook_registration += '    RegisterHook(kPreCall%s, pre_api || IsHookOverridden(&T::PreCall%s));\n' % (name[2:], name[2:])
+            self.hook_registration += '    RegisterHook(kPostCall%s, %s || IsHookOverridden(&T::PostCall%s));\n' % (name[2:], post_api, name[2:])
             if (self.featureExtraProtect is not None):
-                self.intercepts += [ '#endif' ]
+                self.hook_enum += [ '#endif' ]
+                self.hook_registration += '#endif\n'
                 self.layer_factory += '#endif\n'
             return
 
@@ -780,14 +1240,15 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
             ####self.appendSection('command', '')
             ####self.appendSection('command', '// Declare only')
             ####self.appendSection('command', decls[0])
-            self.intercepts += [ '    {"%s", (void*)%s},' % (name,name[2:]) ]
+            self.intercepts += [ (name, self.featureExtraProtect, '(void*)%s, kInterceptorHookCount, kInterceptorHookCount' % name[2:]) ]
             return
-        # Record that the function will be intercepted
-        if (self.featureExtraProtect is not None):
-            self.intercepts += [ '#ifdef %s' % self.featureExtraProtect ]
-        self.intercepts += [ '    {"%s", (void*)%s},' % (name,name[2:]) ]
-        if (self.featureExtraProtect is not None):
-            self.intercepts += [ '#endif' ]
+        # Record that the function will be intercepted. Command buffer lifecycle functions keep the per-command-buffer
+        # contexts up to date and are always intercepted.
+        if name in self.command_buffer_lifecycle:
+            self.intercepts += [ (name, self.featureExtraProtect, '(void*)%s, kInterceptorHookCount, kInterceptorHookCount' % name[2:]) ]
+        else:
+            command_stream = ', true' if name.startswith('vkCmd') or name in ['vkEndCommandBuffer'] + list(self.queue_submits) else ''
+            self.intercepts += [ (name, self.featureExtraProtect, '(void*)%s, kPreCall%s, kPostCall%s%s' % (name[2:],name[2:],name[2:],command_stream)) ]
         OutputGenerator.genCmd(self, cmdinfo, name, alias)
         #
         decls = self.makeCDecls(cmdinfo.elem)
@@ -804,15 +1265,34 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
             device_or_instance = 'instance'
             dispatch_table_name = 'VkLayerInstanceDispatchTable'
         self.appendSection('command', '    %s_layer_data *%s_data = GetLayerDataPtr(get_dispatch_key(%s), %s_layer_data_map);' % (device_or_instance, device_or_instance, dispatchable_name, device_or_instance))
+        self.appendSection('command', '    const InterceptorTable &interceptors = enabled_interceptors.Get();')
         api_function_name = cmdinfo.elem.attrib.get('name')
         params = cmdinfo.elem.findall('param/name')
         paramstext = ', '.join([str(param.text) for param in params])
         API = api_function_name.replace('vk','%s_data->dispatch_table.' % (device_or_instance),1)
 
+        # Command buffer context bookkeeping that interceptors see from their pre-call hooks
+        if name == 'vkBeginCommandBuffer':
+            self.appendSection('command', '    command_buffer_contexts.Begin(commandBuffer);')
+
         # Generate pre-call object processing source code
-        self.appendSection('command', '    for (auto intercept : global_interceptor_list) {')
+        self.appendSection('command', '    for (auto intercept : interceptors[kPreCall%s]) {' % api_function_name[2:])
         self.appendSection('command', '        intercept->PreCall%s(%s);' % (api_function_name[2:], paramstext))
         self.appendSection('command', '    }')
+        if name in self.queue_submits:
+            count, command_buffer = self.queue_submits[name]
+            self.appendSection('command', '    if (!interceptors.Empty(kSubmittedCommandBuffer)) {')
+            self.appendSection('command', '        for (uint32_t i = 0; i < submitCount; ++i) {')
+            self.appendSection('command', '            for (uint32_t j = 0; j < pSubmits[i].%s; ++j) {' % count)
+            self.appendSection('command', '                VkCommandBuffer command_buffer = pSubmits[i].%s;' % command_buffer)
+            self.appendSection('command', '                vlf::CommandBufferContext *context = command_buffer_contexts.Get(command_buffer);')
+            self.appendSection('command', '                if (!context) continue;')
+            self.appendSection('command', '                for (auto intercept : interceptors[kSubmittedCommandBuffer]) {')
+            self.appendSection('command', '                    intercept->SubmittedCommandBuffer(queue, command_buffer, *context);')
+            self.appendSection('command', '                }')
+            self.appendSection('command', '            }')
+            self.appendSection('command', '        }')
+            self.appendSection('command', '    }')
 
         # Declare result variable, if any.
         resulttype = cmdinfo.elem.find('proto/type')
@@ -823,16 +1303,61 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         else:
             assignresult = ''
 
-        self.appendSection('command', '    ' + assignresult + API + '(' + paramstext + ');')
+        # A PreCall hook may have asked for the downcall to be skipped. Only calls returning VkResult or nothing can be.
+        # The command buffer context bookkeeping below only runs for calls that went down the stack.
+        if resulttype is None:
+            self.appendSection('command', '    const bool skip = layer_factory::TakeSkipCall(nullptr);')
+            self.appendSection('command', '    if (!skip) {')
+            self.appendSection('command', '        ' + API + '(' + paramstext + ');')
+            self.appendSection('command', '    }')
+        elif resulttype.text == 'VkResult':
+            self.appendSection('command', '    VkResult result;')
+            self.appendSection('command', '    const bool skip = layer_factory::TakeSkipCall(&result);')
+            self.appendSection('command', '    if (!skip) {')
+            self.appendSection('command', '        result = ' + API + '(' + paramstext + ');')
+            self.appendSection('command', '    }')
+        else:
+            self.appendSection('command', '    layer_factory::TakeSkipCall(nullptr);')
+            self.appendSection('command', '    ' + assignresult + API + '(' + paramstext + ');')
+        if name == 'vkResetCommandBuffer':
+            self.appendSection('command', '    if (!skip && result == VK_SUCCESS) command_buffer_contexts.Reset(commandBuffer);')
+        elif name == 'vkResetCommandPool':
+            self.appendSection('command', '    if (!skip && result == VK_SUCCESS) command_buffer_contexts.ResetPool(commandPool);')
 
         # Generate post-call object processing source code
         returnParam = ''
         if (resulttype is not None and resulttype.text == 'VkResult'):
             returnParam = ', result'
-        self.appendSection('command', '    for (auto intercept : global_interceptor_list) {')
+        self.appendSection('command', '    for (auto intercept : interceptors[kPostCall%s]) {' % api_function_name[2:])
         self.appendSection('command', '        intercept->PostCall%s(%s%s);' % (api_function_name[2:], paramstext, returnParam))
         self.appendSection('command', '    }')
 
+        # Command buffer context bookkeeping after the interceptors have seen the call. vkCmd* calls are appended to the
+        # command stream last, so their hooks see CommandIndex() as the position of the current command. A skipped
+        # vkAllocateCommandBuffers leaves pCommandBuffers unwritten, so contexts are only created for a real VK_SUCCESS.
+        if name.startswith('vkCmd'):
+            self.appendSection('command', '    if (!skip && CommandStreamRecording(interceptors)) {')
+            self.appendSection('command', '        vlf::CommandBufferContext *context = command_buffer_contexts.Get(commandBuffer);')
+            self.appendSection('command', '        if (context) context->RecordCommand("%s");' % name)
+            self.appendSection('command', '    }')
+        elif name == 'vkAllocateCommandBuffers':
+            self.appendSection('command', '    if (!skip && result == VK_SUCCESS) {')
+            self.appendSection('command', '        command_buffer_contexts.Allocate(device, pAllocateInfo->commandPool, pAllocateInfo->commandBufferCount, pCommandBuffers);')
+            self.appendSection('command', '    }')
+        elif name == 'vkFreeCommandBuffers':
+            self.appendSection('command', '    if (!skip) command_buffer_contexts.Free(commandBufferCount, pCommandBuffers);')
+        elif name == 'vkDestroyCommandPool':
+            self.appendSection('command', '    if (!skip) command_buffer_contexts.DestroyPool(commandPool);')
+        elif name == 'vkEndCommandBuffer':
+            self.appendSection('command', '    if (!interceptors.Empty(kRecordedCommandBuffer)) {')
+            self.appendSection('command', '        vlf::CommandBufferContext *context = command_buffer_contexts.Get(commandBuffer);')
+            self.appendSection('command', '        if (context) {')
+            self.appendSection('command', '            for (auto intercept : interceptors[kRecordedCommandBuffer]) {')
+            self.appendSection('command', '                intercept->RecordedCommandBuffer(commandBuffer, *context);')
+            self.appendSection('command', '            }')
+            self.appendSection('command', '        }')
+            self.appendSection('command', '    }')
+
         # Return result variable, if any.
         if (resulttype is not None):
             self.appendSection('command', '    return result;')
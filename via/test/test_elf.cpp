@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "via_test.h"
+
+#include <link.h>
+#include <string.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// A copy of the test driver, which is built for this machine, so the native ELF structures can edit it
+class ElfTestLibrary {
+   public:
+    ElfTestLibrary() : bytes(ReadTestFile(TEST_ICD_PATH)) {}
+
+    ElfW(Ehdr)& Header() { return *reinterpret_cast<ElfW(Ehdr)*>(&bytes[0]); }
+
+    ElfW(Phdr)* Segment(ElfW(Word) type) {
+        for (size_t i = 0; i < Header().e_phnum; i++) {
+            ElfW(Phdr)* segment = reinterpret_cast<ElfW(Phdr)*>(&bytes[Header().e_phoff + i * sizeof(ElfW(Phdr))]);
+            if (segment->p_type == type) return segment;
+        }
+        return nullptr;
+    }
+
+    ElfW(Shdr)* Section(ElfW(Word) type) {
+        for (size_t i = 0; i < Header().e_shnum; i++) {
+            ElfW(Shdr)* section = reinterpret_cast<ElfW(Shdr)*>(&bytes[Header().e_shoff + i * sizeof(ElfW(Shdr))]);
+            if (section->sh_type == type) return section;
+        }
+        return nullptr;
+    }
+
+    ElfW(Dyn)* DynamicEntry(ElfW(Sxword) tag) {
+        ElfW(Phdr)* dynamic = Segment(PT_DYNAMIC);
+        for (size_t i = 0; dynamic != nullptr && i < dynamic->p_filesz / sizeof(ElfW(Dyn)); i++) {
+            ElfW(Dyn)* entry = reinterpret_cast<ElfW(Dyn)*>(&bytes[dynamic->p_offset + i * sizeof(ElfW(Dyn))]);
+            if (entry->d_tag == tag) return entry;
+        }
+        return nullptr;
+    }
+
+    // Where in the file the table at a loaded address is
+    size_t Offset(ElfW(Addr) address) {
+        for (size_t i = 0; i < Header().e_phnum; i++) {
+            ElfW(Phdr)* segment = reinterpret_cast<ElfW(Phdr)*>(&bytes[Header().e_phoff + i * sizeof(ElfW(Phdr))]);
+            if (segment->p_type == PT_LOAD && address >= segment->p_vaddr && address - segment->p_vaddr < segment->p_filesz) {
+                return segment->p_offset + (address - segment->p_vaddr);
+            }
+        }
+        return 0;
+    }
+
+    void RemoveSectionHeaders() {
+        bytes.resize(Header().e_shoff);
+        Header().e_shoff = 0;
+        Header().e_shnum = 0;
+        Header().e_shstrndx = 0;
+    }
+
+    std::string bytes;
+};
+
+// An address no segment of the test driver is loaded at
+static const ElfW(Addr) unmapped_address = static_cast<ElfW(Addr)>(0x7ff00000);
+
+class test_elf : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        ASSERT_TRUE(sysroot.Created());
+        ElfTestLibrary library;
+        ASSERT_GE(library.bytes.size(), sizeof(ElfW(Ehdr)));
+        ASSERT_EQ(0, memcmp(library.bytes.data(), ELFMAG, SELFMAG));
+        ASSERT_NE(nullptr, library.Segment(PT_DYNAMIC));
+    }
+
+    // Installs every driver, runs vkvia once and checks each one loads or fails as expected
+    void ExpectLoads(const std::vector<std::pair<std::string, std::string>>& drivers, bool expect_loaded) {
+        for (const auto& driver : drivers) {
+            sysroot.AddDriver(driver.first, driver.second);
+        }
+        Json::Value report;
+        std::string run_error;
+        ASSERT_TRUE(sysroot.Analyze(report, run_error)) << run_error;
+        for (const auto& driver : drivers) {
+            std::string load_error;
+            ASSERT_TRUE(FindReportedDriver(report, driver.first + ".json", load_error)) << driver.first;
+            if (expect_loaded) {
+                EXPECT_EQ("", load_error) << driver.first;
+            } else {
+                EXPECT_NE("", load_error) << driver.first;
+            }
+        }
+    }
+
+    ViaTestSysroot sysroot;
+};
+
+TEST_F(test_elf, valid_library_loads) {
+    ElfTestLibrary stripped;
+    stripped.RemoveSectionHeaders();
+
+    // Without a dynamic segment, the tables are found through the section headers
+    ElfTestLibrary sections_only;
+    sections_only.Segment(PT_DYNAMIC)->p_type = PT_NULL;
+
+    ExpectLoads({{"valid", ElfTestLibrary().bytes}, {"stripped", stripped.bytes}, {"sections_only", sections_only.bytes}},
+                true);
+}
+
+TEST_F(test_elf, truncated_library_fails) {
+    ElfTestLibrary library;
+    const size_t phdrs_offset = library.Header().e_phoff;
+    const size_t dynamic_offset = library.Segment(PT_DYNAMIC)->p_offset;
+
+    std::vector<std::pair<std::string, std::string>> drivers;
+    for (size_t size : {size_t(0), size_t(SELFMAG), sizeof(ElfW(Ehdr)) - 1, phdrs_offset + 1, dynamic_offset + 1}) {
+        drivers.push_back({"truncated_" + std::to_string(size), library.bytes.substr(0, size)});
+    }
+    ExpectLoads(drivers, false);
+}
+
+TEST_F(test_elf, corrupt_program_headers_fail) {
+    std::vector<std::pair<std::string, std::string>> drivers;
+
+    ElfTestLibrary library;
+    library.Header().e_phnum = 0xffff;
+    drivers.push_back({"too_many_segments", library.bytes});
+
+    library = ElfTestLibrary();
+    library.Segment(PT_DYNAMIC)->p_filesz = ~static_cast<ElfW(Xword)>(0) / 2;
+    drivers.push_back({"huge_dynamic_segment", library.bytes});
+
+    library = ElfTestLibrary();
+    library.Segment(PT_DYNAMIC)->p_offset = library.bytes.size();
+    drivers.push_back({"dynamic_segment_past_end", library.bytes});
+
+    ExpectLoads(drivers, false);
+}
+
+TEST_F(test_elf, corrupt_dynamic_entries_fail) {
+    std::vector<std::pair<std::string, std::string>> drivers;
+
+    ElfTestLibrary library;
+    library.DynamicEntry(DT_STRSZ)->d_un.d_val = ~static_cast<ElfW(Xword)>(0) / 2;
+    drivers.push_back({"huge_string_table", library.bytes});
+
+    library = ElfTestLibrary();
+    library.DynamicEntry(DT_STRTAB)->d_un.d_ptr = unmapped_address;
+    drivers.push_back({"unmapped_string_table", library.bytes});
+
+    library = ElfTestLibrary();
+    library.DynamicEntry(DT_SYMTAB)->d_un.d_ptr = unmapped_address;
+    drivers.push_back({"unmapped_symbol_table", library.bytes});
+
+    // Without a hash table the symbol count isn't known
+    library = ElfTestLibrary();
+    for (ElfW(Sxword) tag : {DT_HASH, DT_GNU_HASH}) {
+        if (library.DynamicEntry(tag) != nullptr) library.DynamicEntry(tag)->d_un.d_ptr = unmapped_address;
+    }
+    drivers.push_back({"unmapped_hash_table", library.bytes});
+
+    library = ElfTestLibrary();
+    if (library.DynamicEntry(DT_GNU_HASH) != nullptr) {
+        uint32_t bucket_count = 0xffffffff;
+        memcpy(&library.bytes[library.Offset(library.DynamicEntry(DT_GNU_HASH)->d_un.d_ptr)], &bucket_count, sizeof(bucket_count));
+        drivers.push_back({"huge_gnu_hash_table", library.bytes});
+    }
+
+    ExpectLoads(drivers, false);
+}
+
+TEST_F(test_elf, corrupt_section_headers_fail) {
+    std::vector<std::pair<std::string, std::string>> drivers;
+
+    ElfTestLibrary library;
+    library.Segment(PT_DYNAMIC)->p_type = PT_NULL;
+    library.Header().e_shnum = 0xffff;
+    drivers.push_back({"too_many_sections", library.bytes});
+
+    library = ElfTestLibrary();
+    library.Segment(PT_DYNAMIC)->p_type = PT_NULL;
+    library.Section(SHT_DYNSYM)->sh_size = ~static_cast<ElfW(Xword)>(0) / 2;
+    drivers.push_back({"huge_symbol_section", library.bytes});
+
+    library = ElfTestLibrary();
+    library.Segment(PT_DYNAMIC)->p_type = PT_NULL;
+    library.Section(SHT_STRTAB)->sh_size = ~static_cast<ElfW(Xword)>(0);
+    drivers.push_back({"huge_string_section", library.bytes});
+
+    library = ElfTestLibrary();
+    library.Segment(PT_DYNAMIC)->p_type = PT_NULL;
+    library.RemoveSectionHeaders();
+    drivers.push_back({"no_tables", library.bytes});
+
+    ExpectLoads(drivers, false);
+}
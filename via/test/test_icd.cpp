@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The driver library the vkvia tests install and corrupt.  It is linked without the C and C++ runtimes, so it has no
+// dependencies a test sysroot would have to provide.
+
+extern "C" __attribute__((visibility("default"))) void* vk_icdGetInstanceProcAddr(void* instance, const char* name) {
+    return nullptr;
+}
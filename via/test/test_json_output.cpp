@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "via_test.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+// Whether every sequence in text is well-formed UTF-8, as RFC 3629 defines it
+static bool IsValidUtf8(const std::string& text) {
+    for (size_t pos = 0; pos < text.size();) {
+        const unsigned char lead = static_cast<unsigned char>(text[pos]);
+        size_t length = 1;
+        unsigned int code_point = lead;
+        if (lead >= 0xf0 && lead <= 0xf4) {
+            length = 4;
+            code_point = lead & 0x07;
+        } else if (lead >= 0xe0) {
+            length = (lead <= 0xef) ? 3 : 0;
+            code_point = lead & 0x0f;
+        } else if (lead >= 0xc2) {
+            length = 2;
+            code_point = lead & 0x1f;
+        } else if (lead >= 0x80) {
+            length = 0;
+        }
+        if (length == 0 || text.size() - pos < length) return false;
+        for (size_t i = 1; i < length; i++) {
+            const unsigned char next = static_cast<unsigned char>(text[pos + i]);
+            if ((next & 0xc0) != 0x80) return false;
+            code_point = (code_point << 6) | (next & 0x3f);
+        }
+        const unsigned int min_code_point[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (code_point < min_code_point[length] || code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff)) {
+            return false;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+static void ExpectValidUtf8(const Json::Value& value, const std::string& where) {
+    if (value.isString()) {
+        EXPECT_TRUE(IsValidUtf8(value.asString())) << where;
+    } else if (value.isArray()) {
+        for (Json::ArrayIndex i = 0; i < value.size(); i++) ExpectValidUtf8(value[i], where + "[" + std::to_string(i) + "]");
+    } else if (value.isObject()) {
+        for (const std::string& member : value.getMemberNames()) ExpectValidUtf8(value[member], where + "." + member);
+    }
+}
+
+// The report value on the row named name in the rows of the driver a manifest describes
+static std::string ReportedDriverValue(const Json::Value& report, const std::string& manifest_file_name,
+                                       const std::string& name) {
+    for (const Json::Value& section : report["sections"]) {
+        for (const Json::Value& item : section["items"]) {
+            const Json::Value& rows = item["rows"];
+            for (Json::ArrayIndex row = 0; item["table"].asString() == "Vulkan Driver Info" && row < rows.size(); row++) {
+                if (rows[row][1].asString() != manifest_file_name) continue;
+                for (row++; row < rows.size() && rows[row][0].asString().empty(); row++) {
+                    if (rows[row][1].asString() == name) return rows[row][2].asString();
+                }
+                return "";
+            }
+        }
+    }
+    return "";
+}
+
+TEST(test_json_output, report_parses_with_escaped_strings) {
+    ViaTestSysroot sysroot;
+    ASSERT_TRUE(sysroot.Created());
+
+    // The manifest's strings come back through jsoncpp, so control characters, quotes and backslashes have to be escaped
+    // again when the report is written
+    sysroot.AddManifest("escapes.json",
+                        "{\"file_format_version\": \"1.0.0\", \"ICD\": {\"library_path\": \"/usr/lib/libnone.so\", "
+                        "\"api_version\": \"quote\\\" backslash\\\\ tab\\t newline\\n bell\\u0007 e\\u00e9\"}}");
+
+    Json::Value report;
+    std::string error;
+    ASSERT_TRUE(sysroot.Analyze(report, error)) << error;
+    EXPECT_EQ("quote\" backslash\\ tab\t newline\n bell\x07 e\xc3\xa9", ReportedDriverValue(report, "escapes.json", "API Version"));
+    ExpectValidUtf8(report, "report");
+}
+
+TEST(test_json_output, invalid_utf8_is_replaced) {
+    ViaTestSysroot sysroot;
+    ASSERT_TRUE(sysroot.Created());
+
+    const std::string manifest =
+        "{\"file_format_version\": \"1.0.0\", \"ICD\": {\"library_path\": \"/usr/lib/libnone.so\", \"api_version\": \"1.2.0\"}}";
+    // File names are bytes, and needn't be UTF-8
+    sysroot.AddManifest("valid_\xc3\xa9\xf0\x9f\x98\x80.json", manifest);
+    sysroot.AddManifest("lone_\xff.json", manifest);
+    sysroot.AddManifest("overlong_\xc0\xaf.json", manifest);
+    sysroot.AddManifest("surrogate_\xed\xa0\x80.json", manifest);
+    sysroot.AddManifest("cut_\xe2\x82.json", manifest);
+
+    Json::Value report;
+    std::string error;
+    ASSERT_TRUE(sysroot.Analyze(report, error)) << error;
+    ExpectValidUtf8(report, "report");
+
+    const std::string replacement = "\xef\xbf\xbd";
+    for (const std::string& manifest_file_name :
+         {std::string("valid_\xc3\xa9\xf0\x9f\x98\x80.json"), "lone_" + replacement + ".json",
+          "overlong_" + replacement + replacement + ".json", "surrogate_" + replacement + replacement + replacement + ".json",
+          "cut_" + replacement + replacement + ".json"}) {
+        EXPECT_EQ("1.2.0", ReportedDriverValue(report, manifest_file_name, "API Version")) << manifest_file_name;
+    }
+}
+
+TEST(test_json_output, failed_external_test_keeps_report_valid) {
+    ViaTestSysroot sysroot;
+    ASSERT_TRUE(sysroot.Created());
+
+    // A cube that fails even its plain run leaves the external tests with nothing but the failure to report, and the
+    // sections after it have to be written into the same report
+    sysroot.AddSdkExecutable("vkcube", "#!/bin/sh\nexit 3\n");
+
+    Json::Value report;
+    std::string error;
+    ASSERT_TRUE(sysroot.AnalyzeWithSdk(report, error)) << error;
+
+    bool found_failure = false;
+    bool found_later_section = false;
+    for (const Json::Value& section : report["sections"]) {
+        ASSERT_TRUE(section.isObject());
+        if (found_failure) found_later_section = true;
+        if (section["name"].asString() != "External Tests") continue;
+        for (const Json::Value& item : section["items"]) {
+            if (item["table"].asString() != "Cube") continue;
+            ASSERT_EQ(1u, item["rows"].size());
+            EXPECT_EQ("Failed to find either 'vkcube' or 'cube' executables", item["rows"][0][0].asString());
+            EXPECT_EQ("FAILURE", item["rows"][0][1].asString());
+            found_failure = true;
+        }
+    }
+    EXPECT_TRUE(found_failure);
+    EXPECT_TRUE(found_later_section);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Stand-in for the Vulkan loader, preloaded into vkvia so the tests that analyze this machine get past the Vulkan
+// calls without a GPU.  It reports one device, and defines every loader function vkvia calls.
+
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+static int test_handles[3];
+
+static VkResult VKAPI_CALL EnumerateInstanceVersion(uint32_t* api_version) {
+    *api_version = VK_MAKE_VERSION(1, 2, 0);
+    return VK_SUCCESS;
+}
+
+extern "C" {
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char* name) {
+    if (strcmp(name, "vkEnumerateInstanceVersion") == 0) {
+        return reinterpret_cast<PFN_vkVoidFunction>(EnumerateInstanceVersion);
+    }
+    return nullptr;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo* create_info, const VkAllocationCallbacks* allocator,
+                                                VkInstance* instance) {
+    *instance = reinterpret_cast<VkInstance>(&test_handles[0]);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance, const VkAllocationCallbacks* allocator) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(const char* layer_name, uint32_t* count,
+                                                                      VkExtensionProperties* properties) {
+    *count = 0;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumeratePhysicalDevices(VkInstance instance, uint32_t* count, VkPhysicalDevice* devices) {
+    if (devices != nullptr) {
+        devices[0] = reinterpret_cast<VkPhysicalDevice>(&test_handles[1]);
+    }
+    *count = 1;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice device, VkPhysicalDeviceProperties* properties) {
+    memset(properties, 0, sizeof(*properties));
+    properties->apiVersion = VK_MAKE_VERSION(1, 2, 0);
+    properties->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+    strcpy(properties->deviceName, "vkvia test device");
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice device, uint32_t* count,
+                                                                    VkQueueFamilyProperties* properties) {
+    if (properties != nullptr) {
+        memset(properties, 0, sizeof(*properties));
+        properties->queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+        properties->queueCount = 1;
+    }
+    *count = 1;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice device,
+                                                               VkPhysicalDeviceMemoryProperties* properties) {
+    memset(properties, 0, sizeof(*properties));
+    properties->memoryHeapCount = 1;
+    properties->memoryHeaps[0].size = 1ull << 30;
+    properties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    properties->memoryTypeCount = 1;
+    properties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice device, const char* layer_name,
+                                                                    uint32_t* count, VkExtensionProperties* properties) {
+    *count = 0;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice physical_device, const VkDeviceCreateInfo* create_info,
+                                              const VkAllocationCallbacks* allocator, VkDevice* device) {
+    *device = reinterpret_cast<VkDevice>(&test_handles[2]);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, const VkAllocationCallbacks* allocator) {}
+
+}  // extern "C"
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2020 Valve Corporation
+ * Copyright (c) 2020 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Helpers for the vkvia tests, which lay out a sysroot with the drivers under test, run vkvia on it with --sysroot and
+// read back its JSON report.
+
+#pragma once
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <json/json.h>
+
+inline std::string ReadTestFile(const std::string& file) {
+    std::ifstream stream(file.c_str(), std::ifstream::in | std::ifstream::binary);
+    return std::string((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+}
+
+inline void WriteTestFile(const std::string& file, const std::string& contents) {
+    std::ofstream stream(file.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    stream << contents;
+}
+
+class ViaTestSysroot {
+   public:
+    ViaTestSysroot() {
+        const char* tmp_dir = getenv("TMPDIR");
+        std::string folder_template = (tmp_dir != nullptr && tmp_dir[0] != '\0') ? tmp_dir : "/tmp";
+        folder_template += "/vkvia_test_XXXXXX";
+        if (mkdtemp(&folder_template[0]) != nullptr) {
+            _folder = folder_template;
+            _root = _folder + "/root";
+            for (const char* sub_folder : {"/root", "/root/etc", "/root/etc/vulkan", "/root/etc/vulkan/icd.d", "/root/usr",
+                                           "/root/usr/lib"}) {
+                mkdir((_folder + sub_folder).c_str(), 0700);
+            }
+            WriteTestFile(_root + "/etc/os-release", "NAME=\"vkvia test\"\n");
+        }
+    }
+
+    ~ViaTestSysroot() {
+        if (!_folder.empty()) {
+            nftw(_folder.c_str(), [](const char* path, const struct stat*, int, struct FTW*) { return remove(path); }, 16,
+                 FTW_DEPTH | FTW_PHYS);
+        }
+    }
+
+    bool Created() const { return !_folder.empty(); }
+
+    // Installs a driver library holding library_contents as /usr/lib/lib<name>.so, along with its manifest
+    // /etc/vulkan/icd.d/<name>.json
+    void AddDriver(const std::string& name, const std::string& library_contents) {
+        WriteTestFile(_root + "/usr/lib/lib" + name + ".so", library_contents);
+        AddManifest(name + ".json",
+                    "{\"file_format_version\": \"1.0.0\", \"ICD\": {\"library_path\": \"/usr/lib/lib" + name +
+                        ".so\", \"api_version\": \"1.2.0\"}}");
+    }
+
+    void AddManifest(const std::string& file_name, const std::string& contents) {
+        WriteTestFile(_root + "/etc/vulkan/icd.d/" + file_name, contents);
+    }
+
+    // Installs an executable script as <folder>/sdk/bin/<name>, in an SDK that AnalyzeWithSdk() points vkvia at
+    void AddSdkExecutable(const std::string& name, const std::string& script) {
+        for (const char* sub_folder : {"/sdk", "/sdk/bin", "/sdk/etc", "/sdk/etc/explicit_layer.d"}) {
+            mkdir((_folder + sub_folder).c_str(), 0700);
+        }
+        WriteTestFile(_folder + "/sdk/bin/" + name, script);
+        chmod((_folder + "/sdk/bin/" + name).c_str(), 0700);
+    }
+
+    // Runs vkvia on the sysroot and parses its JSON report.  Fails if vkvia doesn't exit by itself, which a crash on
+    // one of the drivers would show up as, or if the report isn't valid JSON.
+    bool Analyze(Json::Value& report, std::string& error) const {
+        return RunVia("HOME=/nonexistent", "--sysroot '" + _root + "'", report, error);
+    }
+
+    // Runs vkvia on this machine rather than the sysroot, which is the only way it gets to its external tests.  The
+    // test loader stands in for the Vulkan loader, the test driver is the only driver, and the SDK is the one
+    // AddSdkExecutable() fills in.
+    bool AnalyzeWithSdk(Json::Value& report, std::string& error) const {
+        mkdir((_folder + "/drivers").c_str(), 0700);
+        WriteTestFile(_folder + "/drivers/test_icd.json",
+                      std::string("{\"file_format_version\": \"1.0.0\", \"ICD\": {\"library_path\": \"") + TEST_ICD_PATH +
+                          "\", \"api_version\": \"1.2.0\"}}");
+        return RunVia("-u VK_SDK_PATH HOME=/nonexistent VK_DRIVERS_PATH='" + _folder + "/drivers' VULKAN_SDK='" + _folder +
+                          "/sdk' LD_PRELOAD='" + TEST_LOADER_PATH + "'",
+                      "", report, error);
+    }
+
+   private:
+    bool RunVia(const std::string& environment, const std::string& arguments, Json::Value& report, std::string& error) const {
+        const std::string report_file = _folder + "/report.json";
+        const std::string command = "cd '" + _folder + "' && env -u VK_DRIVERS_PATH -u VK_ICD_FILENAMES -u VK_LAYER_PATH " +
+                                    environment + " '" + VKVIA_PATH + "' " + arguments + " --no-cache --json_output --output '" +
+                                    report_file + "' > /dev/null 2>&1";
+        int status = system(command.c_str());
+        if (status == -1 || !WIFEXITED(status)) {
+            error = "vkvia did not exit normally";
+            return false;
+        }
+        std::string report_text = ReadTestFile(report_file);
+        Json::Reader reader(Json::Features::strictMode());
+        report = Json::nullValue;
+        if (!reader.parse(report_text, report, false) || !report.isObject()) {
+            error = "The report doesn't parse: " + reader.getFormattedErrorMessages();
+            return false;
+        }
+        return true;
+    }
+
+    std::string _folder;
+    std::string _root;
+};
+
+// Finds the driver described by a manifest in the report's driver table.  error is what vkvia reported when the driver
+// couldn't be loaded, or empty when it could.
+inline bool FindReportedDriver(const Json::Value& report, const std::string& manifest_file_name, std::string& error) {
+    for (const Json::Value& section : report["sections"]) {
+        for (const Json::Value& item : section["items"]) {
+            if (item["table"].asString() != "Vulkan Driver Info") {
+                continue;
+            }
+            const Json::Value& rows = item["rows"];
+            for (Json::ArrayIndex row = 0; row < rows.size(); row++) {
+                if (rows[row][1].asString() != manifest_file_name) {
+                    continue;
+                }
+                error.clear();
+                // The driver's own rows start with an empty element, and the next driver or folder row doesn't
+                for (row++; row < rows.size() && rows[row][0].asString().empty(); row++) {
+                    if (rows[row][1].asString() == "FAILED TO LOAD!") {
+                        error = rows[row][2].asString();
+                    }
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -17,19 +17,41 @@
  * Author: Mark Young <marky@lunarg.com>
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <deque>
+#include <future>
 #include <map>
+#include <thread>
 
 #include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef VIA_WINDOWS_TARGET
+#include <io.h>
+#include <process.h>
+#include <sys/locking.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
 #include <vulkan/vulkan.h>
 
 #include "via_system.hpp"
 
+thread_local ViaSystem::SectionRecording* ViaSystem::_recording = nullptr;
+
 ViaSystem::ViaSystem() {
     _generate_unique_file = false;
     _out_file = "";
+    _out_stream = &_out_ofstream;
     _directory_symbol = '/';
     _home_path = "~/";
     _app_version = "Version 1.3";
@@ -37,8 +59,11 @@ ViaSystem::ViaSystem() {
 
 bool ViaSystem::Init(int argc, char** argv) {
     char* output_path = nullptr;
+    char* output_file = nullptr;
     // Check and handle command-line arguments
     _run_cube_tests = true;
+    _use_scan_cache = true;
+    _print_timing_summary = false;
     _out_file_format = VIA_HTML_FORMAT;
     if (argc > 1) {
         for (int iii = 1; iii < argc; iii++) {
@@ -51,12 +76,29 @@ bool ViaSystem::Init(int argc, char** argv) {
                 _run_cube_tests = false;
             } else if (0 == strcmp("--vkconfig_output", argv[iii])) {
                 _out_file_format = VIA_VKCONFIG_FORMAT;
+            } else if (0 == strcmp("--json_output", argv[iii])) {
+                _out_file_format = VIA_JSON_FORMAT;
+            } else if (0 == strcmp("--output", argv[iii]) && argc > (iii + 1)) {
+                output_file = argv[iii + 1];
+                ++iii;
+            } else if (0 == strcmp("--no-cache", argv[iii])) {
+                _use_scan_cache = false;
+            } else if (0 == strcmp("--timing_summary", argv[iii])) {
+                _print_timing_summary = true;
+            } else if (0 == strcmp("--sysroot", argv[iii]) && argc > (iii + 1)) {
+                _sysroot = argv[iii + 1];
+                ++iii;
             } else {
                 std::cout << "Usage of " << argv[0] << ":" << std::endl
                           << "    " << argv[0]
                           << " [--unique_output] "
                              "[--output_path <path>]"
+                             " [--output <file>]"
+                             " [--json_output]"
                              " [--disable_cube_tests]"
+                             " [--no-cache]"
+                             " [--sysroot <dir>]"
+                             " [--timing_summary]"
                           << std::endl
                           << "          [--unique_output] Optional "
                              "parameter to generate a unique html"
@@ -71,14 +113,63 @@ bool ViaSystem::Init(int argc, char** argv) {
                           << "                               "
                              "  a given path"
                           << std::endl
+                          << "          [--output <file>] Optional parameter to write the output to the given file, or to "
+                             "standard"
+                          << std::endl
+                          << "                            output if the file is \'-\'"
+                          << std::endl
+                          << "          [--json_output] Optional parameter to write a JSON report with the same sections and "
+                             "tables"
+                          << std::endl
+                          << "                          as the HTML one"
+                          << std::endl
                           << "          [--disable_cube_tests] Optional parameter to disable running cube to test the Vulkan SDK "
                              "installation."
+                          << std::endl
+                          << "          [--no-cache] Optional parameter to check every driver library again instead of "
+                             "reusing"
+                          << std::endl
+                          << "                       the results of earlier runs for files that have not changed."
+                          << std::endl
+                          << "          [--sysroot <dir>] Optional parameter to analyze the system installed under <dir>, such "
+                             "as an"
+                          << std::endl
+                          << "                            unpacked container image, instead of this one.  No Vulkan "
+                             "instance is"
+                          << std::endl
+                          << "                            created and the external tests aren't run."
+                          << std::endl
+                          << "          [--timing_summary] Optional parameter to print how long each stage took, slowest "
+                             "first, when"
+                          << std::endl
+                          << "                             done.  The times are always included in the output file."
                           << std::endl;
                 return false;
             }
         }
     }
 
+    // Offline analysis only looks at files, since nothing in the sysroot can run on this machine's driver
+    if (!_sysroot.empty()) {
+#ifdef VIA_LINUX_TARGET
+        while (_sysroot.size() > 1 && _sysroot[_sysroot.size() - 1] == '/') {
+            _sysroot.erase(_sysroot.size() - 1);
+        }
+        struct stat sysroot_stat;
+        if (0 != stat(_sysroot.c_str(), &sysroot_stat) || !S_ISDIR(sysroot_stat.st_mode)) {
+            LogError("Sysroot " + _sysroot + " is not a folder");
+            return false;
+        }
+        if (_sysroot == "/") {
+            _sysroot.clear();
+        }
+        _run_cube_tests = false;
+#else
+        LogError("--sysroot is only supported on Linux");
+        return false;
+#endif
+    }
+
     // If the user wants a specific output path, write it to the buffer
     // and then continue writing the rest of the name below
     std::string file_path = "";
@@ -113,24 +204,38 @@ bool ViaSystem::Init(int argc, char** argv) {
         time(&time_raw_format);
         tm* ptr_time = localtime(&time_raw_format);
         char time_date_filename[512];
-        if (strftime(time_date_filename, 511, "_%Y_%m_%d_%H_%M.html", ptr_time) == 0) {
+        if (strftime(time_date_filename, 511, "_%Y_%m_%d_%H_%M", ptr_time) == 0) {
             LogError("Couldn't generate unique HTML file name for output");
             return false;
         }
         _out_file += time_date_filename;
-    } else {
-        if (_out_file_format == VIA_HTML_FORMAT) {
-            _out_file += ".html";
-        } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
-            _out_file += ".json";
+    }
+    if (_out_file_format == VIA_HTML_FORMAT) {
+        _out_file += ".html";
+    } else if (_out_file_format == VIA_VKCONFIG_FORMAT || _out_file_format == VIA_JSON_FORMAT) {
+        _out_file += ".json";
+    }
+
+    // An explicit output file, or standard output, replaces the generated name
+    if (output_file != NULL) {
+        if (0 == strcmp("-", output_file)) {
+            _out_stream = &std::cout;
+        } else {
+            _out_ofstream.open(output_file);
+            if (_out_ofstream.fail()) {
+                LogError(std::string("Failed creating output file ") + output_file);
+                return false;
+            }
         }
     }
 
     // Write the output file to the current executing directory, or, if
     // that fails, write it out to the user's home folder.
     std::string full_out_path = file_path + _out_file;
-    _out_ofstream.open(full_out_path);
-    if (_out_ofstream.fail()) {
+    if (output_file == NULL) {
+        _out_ofstream.open(full_out_path);
+    }
+    if (output_file == NULL && _out_ofstream.fail()) {
         full_out_path = _home_path + _out_file;
         _out_ofstream.open(full_out_path);
         if (_out_ofstream.fail()) {
@@ -155,29 +260,82 @@ bool ViaSystem::Init(int argc, char** argv) {
 }
 
 bool ViaSystem::GenerateInfo() {
+    std::vector<SectionGenerator> generators(VIA_SECTION_COUNT);
+    std::vector<std::vector<uint32_t>> chains;
+    std::vector<SectionRecording> recordings;
+    ViaResults results;
+
+    generators[VIA_SECTION_ENVIRONMENT] =
+        TimedGenerator("PrintSystemEnvironmentInfo", [this]() { return PrintSystemEnvironmentInfo(); });
+    generators[VIA_SECTION_HARDWARE] = TimedGenerator("PrintSystemHardwareInfo", [this]() { return PrintSystemHardwareInfo(); });
+    generators[VIA_SECTION_EXECUTABLE] =
+        TimedGenerator("PrintSystemExecutableInfo", [this]() { return PrintSystemExecutableInfo(); });
+    generators[VIA_SECTION_DRIVER] = TimedGenerator("PrintSystemDriverInfo", [this]() { return PrintSystemDriverInfo(); });
+    generators[VIA_SECTION_LOADER] = TimedGenerator("PrintSystemLoaderInfo", [this]() { return PrintSystemLoaderInfo(); });
+    generators[VIA_SECTION_SDK] = TimedGenerator("PrintSystemSdkInfo", [this]() { return PrintSystemSdkInfo(); });
+    generators[VIA_SECTION_IMPLICIT_LAYER] =
+        TimedGenerator("PrintSystemImplicitLayerInfo", [this]() { return PrintSystemImplicitLayerInfo(); });
+    generators[VIA_SECTION_EXPLICIT_LAYER] =
+        TimedGenerator("PrintSystemExplicitLayerInfo", [this]() { return PrintSystemExplicitLayerInfo(); });
+    generators[VIA_SECTION_SETTINGS_FILE] =
+        TimedGenerator("PrintSystemSettingsFileInfo", [this]() { return PrintSystemSettingsFileInfo(); });
+    generators[VIA_SECTION_VULKAN] = TimedGenerator("GenerateVulkanInfo", [this]() { return GenerateVulkanInfo(); });
+
+    // Sections that use what an earlier one found are chained after it: the SDK check looks at the OS name from the
+    // environment section, and the explicit layers include the override paths found with the implicit layers.  The
+    // Vulkan calls run alongside the system scan, but are still left out of the report if the scan fails.
+    if (_sysroot.empty()) {
+        chains.push_back({VIA_SECTION_VULKAN});
+    }
+    chains.push_back({VIA_SECTION_DRIVER});
+    chains.push_back({VIA_SECTION_IMPLICIT_LAYER, VIA_SECTION_EXPLICIT_LAYER});
+    chains.push_back({VIA_SECTION_ENVIRONMENT, VIA_SECTION_SDK});
+    chains.push_back({VIA_SECTION_LOADER});
+    chains.push_back({VIA_SECTION_HARDWARE});
+    chains.push_back({VIA_SECTION_EXECUTABLE});
+    chains.push_back({VIA_SECTION_SETTINGS_FILE});
+    if (_use_scan_cache) {
+        LoadScanCache();
+    }
+    auto scan_start = std::chrono::steady_clock::now();
+    RecordSections(generators, chains, recordings);
+    RecordTiming("All sections (wall clock)", scan_start);
+    if (_use_scan_cache) {
+        SaveScanCache();
+    }
+
     StartOutput("LunarG VIA");
-    ViaResults results = GenerateSystemInfo();
-    if (results != VIA_SUCCESSFUL) {
+    results = GenerateSystemInfo(recordings);
+    if (results != VIA_SUCCESSFUL || !_sysroot.empty()) {
         goto print_results;
     }
-    results = GenerateVulkanInfo();
+    WriteSection(recordings[VIA_SECTION_VULKAN]);
+    results = recordings[VIA_SECTION_VULKAN].result;
     if (results != VIA_SUCCESSFUL) {
         goto print_results;
     }
 
     if (_run_cube_tests) {
+        auto tests_start = std::chrono::steady_clock::now();
         results = GenerateTestInfo();
+        RecordTiming("GenerateTestInfo", tests_start);
         if (results != VIA_SUCCESSFUL) {
             goto print_results;
         }
     }
 
 print_results:
+    GenerateTimingInfo();
     EndOutput();
 
     // Print out a useful message for any common errors.
     switch (results) {
         case VIA_SUCCESSFUL: {
+            if (!_sysroot.empty()) {
+                std::cerr << "SUCCESS: Vulkan analysis of sysroot " << _sysroot
+                          << " completed, without creating an instance" << std::endl;
+                break;
+            }
             std::string vulkan_version_string = "Vulkan ";
             vulkan_version_string += std::to_string(_vulkan_max_info.desired_api_version.major);
             vulkan_version_string += ".";
@@ -240,16 +398,118 @@ print_results:
             break;
     }
 
+    if (_print_timing_summary) {
+        PrintTimingSummary();
+    }
+
     return (results == VIA_SUCCESSFUL);
 }
 
 ViaSystem::~ViaSystem() { _out_ofstream.close(); }
 
-void ViaSystem::LogError(const std::string& error) { std::cerr << "VIA_ERROR:   " << error << std::endl; }
+void ViaSystem::LogError(const std::string& error) {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_LOG_ERROR, error);
+        return;
+    }
+    std::cerr << "VIA_ERROR:   " << error << std::endl;
+}
 
-void ViaSystem::LogWarning(const std::string& warning) { std::cerr << "VIA_WARNING: " << warning << std::endl; }
+void ViaSystem::LogWarning(const std::string& warning) {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_LOG_WARNING, warning);
+        return;
+    }
+    std::cerr << "VIA_WARNING: " << warning << std::endl;
+}
 
-void ViaSystem::LogInfo(const std::string& info) { std::cerr << "VIA_INFO:    " << info << std::endl; }
+void ViaSystem::LogInfo(const std::string& info) {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_LOG_INFO, info);
+        return;
+    }
+    std::cerr << "VIA_INFO:    " << info << std::endl;
+}
+
+// Symbolic links in the sysroot are followed the way they would be on the system being analyzed: an absolute target
+// starts again from the sysroot, and ".." stops at it, so no link can lead out to the files of this machine.  Every
+// link in the returned path has already been followed.  A path with more links than Linux follows comes back empty.
+std::string ViaSystem::InSysroot(const std::string& path) const {
+    if (_sysroot.empty() || path.empty() || path[0] != '/') {
+        return path;
+    }
+#ifdef VIA_LINUX_TARGET
+    const int max_links = 40;
+    int links = 0;
+    std::vector<std::string> resolved;
+    std::deque<std::string> pending;
+    auto push_components = [&pending](const std::string& link_path) {
+        std::deque<std::string> components;
+        std::stringstream stream(link_path);
+        std::string component;
+        while (std::getline(stream, component, '/')) {
+            components.push_back(component);
+        }
+        pending.insert(pending.begin(), components.begin(), components.end());
+    };
+    auto resolved_path = [this, &resolved]() {
+        std::string host_path = _sysroot;
+        for (const std::string& component : resolved) {
+            host_path += "/" + component;
+        }
+        return host_path;
+    };
+
+    push_components(path);
+    while (!pending.empty()) {
+        std::string component = pending.front();
+        pending.pop_front();
+        if (component.empty() || component == ".") {
+            continue;
+        }
+        if (component == "..") {
+            if (!resolved.empty()) {
+                resolved.pop_back();
+            }
+            continue;
+        }
+        resolved.push_back(component);
+
+        // Anything that isn't a link, including a file that doesn't exist, is kept as it is
+        char target[4096];
+        ssize_t len = readlink(resolved_path().c_str(), target, sizeof(target) - 1);
+        if (len <= 0) {
+            continue;
+        }
+        if (++links > max_links) {
+            return "";
+        }
+        target[len] = '\0';
+        resolved.pop_back();
+        if (target[0] == '/') {
+            resolved.clear();
+        }
+        push_components(target);
+    }
+
+    std::string host_path = resolved_path();
+    if (path[path.size() - 1] == '/') {
+        host_path += '/';
+    }
+    return host_path;
+#else
+    return _sysroot + path;
+#endif
+}
+
+// Paths made by appending names to a folder InSysroot returned may end in a link of their own, so they are resolved
+// again before they are opened.  Paths outside the sysroot are returned as they are.
+std::string ViaSystem::StayInSysroot(const std::string& host_path) const {
+    if (_sysroot.empty() || host_path.compare(0, _sysroot.size() + 1, _sysroot + "/") != 0) {
+        return host_path;
+    }
+    return InSysroot(host_path.substr(_sysroot.size()));
+}
 
 bool ViaSystem::IsAbsolutePath(const std::string& path) {
     if (path[0] == _directory_symbol) {
@@ -265,7 +525,7 @@ bool ViaSystem::DetermineJsonLibraryPath(const std::string& json_location, const
     // Determine if the library is relative or absolute.  If it's absolute,
     // then just use the path.
     if (IsAbsolutePath(json_library_info)) {
-        library_location = json_library_info;
+        library_location = InSysroot(json_library_info);
         success = true;
     } else {
         std::string final_path = json_location;
@@ -300,46 +560,17 @@ bool ViaSystem::DetermineJsonLibraryPath(const std::string& json_location, const
     return success;
 }
 
-ViaSystem::ViaResults ViaSystem::GenerateSystemInfo() {
+// Write out the system sections recorded by RecordSections
+ViaSystem::ViaResults ViaSystem::GenerateSystemInfo(const std::vector<SectionRecording>& recordings) {
     ViaResults overall_result = VIA_SUCCESSFUL;
 
     BeginSection("System Info");
 
-    ViaResults result = PrintSystemEnvironmentInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
-    }
-    result = PrintSystemHardwareInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
-    }
-    result = PrintSystemExecutableInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
-    }
-    result = PrintSystemDriverInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
-    }
-    result = PrintSystemLoaderInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
-    }
-    result = PrintSystemSdkInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
-    }
-    result = PrintSystemImplicitLayerInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
-    }
-    result = PrintSystemExplicitLayerInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
-    }
-    result = PrintSystemSettingsFileInfo();
-    if (VIA_SUCCESSFUL != result) {
-        overall_result = result;
+    for (uint32_t section = VIA_SECTION_ENVIRONMENT; section <= VIA_SECTION_SETTINGS_FILE; section++) {
+        WriteSection(recordings[section]);
+        if (VIA_SUCCESSFUL != recordings[section].result) {
+            overall_result = recordings[section].result;
+        }
     }
 
     EndSection();
@@ -440,7 +671,9 @@ ViaSystem::ViaResults ViaSystem::GenerateInstanceInfo(void) {
     // Create a 1.0 instance
     PrintBeginTableRow();
     PrintTableElement("vkCreateInstance [1.0]");
+    auto create_start = std::chrono::steady_clock::now();
     status = vkCreateInstance(&inst_info, NULL, &_vulkan_1_0_info.vk_instance);
+    RecordTiming("vkCreateInstance [1.0]", create_start);
     _vulkan_1_0_info.desired_api_version.major = 1;
     _vulkan_1_0_info.desired_api_version.minor = 0;
     _vulkan_1_0_info.desired_api_version.patch = 0;
@@ -464,10 +697,13 @@ ViaSystem::ViaResults ViaSystem::GenerateInstanceInfo(void) {
     if (nullptr != pfn_inst_version) {
         app_info.apiVersion = VK_MAKE_VERSION(max_inst_api_version.major, max_inst_api_version.minor, 0);
         _vulkan_max_info.max_api_version = max_inst_api_version;
+        std::string create_call = "vkCreateInstance [" + std::to_string(max_inst_api_version.major) + "." +
+                                  std::to_string(max_inst_api_version.minor) + "]";
         PrintBeginTableRow();
-        PrintTableElement("vkCreateInstance [" + std::to_string(max_inst_api_version.major) + "." +
-                          std::to_string(max_inst_api_version.minor) + "]");
+        PrintTableElement(create_call);
+        create_start = std::chrono::steady_clock::now();
         status = vkCreateInstance(&inst_info, NULL, &_vulkan_max_info.vk_instance);
+        RecordTiming(create_call, create_start);
         if (status == VK_ERROR_INCOMPATIBLE_DRIVER) {
             PrintTableElement("ERROR: Incompatible Driver");
             res = VIA_VULKAN_CANT_FIND_DRIVER;
@@ -516,7 +752,9 @@ ViaSystem::ViaResults ViaSystem::GeneratePhysDevInfo(void) {
 
     PrintBeginTableRow();
     PrintTableElement("vkEnumeratePhysicalDevices [1.0]");
+    auto enumerate_start = std::chrono::steady_clock::now();
     status = vkEnumeratePhysicalDevices(_vulkan_1_0_info.vk_instance, &gpu_count, NULL);
+    RecordTiming("vkEnumeratePhysicalDevices [1.0]", enumerate_start);
     if (status) {
         snprintf(generic_string, 1023, "ERROR: Failed to query - %d", status);
         PrintTableElement(generic_string);
@@ -535,7 +773,9 @@ ViaSystem::ViaResults ViaSystem::GeneratePhysDevInfo(void) {
 
     min_phys_devices.resize(gpu_count);
     _vulkan_1_0_info.vk_physical_devices.resize(gpu_count);
+    enumerate_start = std::chrono::steady_clock::now();
     status = vkEnumeratePhysicalDevices(_vulkan_1_0_info.vk_instance, &gpu_count, min_phys_devices.data());
+    RecordTiming("vkEnumeratePhysicalDevices [1.0]", enumerate_start);
     if (VK_SUCCESS != status && VK_INCOMPLETE != status) {
         PrintBeginTableRow();
         PrintTableElement("");
@@ -925,10 +1165,13 @@ ViaSystem::ViaResults ViaSystem::GeneratePhysDevInfo(void) {
     // to the minimum of the instance version and the highest phsycial device version.
     if (_vulkan_max_info.vk_instance != VK_NULL_HANDLE &&
         (_vulkan_max_info.max_api_version.major > 1 || _vulkan_max_info.max_api_version.minor >= 1)) {
+        std::string enumerate_call = "vkEnumeratePhysicalDevices [" + std::to_string(_vulkan_max_info.max_api_version.major) +
+                                     "." + std::to_string(_vulkan_max_info.max_api_version.minor) + "]";
         PrintBeginTableRow();
-        PrintTableElement("vkEnumeratePhysicalDevices [" + std::to_string(_vulkan_max_info.max_api_version.major) + "." +
-                          std::to_string(_vulkan_max_info.max_api_version.minor) + "]");
+        PrintTableElement(enumerate_call);
+        enumerate_start = std::chrono::steady_clock::now();
         status = vkEnumeratePhysicalDevices(_vulkan_max_info.vk_instance, &gpu_count, NULL);
+        RecordTiming(enumerate_call, enumerate_start);
         if (status) {
             snprintf(generic_string, 1023, "ERROR: Failed to query - %d", status);
             PrintTableElement(generic_string);
@@ -940,7 +1183,9 @@ ViaSystem::ViaResults ViaSystem::GeneratePhysDevInfo(void) {
         }
 
         max_phys_devices.resize(gpu_count);
+        enumerate_start = std::chrono::steady_clock::now();
         status = vkEnumeratePhysicalDevices(_vulkan_max_info.vk_instance, &gpu_count, max_phys_devices.data());
+        RecordTiming(enumerate_call, enumerate_start);
         if (VK_SUCCESS != status && VK_INCOMPLETE != status) {
             PrintTableElement("Failed to enumerate physical devices!");
             PrintTableElement("");
@@ -1017,6 +1262,7 @@ ViaSystem::ViaResults ViaSystem::GenerateLogicalDeviceInfo() {
     uint32_t dev_count;
     char generic_string[1024];
     bool found_driver = false;
+    std::string create_call;
 
     PrintBeginTable("Logical Devices", 3);
 
@@ -1026,7 +1272,8 @@ ViaSystem::ViaResults ViaSystem::GenerateLogicalDeviceInfo() {
         if (vers_index == 0) {
             PrintBeginTableRow();
             vulkan_info = &_vulkan_1_0_info;
-            PrintTableElement("vkCreateDevice [1.0]");
+            create_call = "vkCreateDevice [1.0]";
+            PrintTableElement(create_call);
         } else {
             vulkan_info = &_vulkan_max_info;
             if (VK_NULL_HANDLE == vulkan_info->vk_instance || 0 >= vulkan_info->vk_physical_devices.size() ||
@@ -1036,7 +1283,8 @@ ViaSystem::ViaResults ViaSystem::GenerateLogicalDeviceInfo() {
             PrintBeginTableRow();
             snprintf(generic_string, 1023, "vkCreateDevice [%d.%d]", vulkan_info->max_api_version.major,
                      vulkan_info->max_api_version.minor);
-            PrintTableElement(generic_string);
+            create_call = generic_string;
+            PrintTableElement(create_call);
         }
         std::vector<VulkanPhysicalDeviceInfo>& phys_devices = vulkan_info->vk_physical_devices;
         dev_count = (uint32_t)phys_devices.size();
@@ -1083,8 +1331,10 @@ ViaSystem::ViaResults ViaSystem::GenerateLogicalDeviceInfo() {
             snprintf(generic_string, 1023, "[%d]", dev);
             PrintTableElement(generic_string);
 
+            auto create_start = std::chrono::steady_clock::now();
             status =
                 vkCreateDevice(phys_devices[dev].vk_phys_dev, &device_create_info, NULL, &vulkan_info->vk_logical_devices[dev]);
+            RecordTiming(create_call + " device " + generic_string, create_start);
             if (VK_ERROR_INCOMPATIBLE_DRIVER == status) {
                 PrintTableElement("FAILED: Incompatible Driver");
                 if (!found_driver) {
@@ -1225,6 +1475,8 @@ void ViaSystem::StartOutput(const std::string& title) {
         StartOutputHTML(title);
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         StartOutputVkConfig(title);
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        StartOutputJson(title);
     }
 }
 
@@ -1234,71 +1486,547 @@ void ViaSystem::EndOutput() {
         EndOutputHTML();
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         EndOutputVkConfig();
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        EndOutputJson();
     }
+    _out_stream->flush();
 }
 
 void ViaSystem::BeginSection(const std::string& section_str) {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_BEGIN_SECTION, section_str);
+        return;
+    }
     if (_out_file_format == VIA_HTML_FORMAT) {
         BeginSectionHTML(section_str);
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         BeginSectionVkConfig(section_str);
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        BeginSectionJson(section_str);
     }
 }
 
 void ViaSystem::EndSection() {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_END_SECTION);
+        return;
+    }
     if (_out_file_format == VIA_HTML_FORMAT) {
         EndSectionHTML();
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         EndSectionVkConfig();
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        EndSectionJson();
     }
 }
 
 void ViaSystem::PrintStandardText(const std::string& text_str) {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_STANDARD_TEXT, text_str);
+        return;
+    }
     if (_out_file_format == VIA_HTML_FORMAT) {
         PrintStandardTextHTML(text_str);
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         PrintStandardTextVkConfig(text_str);
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        PrintStandardTextJson(text_str);
     }
 }
 
 void ViaSystem::PrintBeginTable(const std::string& table_name, uint32_t num_cols) {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_BEGIN_TABLE, table_name, num_cols);
+        return;
+    }
     if (_out_file_format == VIA_HTML_FORMAT) {
         PrintBeginTableHTML(table_name, num_cols);
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         PrintBeginTableVkConfig(table_name);
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        PrintBeginTableJson(table_name, num_cols);
     }
 }
 
 void ViaSystem::PrintBeginTableRow() {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_BEGIN_TABLE_ROW);
+        return;
+    }
     if (_out_file_format == VIA_HTML_FORMAT) {
         PrintBeginTableRowHTML();
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         PrintBeginTableRowVkConfig();
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        PrintBeginTableRowJson();
     }
 }
 
 void ViaSystem::PrintTableElement(const std::string& element, ViaElementAlign align) {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_TABLE_ELEMENT, element, align);
+        return;
+    }
     if (_out_file_format == VIA_HTML_FORMAT) {
         PrintTableElementHTML(element, align);
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         PrintTableElementVkConfig(element);
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        PrintTableElementJson(element);
     }
 }
 
 void ViaSystem::PrintEndTableRow() {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_END_TABLE_ROW);
+        return;
+    }
     if (_out_file_format == VIA_HTML_FORMAT) {
         PrintEndTableRowHTML();
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         PrintEndTableRowVkConfig();
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        PrintEndTableRowJson();
     }
 }
 
 void ViaSystem::PrintEndTable() {
+    if (nullptr != _recording) {
+        RecordCall(VIA_RECORDED_END_TABLE);
+        return;
+    }
     if (_out_file_format == VIA_HTML_FORMAT) {
         PrintEndTableHTML();
     } else if (_out_file_format == VIA_VKCONFIG_FORMAT) {
         PrintEndTableVkConfig();
+    } else if (_out_file_format == VIA_JSON_FORMAT) {
+        PrintEndTableJson();
+    }
+}
+
+// Timing methods
+
+// Add the time since start to a stage.  Stages measured more than once, like a Vulkan call made twice to get a count
+// and then the data, add up.  Safe to call from any thread.
+void ViaSystem::RecordTiming(const std::string& stage, std::chrono::steady_clock::time_point start) {
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(_timing_lock);
+    for (StageTiming& timing : _timings) {
+        if (timing.stage == stage) {
+            timing.milliseconds += milliseconds;
+            return;
+        }
+    }
+    StageTiming timing = {stage, milliseconds};
+    _timings.push_back(timing);
+}
+
+// Wrap a section generator so the time it takes is recorded under stage.
+ViaSystem::SectionGenerator ViaSystem::TimedGenerator(const std::string& stage, const SectionGenerator& generator) {
+    return [this, stage, generator]() {
+        auto start = std::chrono::steady_clock::now();
+        ViaResults result = generator();
+        RecordTiming(stage, start);
+        return result;
+    };
+}
+
+// The recorded stages, slowest first.
+std::vector<ViaSystem::StageTiming> ViaSystem::SortedTimings() {
+    std::lock_guard<std::mutex> lock(_timing_lock);
+    std::vector<StageTiming> timings = _timings;
+    std::stable_sort(timings.begin(), timings.end(),
+                     [](const StageTiming& a, const StageTiming& b) { return a.milliseconds > b.milliseconds; });
+    return timings;
+}
+
+void ViaSystem::GenerateTimingInfo() {
+    char generic_string[64];
+
+    BeginSection("Timing");
+    PrintStandardText("The system sections are generated at the same time, so their times overlap");
+    PrintBeginTable("Stage Timing", 2);
+    for (const StageTiming& timing : SortedTimings()) {
+        snprintf(generic_string, sizeof(generic_string), "%.1f ms", timing.milliseconds);
+        PrintBeginTableRow();
+        PrintTableElement(timing.stage);
+        PrintTableElement(generic_string);
+        PrintEndTableRow();
+    }
+    PrintEndTable();
+    EndSection();
+}
+
+void ViaSystem::PrintTimingSummary() {
+    char generic_string[256];
+
+    std::cerr << "Stage timing:" << std::endl;
+    for (const StageTiming& timing : SortedTimings()) {
+        snprintf(generic_string, sizeof(generic_string), "    %-48s %10.1f ms", timing.stage.c_str(), timing.milliseconds);
+        std::cerr << generic_string << std::endl;
+    }
+}
+
+// Section methods
+
+// Generate sections on a pool of worker threads, each section recording its print calls instead of writing them
+// to the output file.  Each chain lists sections that have to run one after the other; separate chains run at the
+// same time, so they must not share anything but read-only state.
+void ViaSystem::RecordSections(const std::vector<SectionGenerator>& generators, const std::vector<std::vector<uint32_t>>& chains,
+                               std::vector<SectionRecording>& recordings) {
+    std::atomic<uint32_t> next_chain(0);
+    std::vector<std::thread> workers;
+    uint32_t worker_count = std::max(1U, std::thread::hardware_concurrency());
+    worker_count = std::min(worker_count, static_cast<uint32_t>(chains.size()));
+
+    recordings.clear();
+    recordings.resize(generators.size());
+    for (uint32_t worker = 0; worker < worker_count; worker++) {
+        workers.push_back(std::thread([&]() {
+            for (uint32_t chain = next_chain++; chain < chains.size(); chain = next_chain++) {
+                for (uint32_t section : chains[chain]) {
+                    _recording = &recordings[section];
+                    recordings[section].result = generators[section]();
+                    GenerateDeferredRows();
+                    _recording = nullptr;
+                }
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ViaSystem::RecordCall(ViaRecordedCall call, const std::string& text, uint32_t value) {
+    RecordedCall recorded_call = {call, text, value};
+    _recording->calls.push_back(recorded_call);
+}
+
+// Replay a recorded section's print and log calls, in the order they were made, on the calling thread.
+void ViaSystem::WriteSection(const SectionRecording& recording) {
+    for (const RecordedCall& recorded_call : recording.calls) {
+        switch (recorded_call.call) {
+            case VIA_RECORDED_BEGIN_SECTION:
+                BeginSection(recorded_call.text);
+                break;
+            case VIA_RECORDED_END_SECTION:
+                EndSection();
+                break;
+            case VIA_RECORDED_STANDARD_TEXT:
+                PrintStandardText(recorded_call.text);
+                break;
+            case VIA_RECORDED_BEGIN_TABLE:
+                PrintBeginTable(recorded_call.text, recorded_call.value);
+                break;
+            case VIA_RECORDED_BEGIN_TABLE_ROW:
+                PrintBeginTableRow();
+                break;
+            case VIA_RECORDED_TABLE_ELEMENT:
+                PrintTableElement(recorded_call.text, static_cast<ViaElementAlign>(recorded_call.value));
+                break;
+            case VIA_RECORDED_END_TABLE_ROW:
+                PrintEndTableRow();
+                break;
+            case VIA_RECORDED_END_TABLE:
+                PrintEndTable();
+                break;
+            case VIA_RECORDED_LOG_ERROR:
+                LogError(recorded_call.text);
+                break;
+            case VIA_RECORDED_LOG_WARNING:
+                LogWarning(recorded_call.text);
+                break;
+            case VIA_RECORDED_LOG_INFO:
+                LogInfo(recorded_call.text);
+                break;
+            case VIA_RECORDED_DEFERRED_ROWS:
+                // GenerateDeferredRows replaces these before a section is finished
+                break;
+        }
+    }
+}
+
+// Leave a place in the section being recorded for rows that the generator prints, and run the generator later from
+// GenerateDeferredRows together with the section's other deferred rows.  The generator's result is stored in result
+// once it has run.  Outside of a recording, the generator just runs straight away.
+void ViaSystem::DeferRows(const SectionGenerator& generator, ViaResults* result) {
+    if (nullptr == _recording) {
+        *result = generator();
+        return;
+    }
+    DeferredRows deferred_rows = {generator, result};
+    RecordCall(VIA_RECORDED_DEFERRED_ROWS, "", static_cast<uint32_t>(_recording->deferred.size()));
+    _recording->deferred.push_back(deferred_rows);
+}
+
+// Run all the rows deferred so far in the current section on worker threads, and put what they printed in place.
+void ViaSystem::GenerateDeferredRows() {
+    SectionRecording* recording = _recording;
+    if (nullptr == recording || recording->deferred.empty()) {
+        return;
+    }
+
+    std::vector<SectionGenerator> generators;
+    std::vector<std::vector<uint32_t>> chains;
+    std::vector<SectionRecording> row_recordings;
+    for (uint32_t rows = 0; rows < recording->deferred.size(); rows++) {
+        generators.push_back(recording->deferred[rows].generator);
+        chains.push_back({rows});
+    }
+    RecordSections(generators, chains, row_recordings);
+
+    std::vector<RecordedCall> calls;
+    for (const RecordedCall& recorded_call : recording->calls) {
+        if (recorded_call.call != VIA_RECORDED_DEFERRED_ROWS) {
+            calls.push_back(recorded_call);
+            continue;
+        }
+        const SectionRecording& rows = row_recordings[recorded_call.value];
+        calls.insert(calls.end(), rows.calls.begin(), rows.calls.end());
+        *recording->deferred[recorded_call.value].result = rows.result;
+    }
+    recording->calls.swap(calls);
+    recording->deferred.clear();
+}
+
+// Scan cache methods
+
+// Describe the file's size, modification time, device and inode, which identify the version of the file a cached
+// result was taken from.  The modification time is kept to the nanosecond where the platform records it, so a file
+// rewritten within the same second still looks changed.  Returns false if the file can't be found.
+static bool GetFileIdentity(const std::string& file, Json::Value& identity) {
+    struct stat file_stat;
+    if (0 != stat(file.c_str(), &file_stat)) {
+        return false;
+    }
+    identity = Json::objectValue;
+    identity["size"] = static_cast<Json::UInt64>(file_stat.st_size);
+    identity["mtime"] = static_cast<Json::Int64>(file_stat.st_mtime);
+#if VIA_LINUX_TARGET || VIA_BSD_TARGET
+    identity["mtime_ns"] = static_cast<Json::Int64>(file_stat.st_mtim.tv_nsec);
+#elif VIA_MACOS_TARGET
+    identity["mtime_ns"] = static_cast<Json::Int64>(file_stat.st_mtimespec.tv_nsec);
+#endif
+    identity["device"] = static_cast<Json::UInt64>(file_stat.st_dev);
+    identity["inode"] = static_cast<Json::UInt64>(file_stat.st_ino);
+    return true;
+}
+
+// Describe the other inputs a cached result depends on: the identity of each of the files, or null for a file that is
+// missing, and the value of each of the environment variables.
+Json::Value ViaSystem::ScanCacheInputs(const std::vector<std::string>& files, const std::vector<std::string>& env_vars) {
+    Json::Value inputs = Json::objectValue;
+    inputs["files"] = Json::objectValue;
+    for (const std::string& file : files) {
+        Json::Value identity = Json::nullValue;
+        GetFileIdentity(file, identity);
+        inputs["files"][file] = identity;
+    }
+    inputs["environment"] = Json::objectValue;
+    for (const std::string& env_var : env_vars) {
+        inputs["environment"][env_var] = GetEnvironmentalVariableValue(env_var);
+    }
+    return inputs;
+}
+
+std::string ViaSystem::GetScanCacheFile() {
+#ifdef VIA_WINDOWS_TARGET
+    std::string cache_folder = GetEnvironmentalVariableValue("LOCALAPPDATA");
+#else
+    std::string cache_folder = GetEnvironmentalVariableValue("XDG_CACHE_HOME");
+    if (cache_folder.empty()) {
+        std::string home_folder = GetEnvironmentalVariableValue("HOME");
+        if (!home_folder.empty()) {
+            cache_folder = home_folder + "/.cache";
+        }
+    }
+#endif
+    if (cache_folder.empty()) {
+        return "";
     }
+    return cache_folder + _directory_symbol + "vkvia_scan_cache.json";
+}
+
+// Entries no run has used for this long are dropped when the cache is saved
+static const int64_t scan_cache_max_age_seconds = 30 * 24 * 60 * 60;
+
+// Read the entries of a cache file.  Returns false if the file exists but can't be parsed.
+static bool ReadScanCacheEntries(const std::string& cache_file, Json::Value& entries) {
+    entries = Json::objectValue;
+    std::ifstream stream(cache_file.c_str(), std::ifstream::in);
+    if (stream.fail()) {
+        return true;
+    }
+    Json::Value root = Json::nullValue;
+    Json::Reader reader;
+    if (!reader.parse(stream, root, false) || !root.isObject() || root["version"] != 1 || !root["entries"].isObject()) {
+        return false;
+    }
+    entries = root["entries"];
+    return true;
+}
+
+// Read the results kept by earlier runs.  A missing or unreadable cache file just means every check is done again.
+void ViaSystem::LoadScanCache() {
+    std::lock_guard<std::mutex> lock(_scan_cache_lock);
+    _scan_cache = Json::objectValue;
+    _scan_cache_used = Json::objectValue;
+
+    std::string cache_file = GetScanCacheFile();
+    if (cache_file.empty()) {
+        return;
+    }
+    if (!ReadScanCacheEntries(cache_file, _scan_cache)) {
+        LogWarning("Ignoring unreadable scan cache " + cache_file);
+    }
+}
+
+// An advisory lock that runs saving the cache at the same time take in turn, so each merges into what the one before
+// wrote.  It is held on a file next to the cache, since the cache file itself is replaced by every save.  If the lock
+// file can't be opened or locked, the save goes ahead without it.
+class ScanCacheLock {
+   public:
+    explicit ScanCacheLock(const std::string& cache_file) {
+        std::string lock_file = cache_file + ".lock";
+#ifdef VIA_WINDOWS_TARGET
+        // _locking waits up to 10 seconds for the byte to be unlocked
+        if (0 == _sopen_s(&_fd, lock_file.c_str(), _O_RDWR | _O_CREAT | _O_NOINHERIT, _SH_DENYNO, _S_IREAD | _S_IWRITE) &&
+            0 != _locking(_fd, _LK_LOCK, 1)) {
+            _close(_fd);
+            _fd = -1;
+        }
+#else
+        _fd = open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (_fd != -1) {
+            int locked;
+            do {
+                locked = flock(_fd, LOCK_EX);
+            } while (locked != 0 && errno == EINTR);
+            if (locked != 0) {
+                close(_fd);
+                _fd = -1;
+            }
+        }
+#endif
+    }
+
+    ~ScanCacheLock() {
+        if (_fd == -1) {
+            return;
+        }
+#ifdef VIA_WINDOWS_TARGET
+        _lseek(_fd, 0, SEEK_SET);
+        _locking(_fd, _LK_UNLCK, 1);
+        _close(_fd);
+#else
+        // Closing the file releases the lock
+        close(_fd);
+#endif
+    }
+
+   private:
+    int _fd = -1;
+};
+
+void ViaSystem::SaveScanCache() {
+    std::lock_guard<std::mutex> lock(_scan_cache_lock);
+    std::string cache_file = GetScanCacheFile();
+    if (cache_file.empty()) {
+        return;
+    }
+
+#ifndef VIA_WINDOWS_TARGET
+    // The cache folder may not have been created yet for this user
+    mkdir(cache_file.substr(0, cache_file.rfind(_directory_symbol)).c_str(), 0700);
+#endif
+    ScanCacheLock cache_file_lock(cache_file);
+
+    // Merge this run's entries into what is on disk now, rather than what was loaded, so the entries of runs with other
+    // inputs, including runs that finished since this one started, are kept until they age out
+    Json::Value entries;
+    ReadScanCacheEntries(cache_file, entries);
+    for (const std::string& key : _scan_cache_used.getMemberNames()) {
+        entries[key] = _scan_cache_used[key];
+    }
+    int64_t oldest_kept = static_cast<int64_t>(time(nullptr)) - scan_cache_max_age_seconds;
+    for (const std::string& key : entries.getMemberNames()) {
+        if (!entries[key]["last_used"].isIntegral() || entries[key]["last_used"].asInt64() < oldest_kept) {
+            entries.removeMember(key);
+        }
+    }
+
+    // Write a temporary file first so a run that stops part way doesn't leave a truncated cache behind.  The name is
+    // unique to this process, so runs finishing at the same time don't write into each other's temporary file.
+#ifdef VIA_WINDOWS_TARGET
+    std::string temp_file = cache_file + "." + std::to_string(_getpid()) + ".tmp";
+#else
+    std::string temp_file = cache_file + "." + std::to_string(getpid()) + ".tmp";
+#endif
+    std::ofstream stream(temp_file.c_str(), std::ofstream::out | std::ofstream::trunc);
+    if (stream.fail()) {
+        return;
+    }
+    Json::Value root = Json::objectValue;
+    root["version"] = 1;
+    root["entries"] = entries;
+    Json::FastWriter writer;
+    stream << writer.write(root);
+    stream.close();
+    if (stream.fail()) {
+        std::remove(temp_file.c_str());
+        return;
+    }
+    if (0 != std::rename(temp_file.c_str(), cache_file.c_str())) {
+        // Windows won't rename over an existing file
+        std::remove(cache_file.c_str());
+        if (0 != std::rename(temp_file.c_str(), cache_file.c_str())) {
+            std::remove(temp_file.c_str());
+        }
+    }
+}
+
+// Look for the result of a "kind" check on "name" that was cached while "file" and the other inputs looked the way
+// they do now.
+bool ViaSystem::FindCachedResult(const std::string& kind, const std::string& name, const std::string& file,
+                                 const Json::Value& inputs, bool& success, std::string& value) {
+    std::lock_guard<std::mutex> lock(_scan_cache_lock);
+    if (!_use_scan_cache) {
+        return false;
+    }
+    std::string key = kind + ":" + name;
+    Json::Value identity;
+    if (!_scan_cache.isMember(key) || !GetFileIdentity(file, identity)) {
+        return false;
+    }
+    const Json::Value& entry = _scan_cache[key];
+    if (entry["file"].asString() != file || entry["identity"] != identity || entry["inputs"] != inputs ||
+        !entry["success"].isBool() || !entry["value"].isString()) {
+        return false;
+    }
+    success = entry["success"].asBool();
+    value = entry["value"].asString();
+    _scan_cache_used[key] = entry;
+    _scan_cache_used[key]["last_used"] = static_cast<Json::Int64>(time(nullptr));
+    return true;
+}
+
+void ViaSystem::CacheResult(const std::string& kind, const std::string& name, const std::string& file,
+                            const Json::Value& inputs, bool success, const std::string& value) {
+    std::lock_guard<std::mutex> lock(_scan_cache_lock);
+    if (!_use_scan_cache) {
+        return;
+    }
+    Json::Value entry = Json::objectValue;
+    if (!GetFileIdentity(file, entry["identity"])) {
+        return;
+    }
+    entry["file"] = file;
+    entry["inputs"] = inputs;
+    entry["success"] = success;
+    entry["value"] = value;
+    entry["last_used"] = static_cast<Json::Int64>(time(nullptr));
+    _scan_cache_used[kind + ":" + name] = entry;
 }
 
 // HTML methods
@@ -1307,20 +2035,20 @@ void ViaSystem::PrintEndTable() {
 // header information including the appropriate CSS and JavaScript
 // items.
 void ViaSystem::StartOutputHTML(const std::string& title) {
-    _out_ofstream << "<!DOCTYPE html>" << std::endl;
-    _out_ofstream << "<HTML lang=\"en\" xml:lang=\"en\" "
+    *_out_stream << "<!DOCTYPE html>" << "\n";
+    *_out_stream << "<HTML lang=\"en\" xml:lang=\"en\" "
                      "xmlns=\"http://www.w3.org/1999/xhtml\">"
-                  << std::endl;
-    _out_ofstream << std::endl << "<HEAD>" << std::endl << "    <TITLE>" << title << "</TITLE>" << std::endl;
+                  << "\n";
+    *_out_stream << "\n" << "<HEAD>" << "\n" << "    <TITLE>" << title << "</TITLE>" << "\n";
 
-    _out_ofstream << "    <META charset=\"UTF-8\">" << std::endl
-                  << "    <style media=\"screen\" type=\"text/css\">" << std::endl
+    *_out_stream << "    <META charset=\"UTF-8\">" << "\n"
+                  << "    <style media=\"screen\" type=\"text/css\">" << "\n"
                   << "        html {"
-                  << std::endl
+                  << "\n"
                   // By defining the color first, this won't override the background image
                   // (unless the images aren't there).
                   << "            background-color: #0b1e48;"
-                  << std::endl
+                  << "\n"
                   // The following changes try to load the text image twice (locally, then
                   // off the web) followed by the background image twice (locally, then
                   // off the web).  The background color will only show if both background
@@ -1328,114 +2056,114 @@ void ViaSystem::StartOutputHTML(const std::string& title) {
                   // their machine, while a person they share it with will see the web
                   // images (or the background color).
                   << "            background-image: url(\"https://vulkan.lunarg.com/img/VIATitle.png\"), "
-                  << "url(\"https://vulkan.lunarg.com/img/VIABackground.jpg\");" << std::endl
-                  << "            background-position: center top, center;" << std::endl
-                  << "            -webkit-background-size: auto, cover;" << std::endl
-                  << "            -moz-background-size: auto, cover;" << std::endl
-                  << "            -o-background-size: auto, cover;" << std::endl
-                  << "            background-size: auto, cover;" << std::endl
-                  << "            background-attachment: scroll, fixed;" << std::endl
-                  << "            background-repeat: no-repeat, no-repeat;" << std::endl
+                  << "url(\"https://vulkan.lunarg.com/img/VIABackground.jpg\");" << "\n"
+                  << "            background-position: center top, center;" << "\n"
+                  << "            -webkit-background-size: auto, cover;" << "\n"
+                  << "            -moz-background-size: auto, cover;" << "\n"
+                  << "            -o-background-size: auto, cover;" << "\n"
+                  << "            background-size: auto, cover;" << "\n"
+                  << "            background-attachment: scroll, fixed;" << "\n"
+                  << "            background-repeat: no-repeat, no-repeat;" << "\n"
                   << "        }"
-                  << std::endl
+                  << "\n"
                   // h1.section is used for section headers, and h1.version is used to
                   // print out the application version text (which shows up just under
                   // the title).
-                  << "        h1.section {" << std::endl
-                  << "            font-family: sans-serif;" << std::endl
-                  << "            font-size: 35px;" << std::endl
-                  << "            color: #FFFFFF;" << std::endl
-                  << "        }" << std::endl
-                  << "        h1.version {" << std::endl
-                  << "            font-family: sans-serif;" << std::endl
-                  << "            font-size: 25px;" << std::endl
-                  << "            color: #FFFFFF;" << std::endl
-                  << "        }" << std::endl
-                  << "        h2.note {" << std::endl
-                  << "            font-family: sans-serif;" << std::endl
-                  << "            font-size: 12px;" << std::endl
-                  << "            color: #FFFFFF;" << std::endl
-                  << "        }" << std::endl
-                  << "        table {" << std::endl
-                  << "            min-width: 600px;" << std::endl
-                  << "            width: 70%;" << std::endl
-                  << "            border-collapse: collapse;" << std::endl
-                  << "            border-color: grey;" << std::endl
-                  << "            font-family: sans-serif;" << std::endl
-                  << "        }" << std::endl
-                  << "        td.header {" << std::endl
-                  << "            padding: 18px;" << std::endl
-                  << "            border: 1px solid #ccc;" << std::endl
-                  << "            font-size: 18px;" << std::endl
-                  << "            color: #fff;" << std::endl
-                  << "        }" << std::endl
-                  << "        td.odd {" << std::endl
-                  << "            padding: 10px;" << std::endl
-                  << "            border: 1px solid #ccc;" << std::endl
-                  << "            font-size: 16px;" << std::endl
-                  << "            color: rgb(255, 255, 255);" << std::endl
-                  << "        }" << std::endl
-                  << "        td.even {" << std::endl
-                  << "            padding: 10px;" << std::endl
-                  << "            border: 1px solid #ccc;" << std::endl
-                  << "            font-size: 16px;" << std::endl
-                  << "            color: rgb(220, 220, 220);" << std::endl
-                  << "        }" << std::endl
-                  << "        tr.header {" << std::endl
-                  << "            background-color: rgba(64,64,64,0.75);" << std::endl
-                  << "        }" << std::endl
-                  << "        tr.odd {" << std::endl
-                  << "            background-color: rgba(0,0,0,0.6);" << std::endl
-                  << "        }" << std::endl
-                  << "        tr.even {" << std::endl
-                  << "            background-color: rgba(0,0,0,0.7);" << std::endl
-                  << "        }" << std::endl
-                  << "    </style>" << std::endl
+                  << "        h1.section {" << "\n"
+                  << "            font-family: sans-serif;" << "\n"
+                  << "            font-size: 35px;" << "\n"
+                  << "            color: #FFFFFF;" << "\n"
+                  << "        }" << "\n"
+                  << "        h1.version {" << "\n"
+                  << "            font-family: sans-serif;" << "\n"
+                  << "            font-size: 25px;" << "\n"
+                  << "            color: #FFFFFF;" << "\n"
+                  << "        }" << "\n"
+                  << "        h2.note {" << "\n"
+                  << "            font-family: sans-serif;" << "\n"
+                  << "            font-size: 12px;" << "\n"
+                  << "            color: #FFFFFF;" << "\n"
+                  << "        }" << "\n"
+                  << "        table {" << "\n"
+                  << "            min-width: 600px;" << "\n"
+                  << "            width: 70%;" << "\n"
+                  << "            border-collapse: collapse;" << "\n"
+                  << "            border-color: grey;" << "\n"
+                  << "            font-family: sans-serif;" << "\n"
+                  << "        }" << "\n"
+                  << "        td.header {" << "\n"
+                  << "            padding: 18px;" << "\n"
+                  << "            border: 1px solid #ccc;" << "\n"
+                  << "            font-size: 18px;" << "\n"
+                  << "            color: #fff;" << "\n"
+                  << "        }" << "\n"
+                  << "        td.odd {" << "\n"
+                  << "            padding: 10px;" << "\n"
+                  << "            border: 1px solid #ccc;" << "\n"
+                  << "            font-size: 16px;" << "\n"
+                  << "            color: rgb(255, 255, 255);" << "\n"
+                  << "        }" << "\n"
+                  << "        td.even {" << "\n"
+                  << "            padding: 10px;" << "\n"
+                  << "            border: 1px solid #ccc;" << "\n"
+                  << "            font-size: 16px;" << "\n"
+                  << "            color: rgb(220, 220, 220);" << "\n"
+                  << "        }" << "\n"
+                  << "        tr.header {" << "\n"
+                  << "            background-color: rgba(64,64,64,0.75);" << "\n"
+                  << "        }" << "\n"
+                  << "        tr.odd {" << "\n"
+                  << "            background-color: rgba(0,0,0,0.6);" << "\n"
+                  << "        }" << "\n"
+                  << "        tr.even {" << "\n"
+                  << "            background-color: rgba(0,0,0,0.7);" << "\n"
+                  << "        }" << "\n"
+                  << "    </style>" << "\n"
                   << "    <script src=\"https://ajax.googleapis.com/ajax/libs/jquery/"
-                  << "2.2.4/jquery.min.js\"></script>" << std::endl
-                  << "    <script type=\"text/javascript\">" << std::endl
-                  << "        $( document ).ready(function() {" << std::endl
-                  << "            $('table tr:not(.header)').hide();" << std::endl
-                  << "            $('.header').click(function() {" << std::endl
+                  << "2.2.4/jquery.min.js\"></script>" << "\n"
+                  << "    <script type=\"text/javascript\">" << "\n"
+                  << "        $( document ).ready(function() {" << "\n"
+                  << "            $('table tr:not(.header)').hide();" << "\n"
+                  << "            $('.header').click(function() {" << "\n"
                   << "                "
                      "$(this).nextUntil('tr.header').slideToggle(300);"
-                  << std::endl
-                  << "            });" << std::endl
-                  << "        });" << std::endl
-                  << "    </script>" << std::endl
-                  << "</HEAD>" << std::endl
-                  << std::endl
-                  << "<BODY>" << std::endl
-                  << std::endl;
+                  << "\n"
+                  << "            });" << "\n"
+                  << "        });" << "\n"
+                  << "    </script>" << "\n"
+                  << "</HEAD>" << "\n"
+                  << "\n"
+                  << "<BODY>" << "\n"
+                  << "\n";
     // We need space from the top for the VIA texture
     for (uint32_t space = 0; space < 15; space++) {
-        _out_ofstream << "    <BR />" << std::endl;
+        *_out_stream << "    <BR />" << "\n";
     }
 
-    _out_ofstream << "<center><h2 class=\"note\">< NOTE: Click on section name to expand "
+    *_out_stream << "<center><h2 class=\"note\">< NOTE: Click on section name to expand "
                      "table ></h2></center>"
-                  << std::endl
-                  << "    <BR />" << std::endl;
+                  << "\n"
+                  << "    <BR />" << "\n";
 }
 
 // Close out writing to the HTML file.
-void ViaSystem::EndOutputHTML() { _out_ofstream << "</BODY>" << std::endl << std::endl << "</HTML>" << std::endl; }
+void ViaSystem::EndOutputHTML() { *_out_stream << "</BODY>" << "\n" << "\n" << "</HTML>" << "\n"; }
 
 void ViaSystem::BeginSectionHTML(const std::string& section_str) {
-    _out_ofstream << "    <H1 class=\"section\"><center>" << section_str << "</center></h1>" << std::endl;
+    *_out_stream << "    <H1 class=\"section\"><center>" << section_str << "</center></h1>" << "\n";
 }
 
-void ViaSystem::EndSectionHTML() { _out_ofstream << "    <BR/>" << std::endl << "    <BR/>" << std::endl; }
+void ViaSystem::EndSectionHTML() { *_out_stream << "    <BR/>" << "\n" << "    <BR/>" << "\n"; }
 
 void ViaSystem::PrintStandardTextHTML(const std::string& text_str) {
-    _out_ofstream << "    <H2><font color=\"White\">" << text_str << "</font></H2>" << std::endl;
+    *_out_stream << "    <H2><font color=\"White\">" << text_str << "</font></H2>" << "\n";
 }
 
 void ViaSystem::PrintBeginTableHTML(const std::string& table_name, uint32_t num_cols) {
-    _out_ofstream << "    <table align=\"center\">" << std::endl
-                  << "        <tr class=\"header\">" << std::endl
-                  << "            <td colspan=\"" << num_cols << "\" class=\"header\">" << table_name << "</td>" << std::endl
-                  << "        </tr>" << std::endl;
+    *_out_stream << "    <table align=\"center\">" << "\n"
+                  << "        <tr class=\"header\">" << "\n"
+                  << "            <td colspan=\"" << num_cols << "\" class=\"header\">" << table_name << "</td>" << "\n"
+                  << "        </tr>" << "\n";
 
     _outputting_to_odd_row = true;
 }
@@ -1447,7 +2175,7 @@ void ViaSystem::PrintBeginTableRowHTML() {
     } else {
         class_str = " class=\"even\"";
     }
-    _out_ofstream << "        <tr" << class_str << ">" << std::endl;
+    *_out_stream << "        <tr" << class_str << ">" << "\n";
 }
 
 void ViaSystem::PrintTableElementHTML(const std::string& element, ViaElementAlign align) {
@@ -1463,25 +2191,25 @@ void ViaSystem::PrintTableElementHTML(const std::string& element, ViaElementAlig
     } else {
         class_str = " class=\"even\"";
     }
-    _out_ofstream << "            <td" << align_str << class_str << ">" << element << "</td>" << std::endl;
+    *_out_stream << "            <td" << align_str << class_str << ">" << element << "</td>" << "\n";
 }
 
 void ViaSystem::PrintEndTableRowHTML() {
-    _out_ofstream << "        </tr>" << std::endl;
+    *_out_stream << "        </tr>" << "\n";
     _outputting_to_odd_row = !_outputting_to_odd_row;
 }
 
-void ViaSystem::PrintEndTableHTML() { _out_ofstream << "    </table>" << std::endl; }
+void ViaSystem::PrintEndTableHTML() { *_out_stream << "    </table>" << "\n"; }
 
 // VkConfig print methods
 
 void ViaSystem::StartOutputVkConfig(const std::string& title) {
     _table_count = 0;
     _standard_text_count = 0;
-    _out_ofstream << "{" << std::endl;
+    *_out_stream << "{" << "\n";
 }
 
-void ViaSystem::EndOutputVkConfig() { _out_ofstream << "\n}" << std::endl; }
+void ViaSystem::EndOutputVkConfig() { *_out_stream << "\n}" << "\n"; }
 
 void ViaSystem::BeginSectionVkConfig(const std::string& section_str) { return; }
 
@@ -1489,9 +2217,9 @@ void ViaSystem::EndSectionVkConfig() { return; }
 
 void ViaSystem::PrintStandardTextVkConfig(const std::string& text_str) {
     if (_table_count > 0) {
-        _out_ofstream << "," << std::endl;
+        *_out_stream << "," << "\n";
     }
-    _out_ofstream << "\t\"" << _standard_text_count << "\": \"" << text_str << "\"";
+    *_out_stream << "\t\"" << _standard_text_count << "\": \"" << text_str << "\"";
     _table_count++;
     _standard_text_count++;
 }
@@ -1499,31 +2227,212 @@ void ViaSystem::PrintStandardTextVkConfig(const std::string& text_str) {
 void ViaSystem::PrintBeginTableVkConfig(const std::string& table_name) {
     _row_count = 0;
     if (_table_count > 0) {
-        _out_ofstream << "," << std::endl;
+        *_out_stream << "," << "\n";
     }
-    _out_ofstream << "\t\"" << table_name << "\": {" << std::endl;
+    *_out_stream << "\t\"" << table_name << "\": {" << "\n";
     _table_count++;
 }
 void ViaSystem::PrintBeginTableRowVkConfig() {
     _col_count = 0;
     if (_row_count > 0) {
-        _out_ofstream << "," << std::endl;
+        *_out_stream << "," << "\n";
     }
-    _out_ofstream << "\t\t\"" << _row_count << "\": {" << std::endl;
+    *_out_stream << "\t\t\"" << _row_count << "\": {" << "\n";
     _row_count++;
 }
 
 void ViaSystem::PrintTableElementVkConfig(const std::string& element) {
     if (_col_count > 0) {
-        _out_ofstream << "," << std::endl;
+        *_out_stream << "," << "\n";
     }
-    _out_ofstream << "\t\t\t\"" << _col_count << "\": \"" << element << "\"";
+    *_out_stream << "\t\t\t\"" << _col_count << "\": \"" << element << "\"";
     _col_count++;
 }
 
-void ViaSystem::PrintEndTableRowVkConfig() { _out_ofstream << "\n\t\t}"; }
+void ViaSystem::PrintEndTableRowVkConfig() { *_out_stream << "\n\t\t}"; }
+
+void ViaSystem::PrintEndTableVkConfig() { *_out_stream << "\n\t}"; }
+
+// JSON print methods
+//
+// The report is written as it is generated, as one object holding the title and a list of sections.  Each section
+// holds its items in order, every item being either a piece of standard text or a table with its rows of elements:
+//
+//   {"title": "LunarG VIA", "sections": [{"name": "System Info", "items": [
+//       {"table": "Environment", "columns": 3, "rows": [["Linux", "", ""], ...]}, {"text": "..."}, ...]}, ...]}
+//
+// _json_scopes holds each list or object still open, and whether something has been written to it yet.  An end call
+// closes whatever is still open inside the scope it ends, and one with no matching begin is ignored, so a caller that
+// gets the calls out of balance can't make the report invalid.
+
+// The length of the well-formed UTF-8 sequence starting at pos, or zero if there isn't one.  Overlong forms, surrogates
+// and code points past U+10FFFF are not well formed.
+static size_t Utf8SequenceLength(const std::string& str, size_t pos) {
+    const unsigned char lead = static_cast<unsigned char>(str[pos]);
+    size_t length;
+    unsigned char min_second = 0x80;
+    unsigned char max_second = 0xbf;
+    if (lead < 0x80) {
+        return 1;
+    } else if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        min_second = (lead == 0xe0) ? 0xa0 : 0x80;
+        max_second = (lead == 0xed) ? 0x9f : 0xbf;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        min_second = (lead == 0xf0) ? 0x90 : 0x80;
+        max_second = (lead == 0xf4) ? 0x8f : 0xbf;
+    } else {
+        return 0;
+    }
+    if (str.size() - pos < length) {
+        return 0;
+    }
+    for (size_t i = 1; i < length; i++) {
+        const unsigned char next = static_cast<unsigned char>(str[pos + i]);
+        if (next < ((i == 1) ? min_second : 0x80) || next > ((i == 1) ? max_second : 0xbf)) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// File names, registry values and driver strings aren't always UTF-8, and JSON has to be, so any byte that doesn't
+// start a well-formed sequence is written as U+FFFD.
+void ViaSystem::WriteJsonString(const std::string& str) {
+    std::ostream& out = *_out_stream;
+    out << '"';
+    for (size_t pos = 0; pos < str.size(); pos++) {
+        const char c = str[pos];
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            const size_t length = Utf8SequenceLength(str, pos);
+            if (length == 0) {
+                out << "\\ufffd";
+            } else {
+                out.write(&str[pos], length);
+                pos += length - 1;
+            }
+            continue;
+        }
+        switch (c) {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    out << escaped;
+                } else {
+                    out << c;
+                }
+                break;
+        }
+    }
+    out << '"';
+}
+
+void ViaSystem::BeginJsonItem() {
+    if (_json_scopes.empty()) {
+        return;
+    }
+    if (_json_scopes.back().needs_comma) {
+        *_out_stream << ",";
+    }
+    _json_scopes.back().needs_comma = true;
+}
+
+// Closes the innermost open scope of this kind, along with any scopes still open inside it
+void ViaSystem::EndJsonScope(ViaJsonScopeKind kind) {
+    size_t scope = _json_scopes.size();
+    while (scope > 1 && _json_scopes[scope - 1].kind != kind) {
+        scope--;
+    }
+    if (scope <= 1) {
+        return;
+    }
+    while (_json_scopes.size() >= scope) {
+        switch (_json_scopes.back().kind) {
+            case VIA_JSON_SECTION:
+                *_out_stream << "\n]}";
+                break;
+            case VIA_JSON_TABLE:
+                *_out_stream << "]}";
+                break;
+            default:
+                *_out_stream << "]";
+                break;
+        }
+        _json_scopes.pop_back();
+    }
+}
 
-void ViaSystem::PrintEndTableVkConfig() { _out_ofstream << "\n\t}"; }
+void ViaSystem::StartOutputJson(const std::string& title) {
+    _json_scopes.assign(1, JsonScope{VIA_JSON_REPORT, false});
+    *_out_stream << "{\"title\": ";
+    WriteJsonString(title);
+    *_out_stream << ", \"sections\": [";
+}
+
+void ViaSystem::EndOutputJson() {
+    EndJsonScope(VIA_JSON_SECTION);
+    *_out_stream << "\n]}\n";
+    _json_scopes.clear();
+}
+
+void ViaSystem::BeginSectionJson(const std::string& section_str) {
+    BeginJsonItem();
+    *_out_stream << "\n{\"name\": ";
+    WriteJsonString(section_str);
+    *_out_stream << ", \"items\": [";
+    _json_scopes.push_back(JsonScope{VIA_JSON_SECTION, false});
+}
+
+void ViaSystem::EndSectionJson() { EndJsonScope(VIA_JSON_SECTION); }
+
+void ViaSystem::PrintStandardTextJson(const std::string& text_str) {
+    BeginJsonItem();
+    *_out_stream << "\n{\"text\": ";
+    WriteJsonString(text_str);
+    *_out_stream << "}";
+}
+
+void ViaSystem::PrintBeginTableJson(const std::string& table_name, uint32_t num_cols) {
+    BeginJsonItem();
+    *_out_stream << "\n{\"table\": ";
+    WriteJsonString(table_name);
+    *_out_stream << ", \"columns\": " << num_cols << ", \"rows\": [";
+    _json_scopes.push_back(JsonScope{VIA_JSON_TABLE, false});
+}
+
+void ViaSystem::PrintBeginTableRowJson() {
+    BeginJsonItem();
+    *_out_stream << "\n[";
+    _json_scopes.push_back(JsonScope{VIA_JSON_TABLE_ROW, false});
+}
+
+void ViaSystem::PrintTableElementJson(const std::string& element) {
+    BeginJsonItem();
+    WriteJsonString(element);
+}
+
+void ViaSystem::PrintEndTableRowJson() { EndJsonScope(VIA_JSON_TABLE_ROW); }
+
+void ViaSystem::PrintEndTableJson() { EndJsonScope(VIA_JSON_TABLE); }
 
 // Trim any whitespace preceeding or following the actual
 // content inside of a string.  The actual items labeled
@@ -1562,7 +2471,7 @@ void ViaSystem::GenerateSettingsFileJsonInfo(const std::string& settings_file) {
     PrintBeginTableRow();
     PrintTableElement("");
 
-    std::ifstream* settings_stream = new std::ifstream(settings_file, std::ifstream::in);
+    std::ifstream* settings_stream = new std::ifstream(StayInSysroot(settings_file), std::ifstream::in);
     if (nullptr == settings_stream || settings_stream->fail()) {
         // No file was found.  This is NOT an error.
         PrintTableElement(settings_file);
@@ -1854,7 +2763,7 @@ void ViaSystem::GenerateImplicitLayerJsonInfo(const char* layer_json_filename, J
                 combined_paths += ":";
             }
             combined_paths += override_path.asString();
-            override_paths.push_back(override_path.asString());
+            override_paths.push_back(InSysroot(override_path.asString()));
         }
         PrintBeginTableRow();
         PrintTableElement("");
@@ -2042,6 +2951,15 @@ ViaSystem::ViaResults ViaSystem::GenerateTestInfo(void) {
 
             full_cmd = cube_exe;
             full_cmd += " --c 100 --suppress_popups";
+            std::string validate_cmd = full_cmd + " --validate";
+
+            // Start the validation run at the same time where the platform allows it
+            std::future<int> validate_result;
+            if (CanRunTestsConcurrently()) {
+                validate_result = std::async(std::launch::async, [this, path, cube_exe, validate_cmd]() {
+                    return RunTestInDirectory(path, cube_exe, validate_cmd);
+                });
+            }
             int test_result = RunTestInDirectory(path, cube_exe, full_cmd);
             if (test_result == 0) {
                 found_exe = true;
@@ -2064,11 +2982,13 @@ ViaSystem::ViaResults ViaSystem::GenerateTestInfo(void) {
             }
             PrintEndTableRow();
 
-            full_cmd += " --validate";
-
             PrintBeginTableRow();
-            PrintTableElement(full_cmd);
-            test_result = RunTestInDirectory(path, cube_exe, full_cmd);
+            PrintTableElement(validate_cmd);
+            if (validate_result.valid()) {
+                test_result = validate_result.get();
+            } else {
+                test_result = RunTestInDirectory(path, cube_exe, validate_cmd);
+            }
             if (test_result == 0) {
                 PrintTableElement("VIA_SUCCESSFUL");
                 _ran_tests = true;
@@ -2086,6 +3006,7 @@ ViaSystem::ViaResults ViaSystem::GenerateTestInfo(void) {
 
         if (!found_exe) {
             res = VIA_TEST_FAILED;
+            PrintBeginTable("Cube", 2);
             PrintBeginTableRow();
             PrintTableElement("Failed to find either \'vkcube\' or \'cube\' executables");
             PrintTableElement("FAILURE");
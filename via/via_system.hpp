@@ -22,6 +22,9 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <functional>
+#include <mutex>
+#include <chrono>
 
 #include <json/json.h>
 #include <vulkan/vulkan.h>
@@ -39,6 +42,11 @@ class ViaSystem {
     bool Init(int argc, char** argv);
     bool GenerateInfo();
 
+    // Where an absolute path of the system being analyzed is found on this machine
+    std::string InSysroot(const std::string& path) const;
+    // Where a path on this machine built inside the sysroot, such as a file found by listing one of its folders, leads
+    std::string StayInSysroot(const std::string& host_path) const;
+
     // Result ids
     enum ViaResults {
         VIA_SUCCESSFUL = 0,
@@ -72,6 +80,64 @@ class ViaSystem {
 
     enum ViaElementAlign { VIA_ALIGN_LEFT = 0, VIA_ALIGN_CENTER, VIA_ALIGN_RIGHT };
 
+    // Sections of the report that are generated on worker threads, in the order they are written out
+    enum ViaSection {
+        VIA_SECTION_ENVIRONMENT = 0,
+        VIA_SECTION_HARDWARE,
+        VIA_SECTION_EXECUTABLE,
+        VIA_SECTION_DRIVER,
+        VIA_SECTION_LOADER,
+        VIA_SECTION_SDK,
+        VIA_SECTION_IMPLICIT_LAYER,
+        VIA_SECTION_EXPLICIT_LAYER,
+        VIA_SECTION_SETTINGS_FILE,
+        VIA_SECTION_VULKAN,
+        VIA_SECTION_COUNT
+    };
+
+    // A print or log call made while generating a section, kept until the section is written out
+    enum ViaRecordedCall {
+        VIA_RECORDED_BEGIN_SECTION = 0,
+        VIA_RECORDED_END_SECTION,
+        VIA_RECORDED_STANDARD_TEXT,
+        VIA_RECORDED_BEGIN_TABLE,
+        VIA_RECORDED_BEGIN_TABLE_ROW,
+        VIA_RECORDED_TABLE_ELEMENT,
+        VIA_RECORDED_END_TABLE_ROW,
+        VIA_RECORDED_END_TABLE,
+        VIA_RECORDED_LOG_ERROR,
+        VIA_RECORDED_LOG_WARNING,
+        VIA_RECORDED_LOG_INFO,
+        VIA_RECORDED_DEFERRED_ROWS
+    };
+
+    // A list or object opened in the JSON report
+    enum ViaJsonScopeKind { VIA_JSON_REPORT = 0, VIA_JSON_SECTION, VIA_JSON_TABLE, VIA_JSON_TABLE_ROW };
+
+    struct RecordedCall {
+        ViaRecordedCall call;
+        std::string text;
+        uint32_t value;
+    };
+
+    typedef std::function<ViaResults()> SectionGenerator;
+
+    struct StageTiming {
+        std::string stage;
+        double milliseconds;
+    };
+
+    struct DeferredRows {
+        SectionGenerator generator;
+        ViaResults* result;
+    };
+
+    struct SectionRecording {
+        std::vector<RecordedCall> calls;
+        std::vector<DeferredRows> deferred;
+        ViaResults result;
+    };
+
     // Print methods
     void StartOutput(const std::string& title);
     void EndOutput();
@@ -84,6 +150,31 @@ class ViaSystem {
     void PrintEndTableRow();
     void PrintEndTable();
 
+    // Section methods
+    void RecordSections(const std::vector<SectionGenerator>& generators, const std::vector<std::vector<uint32_t>>& chains,
+                        std::vector<SectionRecording>& recordings);
+    void RecordCall(ViaRecordedCall call, const std::string& text = "", uint32_t value = 0);
+    void WriteSection(const SectionRecording& recording);
+    void DeferRows(const SectionGenerator& generator, ViaResults* result);
+    void GenerateDeferredRows();
+
+    // Timing methods
+    void RecordTiming(const std::string& stage, std::chrono::steady_clock::time_point start);
+    SectionGenerator TimedGenerator(const std::string& stage, const SectionGenerator& generator);
+    std::vector<StageTiming> SortedTimings();
+    void GenerateTimingInfo();
+    void PrintTimingSummary();
+
+    // Scan cache methods
+    std::string GetScanCacheFile();
+    void LoadScanCache();
+    void SaveScanCache();
+    Json::Value ScanCacheInputs(const std::vector<std::string>& files, const std::vector<std::string>& env_vars);
+    bool FindCachedResult(const std::string& kind, const std::string& name, const std::string& file, const Json::Value& inputs,
+                          bool& success, std::string& value);
+    void CacheResult(const std::string& kind, const std::string& name, const std::string& file, const Json::Value& inputs,
+                     bool success, const std::string& value);
+
     // HTML methods
     void StartOutputHTML(const std::string& title);
     void EndOutputHTML();
@@ -108,6 +199,21 @@ class ViaSystem {
     void PrintEndTableRowVkConfig();
     void PrintEndTableVkConfig();
 
+    // JSON output methods
+    void WriteJsonString(const std::string& str);
+    void BeginJsonItem();
+    void EndJsonScope(ViaJsonScopeKind kind);
+    void StartOutputJson(const std::string& title);
+    void EndOutputJson();
+    void BeginSectionJson(const std::string& section_str);
+    void EndSectionJson();
+    void PrintStandardTextJson(const std::string& text_str);
+    void PrintBeginTableJson(const std::string& table_name, uint32_t num_cols);
+    void PrintBeginTableRowJson();
+    void PrintTableElementJson(const std::string& element);
+    void PrintEndTableRowJson();
+    void PrintEndTableJson();
+
     // Logging methods
     void LogError(const std::string& error);
     void LogWarning(const std::string& warning);
@@ -135,11 +241,12 @@ class ViaSystem {
     virtual ViaResults PrintSystemExplicitLayerInfo() = 0;
     virtual ViaResults PrintSystemSettingsFileInfo() = 0;
     virtual int RunTestInDirectory(std::string path, std::string test, std::string cmd_line) = 0;
+    virtual bool CanRunTestsConcurrently() { return false; }
     virtual void PrintFileVersionInfo(const std::string& json_filename, const std::string& library) {}
     virtual bool CheckExpiration(OverrideExpiration expiration) = 0;
 
     // Non-overrideable capture functions
-    ViaResults GenerateSystemInfo();
+    ViaResults GenerateSystemInfo(const std::vector<SectionRecording>& recordings);
     ViaResults GenerateVulkanInfo();
     ViaResults GenerateTestInfo();
     void GenerateSettingsFileJsonInfo(const std::string& settings_file);
@@ -185,11 +292,15 @@ class ViaSystem {
     std::string _cur_path;
     std::string _out_file;
     std::ofstream _out_ofstream;
+    std::ostream* _out_stream;
 
     // Command Line Argument items
     bool _run_cube_tests;
+    bool _use_scan_cache;
+    bool _print_timing_summary;
+    std::string _sysroot;
 
-    enum ViaFileFormat { VIA_HTML_FORMAT = 0, VIA_VKCONFIG_FORMAT };
+    enum ViaFileFormat { VIA_HTML_FORMAT = 0, VIA_VKCONFIG_FORMAT, VIA_JSON_FORMAT };
     ViaFileFormat _out_file_format;
 
     // SDK items
@@ -204,6 +315,26 @@ class ViaSystem {
     uint32_t _col_count;
     uint32_t _table_count;
     uint32_t _standard_text_count;
+    // JSON lists and objects still open in the report, innermost last
+    struct JsonScope {
+        ViaJsonScopeKind kind;
+        bool needs_comma;
+    };
+    std::vector<JsonScope> _json_scopes;
+
+    // Section being recorded by the current worker thread, or null when printing straight to the output file
+    static thread_local SectionRecording* _recording;
+
+    // Scan cache items, holding the results of slow file checks from earlier runs.  Entries are kept by the metadata of
+    // the file they depend on.  The entries used by this run are merged back into the cache file, and entries no run
+    // has used for a while are dropped.
+    std::mutex _scan_cache_lock;
+    Json::Value _scan_cache;
+    Json::Value _scan_cache_used;
+
+    // How long each stage of the run took, in the order the stages first finished
+    std::mutex _timing_lock;
+    std::vector<StageTiming> _timings;
 
     VulkanInstanceInfo _vulkan_1_0_info;
     VulkanInstanceInfo _vulkan_max_info;
@@ -22,14 +22,27 @@
 #include <cstring>
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iterator>
+#include <new>
+#include <set>
+#include <stdexcept>
 
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <sys/utsname.h>
 #include <dirent.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
 #include <unistd.h>
-#include <dlfcn.h>
 
 #include "via_system_linux.hpp"
 
@@ -49,68 +62,198 @@ ViaSystemLinux::ViaSystemLinux() : ViaSystem() {
     }
 }
 
+// External tests that are still running after this long are stopped, so a hung test can't stall via.
+static const int test_timeout_seconds = 60;
+
+// posix_spawn can only change the test's working folder itself from glibc 2.29 on
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define VIA_SPAWN_ADDCHDIR 1
+#endif
+
+// Find an executable in the PATH folders, the way the shell would.
+static bool FindInPath(const std::string &exe, std::string &exe_file) {
+    const char *env_value = getenv("PATH");
+    if (env_value == NULL) {
+        return false;
+    }
+    std::string path_list = env_value;
+    char *save_ptr = NULL;
+    char *tok = strtok_r(&path_list[0], ":", &save_ptr);
+    while (tok != NULL) {
+        std::string candidate = std::string(tok) + "/" + exe;
+        if (access(candidate.c_str(), X_OK) != -1) {
+            exe_file = candidate;
+            return true;
+        }
+        tok = strtok_r(NULL, ":", &save_ptr);
+    }
+    return false;
+}
+
 // Run the test in the specified directory with the corresponding
-// command-line arguments.
+// command-line arguments.  The test is started with posix_spawn in its own
+// process group, so nothing in via's process changes and several tests can
+// run at once.  Anything it prints is captured and logged if it fails.
 // Returns 0 on no error, 1 if test file wasn't found, and -1
 // on any other errors.
 int ViaSystemLinux::RunTestInDirectory(std::string path, std::string test, std::string cmd_line) {
     int err_code = -1;
-    char orig_dir[1024];
-    orig_dir[0] = '\0';
+    std::string exe_file;
 
     LogInfo("       Command-line: " + cmd_line);
 
-    if (NULL != getcwd(orig_dir, 1023)) {
-        if (path.empty()) {
-            // If the path is empty, check system paths.
-            auto const which_query = "which " + test;
-            err_code = system(which_query.c_str());
-            if (err_code != 0) {
-                LogWarning(test + " not found.  Skipping.");
-            } else {
-                err_code = system(cmd_line.c_str());
+    if (path.empty()) {
+        // If the path is empty, check system paths.
+        if (!FindInPath(test, exe_file)) {
+            LogWarning(test + " not found.  Skipping.");
+            return 1;
+        }
+    } else {
+        exe_file = path + "/" + test;
+        if (access(exe_file.c_str(), X_OK) == -1) {
+            // Can't run because it's either not there or an actual
+            // exe.  So, just return a separate error code.
+            LogWarning(test + " not found.  Skipping.");
+            return 1;
+        }
+    }
+
+    // The tests only take simple arguments, so splitting on spaces is enough
+    std::vector<std::string> args;
+    std::istringstream cmd_stream(cmd_line);
+    std::string arg;
+    while (cmd_stream >> arg) {
+        args.push_back(arg);
+    }
+    std::vector<char *> argv;
+#ifndef VIA_SPAWN_ADDCHDIR
+    // Let a shell change folder just before it becomes the test
+    std::string shell_cd = "cd \"$0\" && exec \"$@\"";
+    if (!path.empty()) {
+        argv.push_back(const_cast<char *>("/bin/sh"));
+        argv.push_back(const_cast<char *>("-c"));
+        argv.push_back(&shell_cd[0]);
+        argv.push_back(&path[0]);
+        exe_file = "/bin/sh";
+    }
+#endif
+    for (std::string &cur_arg : args) {
+        argv.push_back(&cur_arg[0]);
+    }
+    argv.push_back(NULL);
+
+    int out_pipe[2];
+    if (pipe2(out_pipe, O_CLOEXEC) != 0) {
+        LogWarning("Failed to create a pipe for " + test);
+        return err_code;
+    }
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawnattr_t attributes;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, out_pipe[1], STDERR_FILENO);
+#ifdef VIA_SPAWN_ADDCHDIR
+    if (!path.empty()) {
+        posix_spawn_file_actions_addchdir_np(&file_actions, path.c_str());
+    }
+#endif
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    pid_t test_pid;
+    int spawn_err = posix_spawn(&test_pid, exe_file.c_str(), &file_actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&file_actions);
+    posix_spawnattr_destroy(&attributes);
+    close(out_pipe[1]);
+    if (spawn_err != 0) {
+        close(out_pipe[0]);
+        LogWarning("Failed to start " + test + ": " + strerror(spawn_err));
+        return err_code;
+    }
+
+    // Collect the output until the test closes it, then wait for it to exit, either way only up to the timeout
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(test_timeout_seconds);
+    std::string output;
+    bool output_open = true;
+    bool timed_out = false;
+    int status = 0;
+    while (true) {
+        auto remaining =
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            timed_out = true;
+            break;
+        }
+        if (output_open) {
+            pollfd out_poll = {out_pipe[0], POLLIN, 0};
+            int ready = poll(&out_poll, 1, static_cast<int>(remaining));
+            if (ready > 0) {
+                char buffer[4096];
+                ssize_t count = read(out_pipe[0], buffer, sizeof(buffer));
+                if (count > 0) {
+                    output.append(buffer, count);
+                } else if (count == 0 || errno != EINTR) {
+                    output_open = false;
+                }
+            } else if (ready < 0 && errno != EINTR) {
+                output_open = false;
             }
         } else {
-            int err = chdir(path.c_str());
-            if (-1 != err) {
-                if (-1 != access(test.c_str(), X_OK)) {
-                    err_code = system(cmd_line.c_str());
-                } else {
-                    // Can't run because it's either not there or an actual
-                    // exe.  So, just return a separate error code.
-                    err_code = 1;
-                    LogWarning(test + " not found.  Skipping.");
-                }
-            } else {
-                // Path doesn't exist at all
-                err_code = 1;
-                LogWarning(test + " not found.  Skipping.");
+            pid_t waited = waitpid(test_pid, &status, WNOHANG);
+            if (waited == test_pid || (waited < 0 && errno != EINTR)) {
+                break;
             }
-            err = chdir(orig_dir);
+            usleep(10000);
         }
     }
+    close(out_pipe[0]);
+    if (timed_out) {
+        kill(-test_pid, SIGKILL);
+        while (waitpid(test_pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        LogWarning(test + " still running after " + std::to_string(test_timeout_seconds) + " seconds.  Stopped it.");
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        err_code = 0;
+    }
+    if (err_code != 0 && !output.empty()) {
+        LogWarning(test + " output:\n" + output);
+    }
     return err_code;
 }
 
 ViaSystem::ViaResults ViaSystemLinux::PrintSystemEnvironmentInfo() {
     ViaResults result = VIA_SUCCESSFUL;
     char path[1035];
-    char *env_value;
+    const char *env_value;
     utsname uts_buffer;
 
     PrintBeginTable("Environment", 3);
 
-    FILE *fp = popen("cat /etc/os-release", "r");
-    if (fp == NULL) {
+    if (!_sysroot.empty()) {
+        PrintBeginTableRow();
+        PrintTableElement("Sysroot");
+        PrintTableElement(_sysroot);
+        PrintTableElement("");
+        PrintEndTableRow();
+        PrintBeginTableRow();
+        PrintTableElement("");
+        PrintTableElement("Ignored Variables");
+        PrintTableElement("HOME, LD_LIBRARY_PATH, VULKAN_SDK and VK_*");
+        PrintEndTableRow();
+    }
+
+    std::ifstream os_release(StayInSysroot(InSysroot("/etc/os-release")).c_str());
+    if (!os_release.is_open()) {
         PrintBeginTableRow();
         PrintTableElement("ERROR");
-        PrintTableElement("Failed to cat /etc/os-release");
+        PrintTableElement("Failed to read /etc/os-release");
         PrintTableElement("");
         PrintEndTableRow();
         result = VIA_SYSTEM_CALL_FAILURE;
     } else {
-        // Read the output a line at a time - output it.
-        while (fgets(path, sizeof(path) - 1, fp) != NULL) {
+        while (os_release.getline(path, sizeof(path))) {
             if (NULL != strstr(path, "PRETTY_NAME")) {
                 uint32_t index;
                 index = strlen(path) - 1;
@@ -137,7 +280,6 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemEnvironmentInfo() {
                 break;
             }
         }
-        pclose(fp);
     }
 
     errno = 0;
@@ -174,7 +316,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemEnvironmentInfo() {
         PrintTableElement(env_value);
         PrintEndTableRow();
     }
-    env_value = getenv("LD_LIBRARY_PATH");
+    env_value = GetSystemEnvironmentValue("LD_LIBRARY_PATH");
     if (env_value != NULL) {
         PrintBeginTableRow();
         PrintTableElement("");
@@ -249,7 +391,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemHardwareInfo() {
     PrintEndTableRow();
 
     // Print system disk space usage
-    if (0 == statvfs("/etc/os-release", &fs_stats)) {
+    if (0 == statvfs(InSysroot("/etc/os-release").c_str(), &fs_stats)) {
         uint64_t bytes_total = (uint64_t)fs_stats.f_bsize * (uint64_t)fs_stats.f_bavail;
         if ((bytes_total >> 40) > 0x0ULL) {
             snprintf(generic_string, 1023, "%u TB", static_cast<uint32_t>(bytes_total >> 40));
@@ -360,104 +502,673 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemExecutableInfo() {
     return result;
 }
 
-// Utility function to determine if a driver may exist in the folder.
-static bool CheckDriver(ViaSystemLinux *via_sys_linux, std::string &folder_loc, std::string &object_name) {
-    bool success = false;
-    (void)via_sys_linux;
-    std::string full_name = folder_loc;
-    if (folder_loc.c_str()[folder_loc.size() - 1] != '/') {
-        full_name += "/";
-    }
-    full_name += object_name;
-    if (access(full_name.c_str(), R_OK) != -1) {
-        success = true;
+// Read the names of the files in a folder, sorted so lookups can binary search them.
+static void ReadSystemObjectFolder(const std::string &folder_loc, ViaSystemLinux::SystemObjectFolder &folder) {
+    folder.path = folder_loc;
+    folder.file_names.clear();
+
+    DIR *dir = opendir(folder_loc.c_str());
+    folder.exists = (NULL != dir);
+    if (NULL != dir) {
+        dirent *cur_ent;
+        while ((cur_ent = readdir(dir)) != NULL) {
+            folder.file_names.push_back(cur_ent->d_name);
+        }
+        closedir(dir);
+        std::sort(folder.file_names.begin(), folder.file_names.end());
     }
-    return success;
 }
 
-// Pointer to a function sed to validate if the system object is found
-typedef bool (*PFN_CheckIfValid)(ViaSystemLinux *via_sys_linux, std::string &folder_loc, std::string &object_name);
-
-static bool FindLinuxSystemObject(ViaSystemLinux *via_sys_linux, std::string object_name, std::string &location,
-                                  PFN_CheckIfValid func, bool break_on_first) {
-    bool found_one = false;
-    std::string path_to_check;
-    char *env_value = getenv("LD_LIBRARY_PATH");
-
-    for (uint32_t iii = 0; iii < 5; iii++) {
-        switch (iii) {
-            case 0:
-                path_to_check = "/usr/lib";
-                break;
-            case 1:
+// The folders system objects are searched for in, in search order: each LD_LIBRARY_PATH entry followed by the standard
+// library folders, since the dynamic linker tries LD_LIBRARY_PATH before its defaults.  Every folder is read once per
+// run, the first time any search needs it, and all searches after that are answered from memory.
+const std::vector<ViaSystemLinux::SystemObjectFolder> &ViaSystemLinux::GetSystemObjectFolders() {
+    std::call_once(_system_object_folders_once, [this]() {
+        const char *default_folder_locs[] = {
+            "/usr/lib",
 #if __x86_64__ || __ppc64__
-                path_to_check = "/usr/lib/x86_64-linux-gnu";
+            "/usr/lib/x86_64-linux-gnu",
+            "/usr/lib64",
+            "/usr/local/lib",
+            "/usr/local/lib64",
 #else
-                path_to_check = "/usr/lib/i386-linux-gnu";
+            "/usr/lib/i386-linux-gnu",
+            "/usr/lib32",
+            "/usr/local/lib",
+            "/usr/local/lib32",
 #endif
-                break;
-            case 2:
-#if __x86_64__ || __ppc64__
-                path_to_check = "/usr/lib64";
-#else
-                path_to_check = "/usr/lib32";
-#endif
-                break;
-            case 3:
-                path_to_check = "/usr/local/lib";
-                break;
-            case 4:
-#if __x86_64__ || __ppc64__
-                path_to_check = "/usr/local/lib64";
-#else
-                path_to_check = "/usr/local/lib32";
-#endif
-                break;
-            default:
-                continue;
+        };
+        std::vector<std::string> folder_locs;
+
+        // LD_LIBRARY_PATH may have multiple folders listed in it (colon ':' delimited)
+        const char *env_value = GetSystemEnvironmentValue("LD_LIBRARY_PATH");
+        if (env_value != NULL) {
+            // Split a copy, since strtok_r writes into the string and other threads may be reading the environment
+            std::string path_list = env_value;
+            char *save_ptr = NULL;
+            char *tok = strtok_r(&path_list[0], ":", &save_ptr);
+            while (tok != NULL) {
+                if (strlen(tok) > 0) {
+                    folder_locs.push_back(tok);
+                }
+                tok = strtok_r(NULL, ":", &save_ptr);
+            }
         }
+        folder_locs.insert(folder_locs.end(), std::begin(default_folder_locs), std::end(default_folder_locs));
+
+        for (std::string &folder_loc : folder_locs) {
+            SystemObjectFolder folder;
+            folder_loc = InSysroot(folder_loc);
+            auto read_before = std::find_if(_system_object_folders.begin(), _system_object_folders.end(),
+                                            [&folder_loc](const SystemObjectFolder &read) { return read.path == folder_loc; });
+            if (read_before != _system_object_folders.end()) {
+                folder = *read_before;
+            } else {
+                ReadSystemObjectFolder(folder_loc, folder);
+            }
+            _system_object_folders.push_back(folder);
+        }
+    });
+    return _system_object_folders;
+}
+
+// Utility function to determine if a driver may exist in the folder.
+static bool CheckDriver(ViaSystemLinux *via_sys_linux, const ViaSystemLinux::SystemObjectFolder &folder,
+                        const std::string &object_name) {
+    (void)via_sys_linux;
+    return std::binary_search(folder.file_names.begin(), folder.file_names.end(), object_name);
+}
+
+// Pointer to a function used to validate if the system object is found
+typedef bool (*PFN_CheckIfValid)(ViaSystemLinux *via_sys_linux, const ViaSystemLinux::SystemObjectFolder &folder,
+                                 const std::string &object_name);
 
-        if (func(via_sys_linux, path_to_check, object_name)) {
-            location = path_to_check + "/" + object_name;
+static bool FindLinuxSystemObject(ViaSystemLinux *via_sys_linux, const std::string &object_name, std::string &location,
+                                  PFN_CheckIfValid func, bool break_on_first) {
+    bool found_one = false;
+
+    for (const ViaSystemLinux::SystemObjectFolder &folder : via_sys_linux->GetSystemObjectFolders()) {
+        if (func(via_sys_linux, folder, object_name)) {
+            location = folder.path + "/" + object_name;
 
             // We found one runtime, clear any failures
             found_one = true;
             if (break_on_first) {
-                goto out;
+                break;
             }
         }
     }
 
-    // LD_LIBRARY_PATH may have multiple folders listed in it (colon
-    // ':' delimited)
-    if (env_value != NULL) {
-        char *tok = strtok(env_value, ":");
-        while (tok != NULL) {
-            if (strlen(tok) > 0) {
-                path_to_check = tok;
-                if (func(via_sys_linux, path_to_check, object_name)) {
-                    location = path_to_check + "/" + object_name;
-
-                    // We found one runtime, clear any failures
-                    found_one = true;
-                }
+    return found_one;
+}
+
+// What VerifyElfLibrary needs to know about a library, read from its ELF headers
+struct ElfLibraryInfo {
+    unsigned char elf_class;
+    unsigned char data_encoding;
+    uint16_t type;
+    uint16_t machine;
+    std::vector<std::string> needed;
+    std::vector<std::string> rpath;
+    std::vector<std::string> runpath;
+    std::vector<std::string> exported_vk_functions;
+};
+
+static bool ReadFileAt(int fd, uint64_t offset, void *buffer, size_t size) {
+    char *dst = reinterpret_cast<char *>(buffer);
+    while (size > 0) {
+        ssize_t count = pread(fd, dst, size, static_cast<off_t>(offset));
+        if (count <= 0) {
+            return false;
+        }
+        dst += count;
+        offset += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Whether size bytes starting at offset lie inside a file of file_size bytes.  Every table is checked this way before
+// anything is allocated for it, so a corrupt header can't ask for more memory than the file could hold.
+static bool InElfFile(uint64_t file_size, uint64_t offset, uint64_t size) {
+    return offset <= file_size && size <= file_size - offset;
+}
+
+// Read the string table in section link, which symbol and dynamic entry names index into.
+template <typename Shdr>
+static bool ReadElfStringTable(int fd, uint64_t file_size, const std::vector<Shdr> &sections, uint32_t link,
+                               std::vector<char> &strings) {
+    if (link >= sections.size() || sections[link].sh_type != SHT_STRTAB ||
+        !InElfFile(file_size, sections[link].sh_offset, sections[link].sh_size)) {
+        return false;
+    }
+    strings.resize(sections[link].sh_size + 1);
+    strings.back() = '\0';
+    return ReadFileAt(fd, sections[link].sh_offset, strings.data(), sections[link].sh_size);
+}
+
+static const char *ElfString(const std::vector<char> &strings, uint64_t offset) {
+    return (offset < strings.size()) ? &strings[offset] : "";
+}
+
+static void SplitElfSearchPath(const char *search_path, std::vector<std::string> &folders) {
+    std::string path_list = search_path;
+    char *save_ptr = NULL;
+    for (char *tok = strtok_r(&path_list[0], ":", &save_ptr); tok != NULL; tok = strtok_r(NULL, ":", &save_ptr)) {
+        folders.push_back(tok);
+    }
+}
+
+// Add the Vulkan functions a dynamic symbol table defines to the library's exports.
+template <typename Sym>
+static void AddElfVkFunctions(const std::vector<Sym> &symbols, const std::vector<char> &strings, ElfLibraryInfo &info) {
+    for (const Sym &symbol : symbols) {
+        // The binding and type are packed the same way for both ELF classes
+        unsigned char binding = ELF64_ST_BIND(symbol.st_info);
+        unsigned char type = ELF64_ST_TYPE(symbol.st_info);
+        const char *name = ElfString(strings, symbol.st_name);
+        if (symbol.st_shndx != SHN_UNDEF && (binding == STB_GLOBAL || binding == STB_WEAK) &&
+            (type == STT_FUNC || type == STT_GNU_IFUNC) && 0 == strncmp(name, "vk", 2)) {
+            info.exported_vk_functions.push_back(name);
+        }
+    }
+}
+
+// Add the dependencies and search paths a dynamic table lists.
+template <typename Dyn>
+static void AddElfDynamicEntries(const std::vector<Dyn> &entries, const std::vector<char> &strings, ElfLibraryInfo &info) {
+    for (const Dyn &entry : entries) {
+        if (entry.d_tag == DT_NULL) {
+            break;
+        } else if (entry.d_tag == DT_NEEDED) {
+            info.needed.push_back(ElfString(strings, entry.d_un.d_val));
+        } else if (entry.d_tag == DT_RPATH) {
+            SplitElfSearchPath(ElfString(strings, entry.d_un.d_val), info.rpath);
+        } else if (entry.d_tag == DT_RUNPATH) {
+            SplitElfSearchPath(ElfString(strings, entry.d_un.d_val), info.runpath);
+        }
+    }
+}
+
+// Find the file offset an address inside one of the loaded segments is loaded from.
+template <typename Phdr>
+static bool ElfAddressToOffset(const std::vector<Phdr> &segments, uint64_t address, uint64_t &offset) {
+    for (const Phdr &segment : segments) {
+        if (segment.p_type == PT_LOAD && address >= segment.p_vaddr && address - segment.p_vaddr < segment.p_filesz) {
+            offset = segment.p_offset + (address - segment.p_vaddr);
+            return true;
+        }
+    }
+    return false;
+}
+
+// The dynamic segment doesn't say how many symbols its symbol table holds, but the hash tables do.  DT_HASH starts with
+// its bucket count followed by its chain count, which is one per symbol.
+static bool CountElfHashSymbols(int fd, uint64_t offset, uint64_t &count) {
+    uint32_t counts[2];
+    if (!ReadFileAt(fd, offset, counts, sizeof(counts))) {
+        return false;
+    }
+    count = counts[1];
+    return true;
+}
+
+// DT_GNU_HASH only hashes the symbols from symoffset on, in chains whose last entry has its low bit set, so the symbol
+// count is one past the end of the chain that starts last.
+static bool CountElfGnuHashSymbols(int fd, uint64_t file_size, uint64_t offset, size_t bloom_word_size, uint64_t &count) {
+    // The bucket count, symoffset, bloom filter word count and bloom filter shift
+    uint32_t header[4];
+    if (!ReadFileAt(fd, offset, header, sizeof(header))) {
+        return false;
+    }
+    uint64_t buckets_offset = offset + sizeof(header) + static_cast<uint64_t>(header[2]) * bloom_word_size;
+    uint64_t buckets_size = static_cast<uint64_t>(header[0]) * sizeof(uint32_t);
+    if (!InElfFile(file_size, buckets_offset, buckets_size)) {
+        return false;
+    }
+    std::vector<uint32_t> buckets(header[0]);
+    if (!ReadFileAt(fd, buckets_offset, buckets.data(), buckets_size)) {
+        return false;
+    }
+    // Empty buckets are zero
+    uint32_t last_start = 0;
+    for (uint32_t bucket : buckets) {
+        last_start = std::max(last_start, bucket);
+    }
+    if (last_start < header[1]) {
+        count = header[1];
+        return true;
+    }
+    uint64_t symbol = last_start;
+    uint32_t chain = 0;
+    do {
+        if (!ReadFileAt(fd, buckets_offset + buckets_size + (symbol - header[1]) * sizeof(chain), &chain, sizeof(chain))) {
+            return false;
+        }
+        symbol++;
+    } while ((chain & 1) == 0);
+    count = symbol;
+    return true;
+}
+
+// Read the dependencies, search paths and exported Vulkan functions through the dynamic segment, the way the dynamic
+// linker does, which works for libraries stripped of their section headers too.  found is left false when the library
+// has no dynamic segment.
+template <typename Ehdr, typename Phdr, typename Sym, typename Dyn>
+static bool ReadElfDynamicSegment(int fd, uint64_t file_size, const Ehdr &header, ElfLibraryInfo &info, bool &found,
+                                  std::string &error) {
+    found = false;
+    if (header.e_phoff == 0 || header.e_phnum == 0) {
+        return true;
+    }
+    std::vector<Phdr> segments(header.e_phnum);
+    if (header.e_phentsize != sizeof(Phdr) ||
+        !InElfFile(file_size, header.e_phoff, static_cast<uint64_t>(header.e_phnum) * sizeof(Phdr)) ||
+        !ReadFileAt(fd, header.e_phoff, segments.data(), segments.size() * sizeof(Phdr))) {
+        error = "Truncated ELF program headers";
+        return false;
+    }
+    auto dynamic =
+        std::find_if(segments.begin(), segments.end(), [](const Phdr &segment) { return segment.p_type == PT_DYNAMIC; });
+    if (dynamic == segments.end()) {
+        return true;
+    }
+    if (!InElfFile(file_size, dynamic->p_offset, dynamic->p_filesz)) {
+        error = "Truncated ELF dynamic segment";
+        return false;
+    }
+    std::vector<Dyn> entries(dynamic->p_filesz / sizeof(Dyn));
+    if (!ReadFileAt(fd, dynamic->p_offset, entries.data(), entries.size() * sizeof(Dyn))) {
+        error = "Truncated ELF dynamic segment";
+        return false;
+    }
+
+    // The other tables are given by the address they're loaded at, which the loaded segments map back to the file
+    uint64_t string_address = 0;
+    uint64_t string_size = 0;
+    uint64_t symbol_address = 0;
+    uint64_t symbol_size = sizeof(Sym);
+    uint64_t hash_address = 0;
+    uint64_t gnu_hash_address = 0;
+    for (const Dyn &entry : entries) {
+        if (entry.d_tag == DT_NULL) {
+            break;
+        } else if (entry.d_tag == DT_STRTAB) {
+            string_address = entry.d_un.d_ptr;
+        } else if (entry.d_tag == DT_STRSZ) {
+            string_size = entry.d_un.d_val;
+        } else if (entry.d_tag == DT_SYMTAB) {
+            symbol_address = entry.d_un.d_ptr;
+        } else if (entry.d_tag == DT_SYMENT) {
+            symbol_size = entry.d_un.d_val;
+        } else if (entry.d_tag == DT_HASH) {
+            hash_address = entry.d_un.d_ptr;
+        } else if (entry.d_tag == DT_GNU_HASH) {
+            gnu_hash_address = entry.d_un.d_ptr;
+        }
+    }
+
+    uint64_t string_offset = 0;
+    if (string_address == 0 || !ElfAddressToOffset(segments, string_address, string_offset) ||
+        !InElfFile(file_size, string_offset, string_size)) {
+        error = "Bad ELF string table";
+        return false;
+    }
+    std::vector<char> strings(string_size + 1, '\0');
+    if (!ReadFileAt(fd, string_offset, strings.data(), string_size)) {
+        error = "Bad ELF string table";
+        return false;
+    }
+    AddElfDynamicEntries(entries, strings, info);
+
+    if (symbol_address != 0) {
+        uint64_t symbol_offset = 0;
+        uint64_t hash_offset = 0;
+        uint64_t symbol_count = 0;
+        bool counted = false;
+        if (hash_address != 0 && ElfAddressToOffset(segments, hash_address, hash_offset)) {
+            counted = CountElfHashSymbols(fd, hash_offset, symbol_count);
+        } else if (gnu_hash_address != 0 && ElfAddressToOffset(segments, gnu_hash_address, hash_offset)) {
+            // The bloom filter words are address sized
+            counted = CountElfGnuHashSymbols(fd, file_size, hash_offset, sizeof(header.e_entry), symbol_count);
+        }
+        if (!counted || symbol_size != sizeof(Sym) || !ElfAddressToOffset(segments, symbol_address, symbol_offset) ||
+            !InElfFile(file_size, symbol_offset, symbol_count * sizeof(Sym))) {
+            error = "Bad ELF symbol table";
+            return false;
+        }
+        std::vector<Sym> symbols(symbol_count);
+        if (!ReadFileAt(fd, symbol_offset, symbols.data(), symbols.size() * sizeof(Sym))) {
+            error = "Truncated ELF symbol table";
+            return false;
+        }
+        AddElfVkFunctions(symbols, strings, info);
+    }
+    found = true;
+    return true;
+}
+
+// Read the dependencies, search paths and exported Vulkan functions from the section headers, for libraries without a
+// dynamic segment.
+template <typename Ehdr, typename Shdr, typename Sym, typename Dyn>
+static bool ReadElfSections(int fd, uint64_t file_size, const Ehdr &header, ElfLibraryInfo &info, std::string &error) {
+    if (header.e_shoff == 0 || header.e_shnum == 0 || header.e_shentsize != sizeof(Shdr)) {
+        error = "Missing ELF dynamic segment and section headers";
+        return false;
+    }
+    if (!InElfFile(file_size, header.e_shoff, static_cast<uint64_t>(header.e_shnum) * sizeof(Shdr))) {
+        error = "Truncated ELF section headers";
+        return false;
+    }
+
+    std::vector<Shdr> sections(header.e_shnum);
+    if (!ReadFileAt(fd, header.e_shoff, sections.data(), sections.size() * sizeof(Shdr))) {
+        error = "Truncated ELF section headers";
+        return false;
+    }
+    for (const Shdr &section : sections) {
+        if (section.sh_type != SHT_DYNSYM && section.sh_type != SHT_DYNAMIC) {
+            continue;
+        }
+        std::vector<char> strings;
+        if (!ReadElfStringTable(fd, file_size, sections, section.sh_link, strings)) {
+            error = "Bad ELF string table";
+            return false;
+        }
+        if (!InElfFile(file_size, section.sh_offset, section.sh_size)) {
+            error = (section.sh_type == SHT_DYNSYM) ? "Truncated ELF symbol table" : "Truncated ELF dynamic section";
+            return false;
+        }
+        if (section.sh_type == SHT_DYNSYM) {
+            std::vector<Sym> symbols(section.sh_size / sizeof(Sym));
+            if (!ReadFileAt(fd, section.sh_offset, symbols.data(), symbols.size() * sizeof(Sym))) {
+                error = "Truncated ELF symbol table";
+                return false;
+            }
+            AddElfVkFunctions(symbols, strings, info);
+        } else {
+            std::vector<Dyn> entries(section.sh_size / sizeof(Dyn));
+            if (!ReadFileAt(fd, section.sh_offset, entries.data(), entries.size() * sizeof(Dyn))) {
+                error = "Truncated ELF dynamic section";
+                return false;
             }
-            tok = strtok(NULL, ":");
+            AddElfDynamicEntries(entries, strings, info);
         }
     }
+    return true;
+}
 
-out:
-    return found_one;
+// Read the dependencies, search paths and exported Vulkan functions, through the dynamic segment when the library has
+// one and from the section headers otherwise.  Only the tables needed are read, and nothing in the library is run.
+template <typename Ehdr, typename Phdr, typename Shdr, typename Sym, typename Dyn>
+static bool ReadElfTables(int fd, ElfLibraryInfo &info, std::string &error) {
+    struct stat file_stat;
+    Ehdr header;
+    if (0 != fstat(fd, &file_stat)) {
+        error = strerror(errno);
+        return false;
+    }
+    const uint64_t file_size = static_cast<uint64_t>(file_stat.st_size);
+    if (!ReadFileAt(fd, 0, &header, sizeof(header))) {
+        error = "Truncated ELF header";
+        return false;
+    }
+    bool found_dynamic_segment = false;
+    if (!ReadElfDynamicSegment<Ehdr, Phdr, Sym, Dyn>(fd, file_size, header, info, found_dynamic_segment, error)) {
+        return false;
+    }
+    return found_dynamic_segment || ReadElfSections<Ehdr, Shdr, Sym, Dyn>(fd, file_size, header, info, error);
 }
 
-static bool VerifyOpen(std::string library_file, std::string &error) {
+// Read an ELF file's class, byte order, type and machine, plus its tables when read_tables is set and the file uses
+// via's byte order.
+static bool ReadElfLibraryInfo(const std::string &file, bool read_tables, ElfLibraryInfo &info, std::string &error) {
+    // The type and machine follow the identification bytes in both ELF classes
+    unsigned char ident[EI_NIDENT + 2 * sizeof(uint16_t)];
     bool success = false;
-    void *handle = dlopen(library_file.c_str(), RTLD_NOW | RTLD_LOCAL);
-    if (NULL == handle) {
-        error = dlerror();
+
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+    if (!ReadFileAt(fd, 0, ident, sizeof(ident)) || 0 != memcmp(ident, ELFMAG, SELFMAG)) {
+        error = "Not an ELF file";
     } else {
-        dlclose(handle);
-        success = true;
+        info.elf_class = ident[EI_CLASS];
+        info.data_encoding = ident[EI_DATA];
+        memcpy(&info.type, &ident[EI_NIDENT], sizeof(info.type));
+        memcpy(&info.machine, &ident[EI_NIDENT + sizeof(info.type)], sizeof(info.machine));
+        // The tables are bounds checked against the file, but a large enough file can still run out of memory
+        try {
+            if (!read_tables) {
+                success = true;
+            } else if (info.elf_class == ELFCLASS64) {
+                success = ReadElfTables<Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, Elf64_Sym, Elf64_Dyn>(fd, info, error);
+            } else if (info.elf_class == ELFCLASS32) {
+                success = ReadElfTables<Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, Elf32_Sym, Elf32_Dyn>(fd, info, error);
+            } else {
+                error = "Unknown ELF class";
+            }
+        } catch (const std::bad_alloc &) {
+            error = "Not enough memory to read the ELF tables";
+            success = false;
+        } catch (const std::length_error &) {
+            error = "ELF tables too large to read";
+            success = false;
+        }
+    }
+    close(fd);
+    return success;
+}
+
+// via's own ELF header, read once, which the libraries it checks have to match.  Returns null if it can't be read.
+static const ElfLibraryInfo *GetViaElfInfo(std::string &error) {
+    static ElfLibraryInfo via_info;
+    static std::string via_error;
+    static const bool read_via_info = ReadElfLibraryInfo("/proc/self/exe", false, via_info, via_error);
+    error = via_error;
+    return read_via_info ? &via_info : nullptr;
+}
+
+// The values glibc's ldconfig gives the ABI bits of a linker cache entry's flags (FLAG_X8664_LIB64 and the rest) for
+// libraries built like via.  An empty list accepts every entry, for the machines whose ABIs aren't told apart here.
+static std::vector<uint32_t> GetLinkerCacheAbiFlags(const ElfLibraryInfo &via_info) {
+    const bool is_64_bit = (via_info.elf_class == ELFCLASS64);
+    switch (via_info.machine) {
+        case EM_386:
+        case EM_PPC:
+        case EM_SPARC:
+        case EM_SPARC32PLUS:
+            return {0x0000};
+        case EM_X86_64:
+            return {is_64_bit ? 0x0300u : 0x0800u};
+        case EM_SPARCV9:
+            return {0x0100};
+        case EM_IA_64:
+            return {0x0200};
+        case EM_S390:
+            return {is_64_bit ? 0x0400u : 0x0000u};
+        case EM_PPC64:
+            return {0x0500};
+        case EM_ARM:
+            // Hard and soft float
+            return {0x0900, 0x0b00};
+        case EM_AARCH64:
+            return {0x0a00};
+#ifdef EM_RISCV
+        case EM_RISCV:
+            // Soft and double float
+            return {0x0f00, 0x1000};
+#endif
+        default:
+            return {};
+    }
+}
+
+// The libraries the dynamic linker knows from /etc/ld.so.cache, read once, by name with the path each name loads.  Only
+// the current format, which glibc has written since 2.x, either alone or after the old one, is understood.  A multilib
+// system lists the libraries of every ABI it has, so only the entries flagged for via's are kept.
+const std::map<std::string, std::string> &ViaSystemLinux::GetLinkerCacheLibraries() {
+    std::call_once(_linker_cache_libraries_once, [this]() {
+        const char magic[] = "glibc-ld.so.cache1.1";
+        const size_t header_size = 48;
+        const size_t entry_size = 24;
+        const uint32_t flag_type_mask = 0x00ff;
+        const uint32_t flag_elf_libc6 = 0x0003;
+        const uint32_t flag_abi_mask = 0xff00;
+        std::map<std::string, std::string> &libraries = _linker_cache_libraries;
+        std::string via_error;
+        const ElfLibraryInfo *via_info = GetViaElfInfo(via_error);
+        if (via_info == nullptr) {
+            return;
+        }
+        const std::vector<uint32_t> abi_flags = GetLinkerCacheAbiFlags(*via_info);
+        std::ifstream stream(InSysroot("/etc/ld.so.cache").c_str(), std::ifstream::in | std::ifstream::binary);
+        std::string contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+        size_t start = contents.find(magic);
+        if (start == std::string::npos || contents.size() < start + header_size) {
+            return;
+        }
+        uint32_t library_count;
+        memcpy(&library_count, &contents[start + sizeof(magic) - 1], sizeof(library_count));
+        for (uint32_t library = 0; library < library_count; library++) {
+            size_t entry = start + header_size + library * entry_size;
+            uint32_t flags;
+            uint32_t key;
+            uint32_t value;
+            if (contents.size() < entry + entry_size) {
+                break;
+            }
+            // Each entry starts with its flags, then the offsets of the library name and of its path from the start of
+            // the header
+            memcpy(&flags, &contents[entry], sizeof(flags));
+            memcpy(&key, &contents[entry + 4], sizeof(key));
+            memcpy(&value, &contents[entry + 8], sizeof(value));
+            if ((flags & flag_type_mask) != flag_elf_libc6 ||
+                (!abi_flags.empty() &&
+                 std::find(abi_flags.begin(), abi_flags.end(), flags & flag_abi_mask) == abi_flags.end())) {
+                continue;
+            }
+            // The linker uses the first entry for a name
+            if (start + key < contents.size() && start + value < contents.size()) {
+                libraries.insert(
+                    std::make_pair(std::string(contents.c_str() + start + key), std::string(contents.c_str() + start + value)));
+            }
+        }
+    });
+    return _linker_cache_libraries;
+}
+
+// Look for a dependency in the places the dynamic linker would: DT_RPATH (only without DT_RUNPATH), LD_LIBRARY_PATH,
+// DT_RUNPATH, the linker cache and then the default folders.
+static bool FindElfDependency(ViaSystemLinux *via_sys_linux, const std::string &library_file, const ElfLibraryInfo &info,
+                              const std::string &needed) {
+    if (needed.find('/') != std::string::npos) {
+        return access(via_sys_linux->InSysroot(needed).c_str(), R_OK) != -1;
+    }
+    if (via_sys_linux->GetLinkerCacheLibraries().count(needed) > 0) {
+        return true;
+    }
+
+    std::vector<std::string> folders;
+    if (info.runpath.empty()) {
+        folders.insert(folders.end(), info.rpath.begin(), info.rpath.end());
+    }
+    const char *env_value = via_sys_linux->GetSystemEnvironmentValue("LD_LIBRARY_PATH");
+    if (env_value != NULL) {
+        SplitElfSearchPath(env_value, folders);
+    }
+    folders.insert(folders.end(), info.runpath.begin(), info.runpath.end());
+#if __x86_64__ || __ppc64__
+    folders.push_back("/lib64");
+    folders.push_back("/usr/lib64");
+#endif
+    folders.push_back("/lib");
+    folders.push_back("/usr/lib");
+
+    std::string origin = library_file.substr(0, library_file.rfind('/'));
+    for (std::string folder : folders) {
+        folder = via_sys_linux->InSysroot(folder);
+        size_t origin_pos = folder.find("$ORIGIN");
+        if (origin_pos != std::string::npos) {
+            folder.replace(origin_pos, strlen("$ORIGIN"), origin);
+        }
+        if (access(via_sys_linux->StayInSysroot(folder + "/" + needed).c_str(), R_OK) != -1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check that a driver library would load into via from its ELF headers alone, without loading it: it has to be built
+// for the same architecture as via, find all of its dependencies and export the function the loader starts with.
+static bool VerifyElfLibrary(ViaSystemLinux *via_sys_linux, const std::string &library_file, std::string &error) {
+    std::string via_error;
+    const ElfLibraryInfo *via_info = GetViaElfInfo(via_error);
+    ElfLibraryInfo info;
+
+    if (via_info == nullptr) {
+        error = "Unable to read via's own ELF header: " + via_error;
+        return false;
+    }
+    const std::string file = via_sys_linux->StayInSysroot(library_file);
+    if (!ReadElfLibraryInfo(file, false, info, error)) {
+        return false;
+    }
+    if (info.elf_class != ELFCLASS64 && info.elf_class != ELFCLASS32) {
+        error = "Unknown ELF class";
+        return false;
+    }
+    if (info.elf_class != via_info->elf_class) {
+        error = (info.elf_class == ELFCLASS32) ? "32-bit library, but via is 64-bit" : "64-bit library, but via is 32-bit";
+        return false;
+    }
+    if (info.data_encoding != via_info->data_encoding || info.machine != via_info->machine) {
+        error = "Built for a different architecture (ELF machine " + std::to_string(info.machine) + ", via uses " +
+                std::to_string(via_info->machine) + ")";
+        return false;
+    }
+    if (info.type != ET_DYN) {
+        error = "Not a shared library";
+        return false;
+    }
+    if (!ReadElfLibraryInfo(file, true, info, error)) {
+        return false;
+    }
+    for (const std::string &needed : info.needed) {
+        if (!FindElfDependency(via_sys_linux, library_file, info, needed)) {
+            error = "Missing dependency " + needed;
+            return false;
+        }
+    }
+    for (const char *function : {"vk_icdGetInstanceProcAddr", "vkGetInstanceProcAddr"}) {
+        if (std::find(info.exported_vk_functions.begin(), info.exported_vk_functions.end(), function) !=
+            info.exported_vk_functions.end()) {
+            return true;
+        }
+    }
+    error = "Exports neither vk_icdGetInstanceProcAddr nor vkGetInstanceProcAddr";
+    return false;
+}
+
+// Check the library would load, reusing the result of an earlier run if neither the library nor the linker cache and,
+// outside a sysroot, LD_LIBRARY_PATH its dependencies are found through have changed since.  Failures aren't kept, since installing a
+// missing dependency into one of the default folders changes none of these.
+bool ViaSystemLinux::VerifyLibrary(const std::string &library_file, std::string &error) {
+    bool success = false;
+    std::vector<std::string> env_vars;
+    if (_sysroot.empty()) {
+        env_vars.push_back("LD_LIBRARY_PATH");
+    }
+    Json::Value inputs = ScanCacheInputs({InSysroot("/etc/ld.so.cache")}, env_vars);
+    std::string file = StayInSysroot(library_file);
+    if (FindCachedResult("verify_elf", library_file, file, inputs, success, error)) {
+        return success;
+    }
+    success = VerifyElfLibrary(this, library_file, error);
+    if (success) {
+        CacheResult("verify_elf", library_file, file, inputs, success, error);
     }
     return success;
 }
@@ -473,7 +1184,7 @@ bool ViaSystemLinux::ReadDriverJson(std::string cur_driver_json, bool &found_lib
     char generic_string[2048];
     uint32_t j = 0;
 
-    stream = new std::ifstream(cur_driver_json.c_str(), std::ifstream::in);
+    stream = new std::ifstream(StayInSysroot(cur_driver_json).c_str(), std::ifstream::in);
     if (nullptr == stream || stream->fail()) {
         PrintBeginTableRow();
         PrintTableElement("");
@@ -535,47 +1246,44 @@ bool ViaSystemLinux::ReadDriverJson(std::string cur_driver_json, bool &found_lib
         PrintEndTableRow();
 
         if (DetermineJsonLibraryPath(cur_driver_json.c_str(), driver_name.c_str(), full_driver_path)) {
+            full_driver_path = StayInSysroot(full_driver_path);
+
             // First try the generated path.
             if (access(full_driver_path.c_str(), R_OK) != -1) {
                 found_lib = true;
-                could_load = VerifyOpen(full_driver_path, load_error);
+                could_load = VerifyLibrary(full_driver_path, load_error);
             } else if (driver_name.find("/") == std::string::npos) {
                 if (FindLinuxSystemObject(this, driver_name, location, CheckDriver, true)) {
                     found_lib = true;
-                    could_load = VerifyOpen(location, load_error);
+                    could_load = VerifyLibrary(location, load_error);
                 }
             }
         }
-        if (!found_lib) {
-            FILE *fp;
-            sprintf(generic_string, "/sbin/ldconfig -v -N -p | grep %s | awk \'{ print $4 }\'", driver_name.c_str());
-            fp = popen(generic_string, "r");
-            if (fp == NULL) {
-                snprintf(generic_string, 1023,
-                         "Failed to find driver %s "
-                         "referenced by JSON %s",
-                         driver_name.c_str(), cur_driver_json.c_str());
+        if (!found_lib && driver_name.find("/") == std::string::npos) {
+            // The dynamic linker also finds libraries by name through its cache
+            const std::map<std::string, std::string> &cache_libraries = GetLinkerCacheLibraries();
+            auto cached = cache_libraries.find(driver_name);
+            if (cached != cache_libraries.end()) {
+                snprintf(generic_string, 2047, "Found at %s", cached->second.c_str());
                 PrintBeginTableRow();
                 PrintTableElement("");
                 PrintTableElement("");
                 PrintTableElement(generic_string);
                 PrintEndTableRow();
-            } else {
-                char query_res[1024];
-
-                // Read the output a line at a time - output it.
-                if (fgets(query_res, sizeof(query_res) - 1, fp) != NULL) {
-                    snprintf(generic_string, 2047, "Found at %s", query_res);
-                    PrintBeginTableRow();
-                    PrintTableElement("");
-                    PrintTableElement("");
-                    PrintTableElement(generic_string);
-                    PrintEndTableRow();
-                    found_lib = true;
-                    could_load = VerifyOpen(query_res, load_error);
-                }
-                fclose(fp);
+                found_lib = true;
+                could_load = VerifyLibrary(InSysroot(cached->second), load_error);
             }
+        }
+        if (!found_lib) {
+            snprintf(generic_string, 1023,
+                     "Failed to find driver %s "
+                     "referenced by JSON %s",
+                     driver_name.c_str(), cur_driver_json.c_str());
+            PrintBeginTableRow();
+            PrintTableElement("");
+            PrintTableElement("");
+            PrintTableElement(generic_string);
+            PrintEndTableRow();
         } else if (!could_load) {
             PrintBeginTableRow();
             PrintTableElement("");
@@ -656,48 +1364,64 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemDriverInfo() {
     ViaResults result = VIA_SUCCESSFUL;
     bool found_json = false;
     bool found_lib = false;
-    bool found_this_lib = false;
     uint32_t i = 0;
     char generic_string[1024];
     char cur_vulkan_driver_json[1024];
-    char *home_env_value = NULL;
-    char *drivers_env_value = NULL;
-    char *icd_env_value = NULL;
+    const char *home_env_value = NULL;
+    const char *drivers_env_value = NULL;
+    const char *icd_env_value = NULL;
     std::vector<std::string> driver_paths;
     int drivers_path_index = -1;
 
+    // Each driver JSON is read, and its library checked, on a worker thread
+    std::deque<ViaResults> driver_json_results;
+    auto read_driver_json = [&](const std::string &driver_json) {
+        driver_json_results.push_back(VIA_MISSING_DRIVER_JSON);
+        DeferRows(
+            [this, driver_json]() -> ViaResults {
+                bool found_this_lib = false;
+                if (!ReadDriverJson(driver_json, found_this_lib)) {
+                    return VIA_MISSING_DRIVER_JSON;
+                }
+                return found_this_lib ? VIA_SUCCESSFUL : VIA_MISSING_DRIVER_LIB;
+            },
+            &driver_json_results.back());
+    };
+
     PrintBeginTable("Vulkan Driver Info", 3);
 
     // There are several folders ICD JSONs could be in.  So,
     // try all of them.
-    driver_paths.push_back("/etc/vulkan/icd.d");
-    driver_paths.push_back("/usr/share/vulkan/icd.d");
-    driver_paths.push_back("/usr/local/etc/vulkan/icd.d");
-    driver_paths.push_back("/usr/local/share/vulkan/icd.d");
+    driver_paths.push_back(InSysroot("/etc/vulkan/icd.d"));
+    driver_paths.push_back(InSysroot("/usr/share/vulkan/icd.d"));
+    driver_paths.push_back(InSysroot("/usr/local/etc/vulkan/icd.d"));
+    driver_paths.push_back(InSysroot("/usr/local/share/vulkan/icd.d"));
 
-    home_env_value = getenv("HOME");
+    home_env_value = GetSystemEnvironmentValue("HOME");
     if (NULL == home_env_value) {
         driver_paths.push_back("~/.local/share/vulkan/icd.d");
     } else {
         std::string home_icd_dir = home_env_value;
         home_icd_dir += "/.local/share/vulkan/icd.d";
-        driver_paths.push_back(home_icd_dir);
+        driver_paths.push_back(InSysroot(home_icd_dir));
     }
 
     // The user can override the drivers path manually
-    drivers_env_value = getenv("VK_DRIVERS_PATH");
+    drivers_env_value = GetSystemEnvironmentValue("VK_DRIVERS_PATH");
     if (NULL != drivers_env_value) {
         drivers_path_index = driver_paths.size();
         // VK_DRIVERS_PATH may have multiple folders listed in it (colon
         // ':' delimited)
-        char *tok = strtok(drivers_env_value, ":");
+        std::string path_list = drivers_env_value;
+        char *save_ptr = NULL;
+        char *tok = strtok_r(&path_list[0], ":", &save_ptr);
         if (tok != NULL) {
             while (tok != NULL) {
-                driver_paths.push_back(tok);
-                tok = strtok(NULL, ":");
+                driver_paths.push_back(InSysroot(tok));
+                tok = strtok_r(NULL, ":", &save_ptr);
             }
         } else {
-            driver_paths.push_back(drivers_env_value);
+            driver_paths.push_back(InSysroot(drivers_env_value));
         }
     }
 
@@ -750,16 +1474,13 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemDriverInfo() {
                 PrintTableElement("");
                 PrintEndTableRow();
 
-                if (ReadDriverJson(cur_vulkan_driver_json, found_this_lib)) {
-                    found_json = true;
-                    found_lib |= found_this_lib;
-                }
+                read_driver_json(cur_vulkan_driver_json);
             }
         }
     }
 
     // The user can specify particularly what driver files to use
-    icd_env_value = getenv("VK_ICD_FILENAMES");
+    icd_env_value = GetSystemEnvironmentValue("VK_ICD_FILENAMES");
     if (NULL != icd_env_value) {
         PrintBeginTableRow();
         PrintTableElement("VK_ICD_FILENAMES");
@@ -769,42 +1490,40 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemDriverInfo() {
 
         // VK_ICD_FILENAMES may have multiple folders listed in it (colon
         // ':' delimited)
-        char *tok = strtok(icd_env_value, ":");
+        std::string path_list = icd_env_value;
+        char *save_ptr = NULL;
+        char *tok = strtok_r(&path_list[0], ":", &save_ptr);
         if (tok != NULL) {
             while (tok != NULL) {
-                if (access(tok, R_OK) != -1) {
+                std::string icd_file = InSysroot(tok);
+                if (access(icd_file.c_str(), R_OK) != -1) {
                     PrintBeginTableRow();
-                    PrintTableElement(tok, VIA_ALIGN_RIGHT);
+                    PrintTableElement(icd_file, VIA_ALIGN_RIGHT);
                     PrintTableElement("");
                     PrintTableElement("");
                     PrintEndTableRow();
-                    if (ReadDriverJson(tok, found_this_lib)) {
-                        found_json = true;
-                        found_lib |= found_this_lib;
-                    }
+                    read_driver_json(icd_file);
                 } else {
                     PrintBeginTableRow();
-                    PrintTableElement(tok, VIA_ALIGN_RIGHT);
+                    PrintTableElement(icd_file, VIA_ALIGN_RIGHT);
                     PrintTableElement("No such file");
                     PrintTableElement("");
                     PrintEndTableRow();
                 }
-                tok = strtok(NULL, ":");
+                tok = strtok_r(NULL, ":", &save_ptr);
             }
         } else {
-            if (access(icd_env_value, R_OK) != -1) {
+            std::string icd_file = InSysroot(icd_env_value);
+            if (access(icd_file.c_str(), R_OK) != -1) {
                 PrintBeginTableRow();
-                PrintTableElement(icd_env_value, VIA_ALIGN_RIGHT);
+                PrintTableElement(icd_file, VIA_ALIGN_RIGHT);
                 PrintTableElement("");
                 PrintTableElement("");
                 PrintEndTableRow();
-                if (ReadDriverJson(icd_env_value, found_this_lib)) {
-                    found_json = true;
-                    found_lib |= found_this_lib;
-                }
+                read_driver_json(icd_file);
             } else {
                 PrintBeginTableRow();
-                PrintTableElement(icd_env_value, VIA_ALIGN_RIGHT);
+                PrintTableElement(icd_file, VIA_ALIGN_RIGHT);
                 PrintTableElement("No such file");
                 PrintTableElement("");
                 PrintEndTableRow();
@@ -812,6 +1531,12 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemDriverInfo() {
         }
     }
 
+    GenerateDeferredRows();
+    for (ViaResults driver_json_result : driver_json_results) {
+        found_json |= (driver_json_result != VIA_MISSING_DRIVER_JSON);
+        found_lib |= (driver_json_result == VIA_SUCCESSFUL);
+    }
+
     PrintEndTable();
 
     if (!found_json) {
@@ -826,74 +1551,57 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemDriverInfo() {
 // Print out all the runtime files found in a given location.  This way we
 // capture the full state of the system.
 ViaSystem::ViaResults ViaSystemLinux::PrintRuntimesInFolder(std::string &folder_loc, std::string &object_name, bool print_header) {
-    DIR *runtime_dir;
+    // Folders outside of the search path aren't in the index, so read them now
+    for (const SystemObjectFolder &folder : GetSystemObjectFolders()) {
+        if (folder.path == folder_loc) {
+            return PrintRuntimesInFolder(folder, object_name, print_header);
+        }
+    }
+    SystemObjectFolder folder;
+    ReadSystemObjectFolder(folder_loc, folder);
+    return PrintRuntimesInFolder(folder, object_name, print_header);
+}
+
+ViaSystem::ViaResults ViaSystemLinux::PrintRuntimesInFolder(const SystemObjectFolder &folder, const std::string &object_name,
+                                                            bool print_header) {
     ViaResults res = VIA_SUCCESSFUL;
 
-    runtime_dir = opendir(folder_loc.c_str());
-    if (NULL != runtime_dir) {
+    if (folder.exists) {
         bool file_found = false;
-        FILE *pfp;
         uint32_t i = 0;
-        dirent *cur_ent;
-        std::string command_str;
         std::stringstream generic_str;
-        char path[1035];
+        char link_target[1035];
 
         if (print_header) {
             PrintBeginTableRow();
-            PrintTableElement(folder_loc, VIA_ALIGN_RIGHT);
+            PrintTableElement(folder.path, VIA_ALIGN_RIGHT);
             PrintTableElement("");
             PrintTableElement("");
             PrintEndTableRow();
         }
 
-        while ((cur_ent = readdir(runtime_dir)) != NULL) {
-            if (NULL != strstr(cur_ent->d_name, object_name.c_str()) && strlen(cur_ent->d_name) == 14) {
-                // Get the source of this symbolic link
-                command_str = "stat -c%N \'";
-                command_str += folder_loc;
-                command_str += "/";
-                command_str += cur_ent->d_name;
-                command_str += "\'";
-                pfp = popen(command_str.c_str(), "r");
+        for (const std::string &file_name : folder.file_names) {
+            if (std::string::npos != file_name.find(object_name) && file_name.size() == 14) {
+                std::string full_name = folder.path + "/" + file_name;
 
                 generic_str << "[" << i++ << "]";
 
                 PrintBeginTableRow();
                 PrintTableElement(generic_str.str(), VIA_ALIGN_RIGHT);
+                PrintTableElement(full_name);
 
                 file_found = true;
 
-                if (pfp == NULL) {
-                    PrintTableElement(cur_ent->d_name);
-                    PrintTableElement("Failed to retrieve symbolic link");
-                    res = VIA_SYSTEM_CALL_FAILURE;
+                // Show the source of a symbolic link
+                ssize_t len = readlink(full_name.c_str(), link_target, sizeof(link_target) - 1);
+                if (len > 0) {
+                    link_target[len] = '\0';
+                    PrintTableElement(link_target);
                 } else {
-                    if (NULL != fgets(path, sizeof(path) - 1, pfp)) {
-                        std::string cmd = path;
-                        size_t arrow_loc = cmd.find("->");
-                        if (arrow_loc == std::string::npos) {
-                            std::string trimmed_path = TrimWhitespace(path, " \t\n\r\'\"");
-
-                            PrintTableElement(trimmed_path);
-                            PrintTableElement("");
-                        } else {
-                            std::string before_arrow = cmd.substr(0, arrow_loc);
-                            std::string trim_before = TrimWhitespace(before_arrow, " \t\n\r\'\"");
-                            std::string after_arrow = cmd.substr(arrow_loc + 2, std::string::npos);
-                            std::string trim_after = TrimWhitespace(after_arrow, " \t\n\r\'\"");
-                            PrintTableElement(trim_before);
-                            PrintTableElement(trim_after);
-                        }
-                    } else {
-                        PrintTableElement(cur_ent->d_name);
-                        PrintTableElement("Failed to retrieve symbolic link");
-                    }
-
-                    PrintEndTableRow();
-
-                    pclose(pfp);
+                    PrintTableElement("");
                 }
+
+                PrintEndTableRow();
             }
         }
         if (!file_found) {
@@ -903,10 +1611,9 @@ ViaSystem::ViaResults ViaSystemLinux::PrintRuntimesInFolder(std::string &folder_
             PrintTableElement("");
             PrintEndTableRow();
         }
-        closedir(runtime_dir);
     } else {
         PrintBeginTableRow();
-        PrintTableElement(folder_loc, VIA_ALIGN_RIGHT);
+        PrintTableElement(folder.path, VIA_ALIGN_RIGHT);
         PrintTableElement("No such folder");
         PrintTableElement("");
         PrintEndTableRow();
@@ -916,8 +1623,9 @@ ViaSystem::ViaResults ViaSystemLinux::PrintRuntimesInFolder(std::string &folder_
 }
 
 // Utility function to determine if a runtime exists in the folder
-static bool CheckRuntime(ViaSystemLinux *via_sys_linux, std::string &folder_loc, std::string &object_name) {
-    return (ViaSystem::VIA_SUCCESSFUL == via_sys_linux->PrintRuntimesInFolder(folder_loc, object_name));
+static bool CheckRuntime(ViaSystemLinux *via_sys_linux, const ViaSystemLinux::SystemObjectFolder &folder,
+                         const std::string &object_name) {
+    return (ViaSystem::VIA_SUCCESSFUL == via_sys_linux->PrintRuntimesInFolder(folder, object_name));
 }
 
 ViaSystem::ViaResults ViaSystemLinux::PrintSystemLoaderInfo() {
@@ -942,7 +1650,8 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemLoaderInfo() {
         result = VIA_VULKAN_CANT_FIND_RUNTIME;
     }
 
-    ssize_t len = ::readlink("/proc/self/exe", buff, 1023);
+    // The runtime via itself loaded says nothing about the one installed in a sysroot
+    ssize_t len = _sysroot.empty() ? ::readlink("/proc/self/exe", buff, 1023) : -1;
     if (len != -1) {
         buff[len] = '\0';
 
@@ -1019,7 +1728,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintExplicitLayersInFolder(const std::str
     ViaResults res = VIA_SUCCESSFUL;
     DIR *layer_dir;
 
-    layer_dir = opendir(folder_loc.c_str());
+    layer_dir = opendir(StayInSysroot(folder_loc).c_str());
     if (NULL != layer_dir) {
         dirent *cur_ent;
         std::string cur_layer;
@@ -1046,7 +1755,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintExplicitLayersInFolder(const std::str
 
                 // Parse the JSON file
                 std::ifstream *stream = NULL;
-                stream = new std::ifstream(cur_layer, std::ifstream::in);
+                stream = new std::ifstream(StayInSysroot(cur_layer), std::ifstream::in);
                 if (nullptr == stream || stream->fail()) {
                     PrintBeginTableRow();
                     PrintTableElement("");
@@ -1113,7 +1822,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemSdkInfo() {
     const char vulkan_so_prefix[] = "libvulkan.so.";
     DIR *sdk_dir;
     dirent *cur_ent;
-    char *env_value;
+    const char *env_value;
 
     PrintBeginTable("LunarG Vulkan SDKs", 4);
 
@@ -1122,19 +1831,19 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemSdkInfo() {
         switch (dir) {
             case 0:
                 sdk_env_name = "VK_SDK_PATH";
-                env_value = getenv(sdk_env_name.c_str());
+                env_value = GetSystemEnvironmentValue(sdk_env_name.c_str());
                 if (env_value == NULL) {
                     continue;
                 }
-                sdk_path = env_value;
+                sdk_path = InSysroot(env_value);
                 break;
             case 1:
                 sdk_env_name = "VULKAN_SDK";
-                env_value = getenv(sdk_env_name.c_str());
+                env_value = GetSystemEnvironmentValue(sdk_env_name.c_str());
                 if (env_value == NULL) {
                     continue;
                 }
-                sdk_path = env_value;
+                sdk_path = InSysroot(env_value);
                 break;
             default:
                 result = VIA_UNKNOWN_ERROR;
@@ -1152,7 +1861,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemSdkInfo() {
         for (auto &explicit_layer_path_suffix : explicit_layer_path_suffixes) {
             std::string explicit_layer_path = sdk_path + explicit_layer_path_suffix;
 
-            sdk_dir = opendir(explicit_layer_path.c_str());
+            sdk_dir = opendir(StayInSysroot(explicit_layer_path).c_str());
             if (NULL != sdk_dir) {
                 while ((cur_ent = readdir(sdk_dir)) != NULL) {
                     if (NULL != strstr(cur_ent->d_name, vulkan_so_prefix) && strlen(cur_ent->d_name) == 14) {
@@ -1174,7 +1883,16 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemSdkInfo() {
     std::string upper_os_name = _os_name;
     std::transform(upper_os_name.begin(), upper_os_name.end(), upper_os_name.begin(), ::toupper);
     if (upper_os_name.find("UBUNTU") != std::string::npos || upper_os_name.find("DEBIAN") != std::string::npos) {
-        FILE *dpkg_output = popen("dpkg-query --show --showformat='${Package} ${Version}' vulkan-sdk", "r");
+        std::string dpkg_query = "dpkg-query --show --showformat='${Package} ${Version}' vulkan-sdk";
+        if (!_sysroot.empty()) {
+            // The sysroot comes from the command line, so a quote in it mustn't end the quoted argument
+            std::string admin_dir = InSysroot("/var/lib/dpkg");
+            for (size_t quote = admin_dir.find('\''); quote != std::string::npos; quote = admin_dir.find('\'', quote + 4)) {
+                admin_dir.replace(quote, 1, "'\\''");
+            }
+            dpkg_query += " --admindir='" + admin_dir + "'";
+        }
+        FILE *dpkg_output = popen(dpkg_query.c_str(), "r");
         if (dpkg_output != nullptr) {
             char cur_line[1035];
             std::string install_name;
@@ -1185,7 +1903,8 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemSdkInfo() {
                 if (!strncmp(cur_line, target.c_str(), target.size())) {
                     uint32_t count = 0;
                     // Found it
-                    char *p = strtok(cur_line, " ");
+                    char *save_ptr = NULL;
+                    char *p = strtok_r(cur_line, " ", &save_ptr);
                     while (p) {
                         if (count == 0) {
                             install_name = p;
@@ -1194,7 +1913,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemSdkInfo() {
                             break;
                         }
                         count++;
-                        p = strtok(NULL, " ");
+                        p = strtok_r(NULL, " ", &save_ptr);
                     }
                     break;
                 }
@@ -1245,23 +1964,23 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemImplicitLayerInfo() {
         std::string cur_layer_path;
         switch (dir) {
             case 0:
-                cur_layer_path = "/etc/vulkan/implicit_layer.d";
+                cur_layer_path = InSysroot("/etc/vulkan/implicit_layer.d");
                 break;
             case 1:
-                cur_layer_path = "/usr/share/vulkan/implicit_layer.d";
+                cur_layer_path = InSysroot("/usr/share/vulkan/implicit_layer.d");
                 break;
             case 2:
-                cur_layer_path = "/usr/local/etc/vulkan/implicit_layer.d";
+                cur_layer_path = InSysroot("/usr/local/etc/vulkan/implicit_layer.d");
                 break;
             case 3:
-                cur_layer_path = "/usr/local/share/vulkan/implicit_layer.d";
+                cur_layer_path = InSysroot("/usr/local/share/vulkan/implicit_layer.d");
                 break;
             case 4: {
-                char *env_value = getenv("HOME");
+                const char *env_value = GetSystemEnvironmentValue("HOME");
                 if (NULL == env_value) {
                     cur_layer_path = "~/.local/share/vulkan/implicit_layer.d";
                 } else {
-                    cur_layer_path = env_value;
+                    cur_layer_path = InSysroot(env_value);
                     cur_layer_path += "/.local/share/vulkan/implicit_layer.d";
                 }
                 break;
@@ -1291,7 +2010,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemImplicitLayerInfo() {
                     PrintEndTableRow();
 
                     std::ifstream *stream = NULL;
-                    stream = new std::ifstream(cur_vulkan_layer_json, std::ifstream::in);
+                    stream = new std::ifstream(StayInSysroot(cur_vulkan_layer_json), std::ifstream::in);
                     if (nullptr == stream || stream->fail()) {
                         PrintBeginTableRow();
                         PrintTableElement("");
@@ -1338,7 +2057,7 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemImplicitLayerInfo() {
 
 ViaSystem::ViaResults ViaSystemLinux::PrintSystemExplicitLayerInfo() {
     ViaResults result = VIA_SUCCESSFUL;
-    char *env_value = NULL;
+    const char *env_value = NULL;
     std::string explicit_layer_id;
 
     PrintBeginTable("Vulkan Explicit Layers", 4);
@@ -1359,10 +2078,12 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemExplicitLayerInfo() {
     }
 
     // Look at the VK_LAYER_PATH environment variable paths if it is set.
-    env_value = getenv("VK_LAYER_PATH");
+    env_value = GetSystemEnvironmentValue("VK_LAYER_PATH");
     std::string cur_json;
     if (NULL != env_value) {
-        char *tok = strtok(env_value, ":");
+        std::string path_list = env_value;
+        char *save_ptr = NULL;
+        char *tok = strtok_r(&path_list[0], ":", &save_ptr);
         explicit_layer_id = "VK_LAYER_PATH";
 
         PrintBeginTableRow();
@@ -1376,15 +2097,15 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemExplicitLayerInfo() {
             uint32_t offset = 0;
             std::stringstream cur_name;
             while (NULL != tok) {
-                cur_json = tok;
+                cur_json = InSysroot(tok);
                 cur_name.str("");
                 cur_name << "Path " << offset++;
                 explicit_layer_id = cur_name.str();
                 result = PrintExplicitLayersInFolder(explicit_layer_id, cur_json);
-                tok = strtok(NULL, ":");
+                tok = strtok_r(NULL, ":", &save_ptr);
             }
         } else {
-            cur_json = env_value;
+            cur_json = InSysroot(env_value);
             result = PrintExplicitLayersInFolder(explicit_layer_id, cur_json);
         }
     }
@@ -1402,31 +2123,31 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemExplicitLayerInfo() {
         std::string cur_layer_path;
         std::string explicit_layer_id;
         std::string explicit_layer_path = cur_layer_path;
-        char *env_value = NULL;
+        const char *env_value = NULL;
         switch (dir) {
             case 0:
-                cur_layer_path = "/etc/vulkan/explicit_layer.d";
+                cur_layer_path = InSysroot("/etc/vulkan/explicit_layer.d");
                 explicit_layer_id = "/etc/vulkan";
                 break;
             case 1:
-                cur_layer_path = "/usr/share/vulkan/explicit_layer.d";
+                cur_layer_path = InSysroot("/usr/share/vulkan/explicit_layer.d");
                 explicit_layer_id = "/usr/share/vulkan";
                 break;
             case 2:
-                cur_layer_path = "/usr/local/etc/vulkan/explicit_layer.d";
+                cur_layer_path = InSysroot("/usr/local/etc/vulkan/explicit_layer.d");
                 explicit_layer_id = "/usr/local/etc/vulkan";
                 break;
             case 3:
-                cur_layer_path = "/usr/local/share/vulkan/explicit_layer.d";
+                cur_layer_path = InSysroot("/usr/local/share/vulkan/explicit_layer.d");
                 explicit_layer_id = "/usr/local/share/vulkan";
                 break;
             case 4:
                 explicit_layer_id = "$HOME/.local/share/vulkan/explicit_layer.d";
-                env_value = getenv("HOME");
+                env_value = GetSystemEnvironmentValue("HOME");
                 if (NULL == env_value) {
                     cur_layer_path = "~/.local/share/vulkan/explicit_layer.d";
                 } else {
-                    cur_layer_path = env_value;
+                    cur_layer_path = InSysroot(env_value);
                     cur_layer_path += "/.local/share/vulkan/explicit_layer.d";
                 }
                 break;
@@ -1474,9 +2195,9 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemSettingsFileInfo() {
 
     // If the settings path environment variable is set, use that.
 
-    char *settings_path = getenv("VK_LAYER_SETTINGS_PATH");
+    const char *settings_path = GetSystemEnvironmentValue("VK_LAYER_SETTINGS_PATH");
     if (NULL != settings_path) {
-        std::string full_file = settings_path;
+        std::string full_file = InSysroot(settings_path);
         full_file += '/';
         full_file += settings_file_name;
 
@@ -1490,25 +2211,25 @@ ViaSystem::ViaResults ViaSystemLinux::PrintSystemSettingsFileInfo() {
     } else {
         // There are several folders settings JSONs could be in.  So,
         // try all of them.
-        std::string full_file = "/etc/vulkan/settings.d/";
+        std::string full_file = InSysroot("/etc/vulkan/settings.d/");
         full_file += settings_file_name;
         settings_files.push_back(full_file);
-        full_file = "/usr/share/vulkan/settings.d/";
+        full_file = InSysroot("/usr/share/vulkan/settings.d/");
         full_file += settings_file_name;
         settings_files.push_back(full_file);
-        full_file = "/usr/local/etc/vulkan/settings.d/";
+        full_file = InSysroot("/usr/local/etc/vulkan/settings.d/");
         full_file += settings_file_name;
         settings_files.push_back(full_file);
-        full_file = "/usr/local/share/vulkan/settings.d/";
+        full_file = InSysroot("/usr/local/share/vulkan/settings.d/");
         full_file += settings_file_name;
         settings_files.push_back(full_file);
-        const char *home_env_value = getenv("HOME");
+        const char *home_env_value = GetSystemEnvironmentValue("HOME");
         if (NULL == home_env_value) {
             full_file = "~/.local/share/vulkan/settings.d/";
             full_file += settings_file_name;
             settings_files.push_back(full_file);
         } else {
-            full_file = home_env_value;
+            full_file = InSysroot(home_env_value);
             full_file += "/.local/share/vulkan/settings.d/";
             full_file += settings_file_name;
             settings_files.push_back(full_file);
@@ -1539,6 +2260,13 @@ std::string ViaSystemLinux::GetEnvironmentalVariableValue(const std::string &env
     return return_value;
 }
 
+const char *ViaSystemLinux::GetSystemEnvironmentValue(const char *env_var) const {
+    if (!_sysroot.empty()) {
+        return NULL;
+    }
+    return getenv(env_var);
+}
+
 bool ViaSystemLinux::ExpandPathWithEnvVar(std::string &path) {
     // TBD
     (void)path;
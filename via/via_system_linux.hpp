@@ -21,16 +21,33 @@
 
 #pragma once
 
+#include <map>
+#include <set>
+
 #include "via_system.hpp"
 
 class ViaSystemLinux : public ViaSystem {
    public:
     ViaSystemLinux();
 
+    // A folder searched for system objects, with the names of the files it held when the index was built
+    struct SystemObjectFolder {
+        std::string path;
+        bool exists;
+        std::vector<std::string> file_names;
+    };
+
+    const std::vector<SystemObjectFolder> &GetSystemObjectFolders();
+    const std::map<std::string, std::string> &GetLinkerCacheLibraries();
+    // getenv for the variables that describe where the system being analyzed keeps its libraries and Vulkan files.  This
+    // machine's values say nothing about a sysroot, so they read as unset when one is analyzed.
+    const char *GetSystemEnvironmentValue(const char *env_var) const;
     ViaResults PrintRuntimesInFolder(std::string &folder_loc, std::string &object_name, bool print_header = true);
+    ViaResults PrintRuntimesInFolder(const SystemObjectFolder &folder, const std::string &object_name, bool print_header = true);
 
    protected:
     virtual int RunTestInDirectory(std::string path, std::string test, std::string cmd_line) override;
+    virtual bool CanRunTestsConcurrently() override { return true; }
     virtual ViaResults PrintSystemEnvironmentInfo();
     virtual ViaResults PrintSystemHardwareInfo();
     virtual ViaResults PrintSystemExecutableInfo();
@@ -46,7 +63,13 @@ class ViaSystemLinux : public ViaSystem {
 
    private:
     bool ReadDriverJson(std::string cur_driver_json, bool &found_lib);
+    bool VerifyLibrary(const std::string &library_file, std::string &error);
     ViaResults PrintExplicitLayersInFolder(const std::string &id, std::string &folder_loc);
+
+    std::once_flag _system_object_folders_once;
+    std::vector<SystemObjectFolder> _system_object_folders;
+    std::once_flag _linker_cache_libraries_once;
+    std::map<std::string, std::string> _linker_cache_libraries;
 };
 
 #endif  // VIA_LINUX_TARGET
\ No newline at end of file
@@ -380,7 +380,10 @@ static bool FindMacOSSystemObject(ViaSystemMacOS *via_sys_macos, std::string obj
     // DYLD_LIBRARY_PATH may have multiple folders listed in it (colon
     // ':' delimited)
     if (env_value != NULL) {
-        char *tok = strtok(env_value, ":");
+        // Split a copy, since strtok_r writes into the string and other threads may be reading the environment
+        std::string path_list = env_value;
+        char *save_ptr = NULL;
+        char *tok = strtok_r(&path_list[0], ":", &save_ptr);
         while (tok != NULL) {
             if (strlen(tok) > 0) {
                 path_to_check = tok;
@@ -391,7 +394,7 @@ static bool FindMacOSSystemObject(ViaSystemMacOS *via_sys_macos, std::string obj
                     found_one = true;
                 }
             }
-            tok = strtok(NULL, ":");
+            tok = strtok_r(NULL, ":", &save_ptr);
         }
     }
 
@@ -411,6 +414,22 @@ static bool VerifyOpen(std::string library_file, std::string &error) {
     return success;
 }
 
+// Check the library can be loaded, reusing the result of an earlier run if neither the library nor DYLD_LIBRARY_PATH
+// and DYLD_FALLBACK_LIBRARY_PATH have changed since.  Failures aren't kept, since installing a missing dependency
+// changes none of these.
+bool ViaSystemMacOS::VerifyLibrary(const std::string &library_file, std::string &error) {
+    bool success = false;
+    Json::Value inputs = ScanCacheInputs({}, {"DYLD_LIBRARY_PATH", "DYLD_FALLBACK_LIBRARY_PATH"});
+    if (FindCachedResult("verify_open", library_file, library_file, inputs, success, error)) {
+        return success;
+    }
+    success = VerifyOpen(library_file, error);
+    if (success) {
+        CacheResult("verify_open", library_file, library_file, inputs, success, error);
+    }
+    return success;
+}
+
 bool ViaSystemMacOS::ReadDriverJson(std::string cur_driver_json, bool &found_lib) {
     bool found_json = false;
     std::ifstream *stream = NULL;
@@ -487,11 +506,11 @@ bool ViaSystemMacOS::ReadDriverJson(std::string cur_driver_json, bool &found_lib
             // First try the generated path.
             if (access(full_driver_path.c_str(), R_OK) != -1) {
                 found_lib = true;
-                could_load = VerifyOpen(full_driver_path, load_error);
+                could_load = VerifyLibrary(full_driver_path, load_error);
             } else if (driver_name.find("/") == std::string::npos) {
                 if (FindMacOSSystemObject(this, driver_name, location, CheckDriver, true)) {
                     found_lib = true;
-                    could_load = VerifyOpen(location, load_error);
+                    could_load = VerifyLibrary(location, load_error);
                 }
             }
         }
@@ -510,7 +529,7 @@ bool ViaSystemMacOS::ReadDriverJson(std::string cur_driver_json, bool &found_lib
                     PrintTableElement(generic_string);
                     PrintEndTableRow();
                     found_lib = true;
-                    could_load = VerifyOpen(path.c_str(), load_error);
+                    could_load = VerifyLibrary(path.c_str(), load_error);
                     break;
                 }
             }
@@ -639,11 +658,13 @@ ViaSystem::ViaResults ViaSystemMacOS::PrintSystemDriverInfo() {
         drivers_path_index = driver_paths.size();
         // VK_DRIVERS_PATH may have multiple folders listed in it (colon
         // ':' delimited)
-        char *tok = strtok(drivers_env_value, ":");
+        std::string path_list = drivers_env_value;
+        char *save_ptr = NULL;
+        char *tok = strtok_r(&path_list[0], ":", &save_ptr);
         if (tok != NULL) {
             while (tok != NULL) {
                 driver_paths.push_back(tok);
-                tok = strtok(NULL, ":");
+                tok = strtok_r(NULL, ":", &save_ptr);
             }
         } else {
             driver_paths.push_back(drivers_env_value);
@@ -718,7 +739,9 @@ ViaSystem::ViaResults ViaSystemMacOS::PrintSystemDriverInfo() {
 
         // VK_ICD_FILENAMES may have multiple folders listed in it (colon
         // ':' delimited)
-        char *tok = strtok(icd_env_value, ":");
+        std::string path_list = icd_env_value;
+        char *save_ptr = NULL;
+        char *tok = strtok_r(&path_list[0], ":", &save_ptr);
         if (tok != NULL) {
             while (tok != NULL) {
                 if (access(tok, R_OK) != -1) {
@@ -738,7 +761,7 @@ ViaSystem::ViaResults ViaSystemMacOS::PrintSystemDriverInfo() {
                     PrintTableElement("");
                     PrintEndTableRow();
                 }
-                tok = strtok(NULL, ":");
+                tok = strtok_r(NULL, ":", &save_ptr);
             }
         } else {
             if (access(icd_env_value, R_OK) != -1) {
@@ -1223,7 +1246,9 @@ ViaSystem::ViaResults ViaSystemMacOS::PrintSystemExplicitLayerInfo() {
     env_value = getenv("VK_LAYER_PATH");
     std::string cur_json;
     if (NULL != env_value) {
-        char *tok = strtok(env_value, ":");
+        std::string path_list = env_value;
+        char *save_ptr = NULL;
+        char *tok = strtok_r(&path_list[0], ":", &save_ptr);
         explicit_layer_id = "VK_LAYER_PATH";
 
         PrintBeginTableRow();
@@ -1242,7 +1267,7 @@ ViaSystem::ViaResults ViaSystemMacOS::PrintSystemExplicitLayerInfo() {
                 cur_name << "Path " << offset++;
                 explicit_layer_id = cur_name.str();
                 result = PrintExplicitLayersInFolder(explicit_layer_id, cur_json);
-                tok = strtok(NULL, ":");
+                tok = strtok_r(NULL, ":", &save_ptr);
             }
         } else {
             cur_json = env_value;
@@ -47,6 +47,7 @@ class ViaSystemMacOS : public ViaSystem {
 
    private:
     bool ReadDriverJson(std::string cur_driver_json, bool &found_lib);
+    bool VerifyLibrary(const std::string &library_file, std::string &error);
     ViaResults PrintExplicitLayersInFolder(const std::string &id, std::string &folder_loc);
 };
 